@@ -0,0 +1,113 @@
+#include "Benchmark.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+
+namespace {
+    // Nearest-rank percentile of sorted samples
+    double percentile(const std::vector<double>& sorted, double p) {
+        size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * sorted.size()));
+        return sorted[rank == 0 ? 0 : rank - 1];
+    }
+
+    void writeJsonString(std::ostream& out, const std::string& text) {
+        out << '"';
+        for (char c : text) {
+            if (c == '"' || c == '\\') out << '\\' << c;
+            else if (c == '\n') out << "\\n";
+            else if (static_cast<unsigned char>(c) < 0x20) out << ' ';
+            else out << c;
+        }
+        out << '"';
+    }
+}
+
+const BenchmarkResult& BenchmarkRunner::run(const std::string& name, size_t rows, size_t items,
+                                            uint64_t bytes, const std::function<void()>& body,
+                                            const std::function<void()>& setup) {
+    for (size_t i = 0; i < config.warmup; ++i) {
+        if (setup) setup();
+        body();
+    }
+
+    std::vector<double> samples;
+    size_t reps = std::max<size_t>(config.reps, 1);
+    for (size_t i = 0; i < reps; ++i) {
+        if (setup) setup();
+        auto start = std::chrono::steady_clock::now();
+        body();
+        auto stop = std::chrono::steady_clock::now();
+        samples.push_back(std::chrono::duration<double, std::nano>(stop - start).count());
+    }
+
+    BenchmarkResult result;
+    result.name = name;
+    result.rows = rows;
+    result.items = items;
+    result.bytes = bytes;
+    result.reps = reps;
+    double total = 0;
+    for (double sample : samples) total += sample;
+    result.meanNs = total / samples.size();
+    std::sort(samples.begin(), samples.end());
+    result.minNs = samples.front();
+    result.medianNs = samples.size() % 2 ? samples[samples.size() / 2]
+                    : (samples[samples.size() / 2 - 1] + samples[samples.size() / 2]) / 2;
+    result.p99Ns = percentile(samples, 99);
+
+    results.push_back(result);
+    return results.back();
+}
+
+void BenchmarkRunner::printResult(std::ostream& out, const BenchmarkResult& result) {
+    std::ios flags(nullptr);
+    flags.copyfmt(out);
+    out << std::left << std::setw(22) << result.name << std::right
+        << std::setw(11) << result.rows << " rows"
+        << std::fixed << std::setprecision(3)
+        << std::setw(12) << result.medianNs / 1e6 << " ms median"
+        << std::setw(12) << result.p99Ns / 1e6 << " ms p99"
+        << std::setprecision(0) << std::setw(14) << result.rowsPerSecond() << " rows/s";
+    if (result.bytes) {
+        out << std::setprecision(1) << std::setw(10) << result.megabytesPerSecond() << " MB/s";
+    }
+    out << "\n";
+    out.copyfmt(flags);
+}
+
+void BenchmarkRunner::writeJson(std::ostream& out,
+                                const std::vector<std::pair<std::string, std::string>>& meta) const {
+    std::ios flags(nullptr);
+    flags.copyfmt(out);
+    out << std::fixed << std::setprecision(1);
+
+    out << "{\n  \"meta\": {";
+    for (size_t i = 0; i < meta.size(); ++i) {
+        out << (i ? ",\n    " : "\n    ");
+        writeJsonString(out, meta[i].first);
+        out << ": ";
+        writeJsonString(out, meta[i].second);
+    }
+    out << "\n  },\n  \"results\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchmarkResult& r = results[i];
+        out << (i ? ",\n    {" : "\n    {") << "\"name\": ";
+        writeJsonString(out, r.name);
+        out << ", \"rows\": " << r.rows
+            << ", \"items\": " << r.items
+            << ", \"bytes\": " << r.bytes
+            << ", \"reps\": " << r.reps
+            << ", \"median_ns\": " << r.medianNs
+            << ", \"p99_ns\": " << r.p99Ns
+            << ", \"min_ns\": " << r.minNs
+            << ", \"mean_ns\": " << r.meanNs
+            << ", \"rows_per_sec\": " << r.rowsPerSecond()
+            << ", \"mb_per_sec\": ";
+        if (r.bytes) out << r.megabytesPerSecond();
+        else out << "null";
+        out << "}";
+    }
+    out << "\n  ]\n}\n";
+    out.copyfmt(flags);
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Timing harness for the benchmark suite. Each case runs `warmup` untimed
+// passes and then `reps` timed ones; setup runs before every pass and is
+// not timed, so a case can restore the state it consumes.
+struct BenchmarkConfig {
+    size_t warmup = 1;
+    size_t reps = 5;
+};
+
+struct BenchmarkResult {
+    std::string name;
+    size_t rows = 0;      // catalog size the case ran against
+    size_t items = 0;     // rows (or lookups) processed per pass; rows/s counts these
+    uint64_t bytes = 0;   // bytes processed per pass, 0 if not meaningful
+    size_t reps = 0;
+    double medianNs = 0;
+    double p99Ns = 0;
+    double minNs = 0;
+    double meanNs = 0;
+
+    double rowsPerSecond() const { return medianNs > 0 ? items * 1e9 / medianNs : 0; }
+    double megabytesPerSecond() const { return medianNs > 0 ? bytes * 1e3 / medianNs : 0; }
+};
+
+class BenchmarkRunner {
+private:
+    BenchmarkConfig config;
+    std::vector<BenchmarkResult> results;
+
+public:
+    explicit BenchmarkRunner(const BenchmarkConfig& config) : config(config) {}
+
+    // Times `body`; items and bytes describe the work one pass does
+    const BenchmarkResult& run(const std::string& name, size_t rows, size_t items, uint64_t bytes,
+                               const std::function<void()>& body,
+                               const std::function<void()>& setup = std::function<void()>());
+
+    const std::vector<BenchmarkResult>& getResults() const { return results; }
+
+    // One human-readable line per result
+    static void printResult(std::ostream& out, const BenchmarkResult& result);
+
+    // {"meta": {...}, "results": [...]}; meta values are written as strings
+    void writeJson(std::ostream& out,
+                   const std::vector<std::pair<std::string, std::string>>& meta) const;
+};
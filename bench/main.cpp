@@ -0,0 +1,670 @@
+// bench/main.cpp
+// Benchmark suite for the catalog hot paths. Each size gets a synthetic
+// CSV in the loader's schema; every case reports median and p99 wall time
+// plus throughput, and --json writes the lot for diffing between releases.
+#include "Benchmark.hpp"
+#include "../tools/CatalogGenerator.hpp"
+#include "../include/CompactColumn.hpp"
+#include "../include/ExoplanetCatalog.hpp"
+#include "../include/ThreadPool.hpp"
+#include "../include/algorithms/sorting.hpp"
+#include "../include/datastructs/IndexedMaxHeap.hpp"
+#include "../include/datastructs/MaxHeap.hpp"
+#include <sys/stat.h>
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#ifdef EXO_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef EXO_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+    // Name probes per lookup pass
+    const size_t kLookupsPerPass = 100000;
+    // Typo-tolerant probes are far costlier than exact ones
+    const size_t kFuzzyLookupsPerPass = 1000;
+    // Transit windows the ephemeris cases aim for, and stabbing probes per pass
+    const size_t kTransitWindowBudget = 4000000;
+    const size_t kStabsPerPass = 10000;
+
+    struct Options {
+        std::vector<size_t> sizes = {10000, 100000, 1000000};
+        BenchmarkConfig config;
+        uint64_t seed = 42;
+        std::string workDir = "/tmp";
+        std::string jsonFile;
+    };
+
+    void printUsage(const char* program) {
+        std::cerr << "Usage: " << program << " [options]\n"
+                  << "  --sizes=N[,N...]  catalog sizes in rows, k/m suffixes allowed (default 10k,100k,1m)\n"
+                  << "  --reps=N          timed repetitions per case (default 5)\n"
+                  << "  --warmup=N        untimed repetitions per case (default 1)\n"
+                  << "  --seed=N          synthetic data seed (default 42)\n"
+                  << "  --threads=N       worker threads (default: CPUs available)\n"
+                  << "  --workdir=DIR     where generated inputs and exports go (default /tmp)\n"
+                  << "  --json=FILE       write results as JSON\n";
+    }
+
+    bool parseCount(const char* text, size_t& value) {
+        char* end = nullptr;
+        double number = std::strtod(text, &end);
+        if (end == text || number < 0) return false;
+        if (*end == 'k' || *end == 'K') { number *= 1e3; ++end; }
+        else if (*end == 'm' || *end == 'M') { number *= 1e6; ++end; }
+        if (*end != '\0' && *end != ',') return false;
+        value = static_cast<size_t>(number);
+        return true;
+    }
+
+    bool parseSizes(const char* text, std::vector<size_t>& sizes) {
+        sizes.clear();
+        while (*text) {
+            size_t value;
+            if (!parseCount(text, value) || value == 0) return false;
+            sizes.push_back(value);
+            const char* comma = std::strchr(text, ',');
+            if (!comma) break;
+            text = comma + 1;
+        }
+        return !sizes.empty();
+    }
+
+    uint64_t fileSize(const std::string& filename) {
+        struct stat st;
+        return stat(filename.c_str(), &st) == 0 ? static_cast<uint64_t>(st.st_size) : 0;
+    }
+
+    // Copies a generated CSV with every `every`-th data row's koi_period
+    // replaced by text, as messy upstream drops have; returns its size
+    uint64_t writeMessyCopy(const std::string& from, const std::string& to, size_t every) {
+        std::ifstream in(from);
+        std::ofstream out(to);
+        std::string line;
+        for (size_t n = 0; std::getline(in, line); ++n) {
+            if (n >= 2 && (n - 2) % every == 0) {
+                size_t field = 0, begin = 0;
+                for (; field < 11 && begin != std::string::npos; ++field) {
+                    begin = line.find(',', begin);
+                    if (begin != std::string::npos) ++begin;
+                }
+                if (begin != std::string::npos) line.replace(begin, line.find(',', begin) - begin, "n/a");
+            }
+            out << line << '\n';
+        }
+        out.close();
+        return out ? fileSize(to) : 0;
+    }
+
+    std::string readWhole(const std::string& filename) {
+        std::ifstream in(filename, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+#if defined(EXO_HAVE_ZLIB) || defined(EXO_HAVE_ZSTD)
+    // Only the compressed copies are written this way
+    uint64_t writeWhole(const std::string& filename, const std::string& bytes) {
+        std::ofstream out(filename, std::ios::binary);
+        out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        out.close();
+        return out ? bytes.size() : 0;
+    }
+#endif
+
+#ifdef EXO_HAVE_ZLIB
+    // Input bytes per BGZF block, leaving room for incompressible data
+    const size_t kBgzfBlockInput = 65280;
+
+    // One gzip member holding text[0, n); a BGZF block, with its size in a
+    // BC extra field, if blocked
+    void appendGzipMember(std::string& out, const char* text, size_t n, bool blocked) {
+        z_stream deflater = {};
+        deflateInit2(&deflater, 6, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY); // raw deflate
+        std::string body(deflateBound(&deflater, static_cast<uLong>(n)), '\0');
+        deflater.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(text));
+        deflater.avail_in = static_cast<uInt>(n);
+        deflater.next_out = reinterpret_cast<Bytef*>(&body[0]);
+        deflater.avail_out = static_cast<uInt>(body.size());
+        deflate(&deflater, Z_FINISH);
+        body.resize(deflater.total_out);
+        deflateEnd(&deflater);
+
+        auto appendLittleEndian = [&out](uint32_t value, size_t bytes) {
+            for (size_t i = 0; i < bytes; ++i) out += static_cast<char>(value >> (8 * i) & 0xff);
+        };
+        out += "\x1f\x8b\x08";
+        out += blocked ? '\x04' : '\0';
+        appendLittleEndian(0, 4); // no mtime
+        out += '\0';
+        out += '\xff';
+        if (blocked) {
+            appendLittleEndian(6, 2);
+            out += "BC";
+            appendLittleEndian(2, 2);
+            appendLittleEndian(static_cast<uint32_t>(18 + body.size() + 8 - 1), 2);
+        }
+        out += body;
+        appendLittleEndian(static_cast<uint32_t>(crc32(0, reinterpret_cast<const Bytef*>(text), static_cast<uInt>(n))), 4);
+        appendLittleEndian(static_cast<uint32_t>(n), 4);
+    }
+
+    // The file as one gzip member, or as BGZF blocks ending in the empty
+    // end-of-file block, as bgzip writes it; returns the compressed size
+    uint64_t writeGzipCopy(const std::string& from, const std::string& to, bool blocked) {
+        std::string text = readWhole(from), out;
+        if (!blocked) {
+            appendGzipMember(out, text.data(), text.size(), false);
+        } else {
+            for (size_t i = 0; i < text.size(); i += kBgzfBlockInput) {
+                appendGzipMember(out, text.data() + i, std::min(kBgzfBlockInput, text.size() - i), true);
+            }
+            appendGzipMember(out, text.data(), 0, true);
+        }
+        return writeWhole(to, out);
+    }
+#endif
+
+#ifdef EXO_HAVE_ZSTD
+    // Input bytes per zstd frame
+    const size_t kZstdFrameInput = 1 << 20;
+
+    // The file as zstd frames that each record their size, as pzstd writes
+    uint64_t writeZstdCopy(const std::string& from, const std::string& to) {
+        std::string text = readWhole(from), out;
+        for (size_t i = 0; i < text.size(); i += kZstdFrameInput) {
+            size_t n = std::min(kZstdFrameInput, text.size() - i);
+            std::string frame(ZSTD_compressBound(n), '\0');
+            size_t written = ZSTD_compress(&frame[0], frame.size(), text.data() + i, n, 3);
+            if (ZSTD_isError(written)) return 0;
+            out.append(frame, 0, written);
+        }
+        return writeWhole(to, out);
+    }
+#endif
+
+    // Keys that make algo::quick_sort split as badly as it can, found by
+    // McIlroy's adversary: every key starts undecided, and each comparison
+    // fixes the smallest value left on the key that looks like the pivot
+    std::vector<int> adversarialKeys(size_t n) {
+        std::vector<int> keys(n, static_cast<int>(n)); // n: not decided yet
+        std::vector<int> order(n);
+        int decided = 0;
+        size_t candidate = 0;
+        for (size_t i = 0; i < n; ++i) order[i] = static_cast<int>(i);
+        algo::quick_sort(order.begin(), order.end(), [&](int x, int y) {
+            const int undecided = static_cast<int>(n);
+            if (keys[x] == undecided && keys[y] == undecided) keys[size_t(x) == candidate ? x : y] = decided++;
+            if (keys[x] == undecided) candidate = x;
+            else if (keys[y] == undecided) candidate = y;
+            return keys[x] < keys[y];
+        });
+        return keys;
+    }
+
+    // Entries live at once in the indexed heap check; the reference it is
+    // checked against scans them all on every step
+    const size_t kHeapCheckEntries = 1000;
+
+    // Random pushes, key updates both ways, erases and pops on an
+    // IndexedMaxHeap, checked after every step against a plain list of
+    // (handle, key) searched by brute force; false at the first mismatch
+    bool checkIndexedHeap(uint64_t seed, size_t steps) {
+        std::mt19937_64 random(seed);
+        IndexedMaxHeap<long> heap;
+        std::vector<std::pair<size_t, long>> live;
+        for (size_t step = 0; step < steps; ++step) {
+            long key = static_cast<long>(random() % 5000); // repeats, so ties occur
+            size_t action = random() % 8;
+            if (live.empty() || (action < 3 && live.size() < kHeapCheckEntries)) {
+                size_t handle = heap.push(key);
+                for (const auto& entry : live) {
+                    if (entry.first == handle) return false; // handle of a live entry handed out again
+                }
+                live.push_back(std::make_pair(handle, key));
+            } else if (action < 6) {
+                auto& entry = live[random() % live.size()];
+                heap.update_key(entry.first, key);
+                entry.second = key;
+            } else if (action < 7) {
+                size_t i = random() % live.size();
+                heap.erase(live[i].first);
+                if (heap.contains(live[i].first)) return false;
+                live[i] = live.back();
+                live.pop_back();
+            } else {
+                // Any entry holding the largest key may come off first
+                size_t handle = heap.top_handle(), popped = live.size();
+                for (size_t i = 0; i < live.size(); ++i) {
+                    if (live[i].second > heap.top()) return false;
+                    if (live[i].first == handle) popped = i;
+                }
+                if (popped == live.size() || live[popped].second != heap.top()) return false;
+                heap.pop();
+                live[popped] = live.back();
+                live.pop_back();
+            }
+
+            if (heap.size() != live.size()) return false;
+            long highest = LONG_MIN;
+            for (const auto& entry : live) {
+                if (!heap.contains(entry.first) || heap.value(entry.first) != entry.second) return false;
+                if (entry.second > highest) highest = entry.second;
+            }
+            if (!live.empty() && (heap.top() != highest || heap.value(heap.top_handle()) != highest)) return false;
+        }
+        return true;
+    }
+
+    // Scaled16 columns at the edge of the code range, step 1: each must
+    // either fall back to Float32 or give back every value within half a
+    // step, and none as missing. Codes count from floor(low), so 0.5 ..
+    // 65534.9 needs code 65535, the missing marker, for its top value.
+    bool checkCompactEdges() {
+        const double ranges[][2] = {{0.5, 65534.9}, {0.5, 65534.4}, {0.0, 65534.0}, {0.0, 65535.0}, {-3.25, 65531.7}};
+        for (const auto& range : ranges) {
+            const double values[] = {range[0], (range[0] + range[1]) / 2, range[1], NAN};
+            CompactColumn column;
+            column.encode(4, ColumnEncoding{ColumnEncoding::Kind::Scaled16, 1.0},
+                          [&values](size_t i) { return values[i]; });
+            for (size_t i = 0; i < 3; ++i) {
+                double error = column.kind() == ColumnEncoding::Kind::Float32 ? std::fabs(values[i]) * 1e-7 : 0.5;
+                if (!(std::fabs(column[i] - values[i]) <= error)) return false; // NaN fails too
+            }
+            if (!std::isnan(column[3]) || column.rowsInRange(range[0], range[1]).size() != 3) return false;
+        }
+        return true;
+    }
+
+    // Keeps the optimizer from discarding a result
+    template <typename T>
+    void consume(const T& value) {
+        asm volatile("" : : "g"(&value) : "memory");
+    }
+
+    // Runs the size's cases; false if a consistency check failed: a round
+    // trip that did not give the same bytes, a parallel build that differs
+    // from the serial one, a sort that left keys out of order, an indexed
+    // heap that disagrees with brute force, or a compact column that lost
+    // a value
+    bool runSize(BenchmarkRunner& runner, const Options& options, size_t rows) {
+        std::string input = options.workDir + "/exo_bench_" + std::to_string(rows) + ".csv";
+        std::string output = options.workDir + "/exo_bench_" + std::to_string(rows) + "_export.csv";
+        std::cerr << "Generating " << rows << " rows into " << input << "...\n";
+        uint64_t inputBytes = CatalogGenerator(options.seed).writeFile(input, rows);
+        if (!inputBytes) return true;
+
+        auto report = [](const BenchmarkResult& result) {
+            BenchmarkRunner::printResult(std::cout, result);
+        };
+
+        // Loading: a fresh catalog per pass, torn down outside the timer
+        std::unique_ptr<ExoplanetCatalog> fresh;
+        auto reset = [&fresh] { fresh.reset(new ExoplanetCatalog()); };
+        report(runner.run("parse_csv", rows, rows, inputBytes,
+                          [&] { fresh->loadData(input); }, reset));
+        report(runner.run("parse_csv_lazy", rows, rows, inputBytes,
+                          [&] { fresh->loadData(input, ExoplanetCatalog::LoadMode::Lazy); }, reset));
+
+        // One row in a hundred does not parse; the rejects go to a quarantine file
+        std::string stem = options.workDir + "/exo_bench_" + std::to_string(rows);
+        std::string messy = stem + "_messy.csv", rejects = stem + "_rejects.csv";
+        if (uint64_t messyBytes = writeMessyCopy(input, messy, 100)) {
+            ParsePolicy quarantine;
+            quarantine.quarantineFile = rejects;
+            report(runner.run("parse_csv_messy", rows, rows, messyBytes, [&] { fresh->loadData(messy); },
+                              [&] {
+                                  reset();
+                                  fresh->setParsePolicy(quarantine);
+                              }));
+        }
+
+        // Compressed copies of the input, read without a temporary file;
+        // throughput is of the text they hold
+#ifdef EXO_HAVE_ZLIB
+        if (writeGzipCopy(input, stem + ".csv.gz", false)) {
+            report(runner.run("parse_csv_gzip", rows, rows, inputBytes,
+                              [&] { fresh->loadData(stem + ".csv.gz"); }, reset));
+        }
+        if (writeGzipCopy(input, stem + ".csv.bgz", true)) {
+            report(runner.run("parse_csv_bgzf", rows, rows, inputBytes,
+                              [&] { fresh->loadData(stem + ".csv.bgz"); }, reset));
+        }
+#endif
+#ifdef EXO_HAVE_ZSTD
+        if (writeZstdCopy(input, stem + ".csv.zst")) {
+            report(runner.run("parse_csv_zstd_frames", rows, rows, inputBytes,
+                              [&] { fresh->loadData(stem + ".csv.zst"); }, reset));
+        }
+#endif
+        fresh.reset();
+
+        ExoplanetCatalog catalog;
+        catalog.loadData(input);
+
+        // Speedup curve: the index build on 1, 2, 4, ... threads, then on
+        // the whole pool as build_indices. Every build must find each name
+        // where the single-threaded one did.
+        const DynamicArray<Exoplanet>& loaded = catalog.getPlanets();
+        auto nameTargets = [&] {
+            std::vector<const Exoplanet*> targets;
+            for (const auto& planet : loaded) {
+                targets.push_back(catalog.findPlanetByName(planet.kepoi_name));
+                targets.push_back(catalog.findPlanetByName(planet.kepler_name));
+            }
+            return targets;
+        };
+        size_t poolThreads = ThreadPool::instance().workerCount();
+        std::vector<const Exoplanet*> serialTargets;
+        std::vector<std::pair<size_t, double>> curve;
+        bool sameIndex = true;
+        for (size_t threads = 1;; threads = threads * 2 < poolThreads ? threads * 2 : poolThreads) {
+            ThreadPool::configure(threads);
+            std::string name = threads == poolThreads ? "build_indices" : "build_indices_t" + std::to_string(threads);
+            const BenchmarkResult& result = runner.run(name, rows, rows, 0, [&] { catalog.buildIndices(); });
+            report(result);
+            curve.push_back(std::make_pair(threads, result.medianNs));
+            if (threads == 1) serialTargets = nameTargets();
+            else sameIndex = nameTargets() == serialTargets && sameIndex;
+            if (threads == poolThreads) break;
+        }
+        ThreadPool::configure(poolThreads);
+        std::ios flags(nullptr);
+        flags.copyfmt(std::cout);
+        std::cout << "build_indices speedup:" << std::fixed << std::setprecision(2);
+        for (const auto& point : curve) {
+            std::cout << "  " << point.first << "t " << curve.front().second / point.second << "x";
+        }
+        std::cout << "\n";
+        std::cout.copyfmt(flags);
+        if (!sameIndex) std::cerr << "parallel index build at " << rows << " rows differs from the serial one\n";
+
+        // Probe names: every row's kepoi_name for hits, the same names with
+        // a suffix that never occurs for misses
+        const DynamicArray<Exoplanet>& planets = catalog.getPlanets();
+        std::vector<std::string> hits, misses;
+        std::mt19937_64 random(options.seed);
+        for (size_t i = 0; i < kLookupsPerPass; ++i) {
+            const Exoplanet& planet = planets[random() % planets.size()];
+            hits.push_back(planet.kepoi_name);
+            misses.push_back(planet.kepoi_name + "x");
+        }
+        auto lookupAll = [&catalog](const std::vector<std::string>& names) {
+            size_t found = 0;
+            for (const auto& name : names) found += catalog.findPlanetByName(name) != nullptr;
+            consume(found);
+        };
+        report(runner.run("lookup_hit", rows, hits.size(), 0, [&] { lookupAll(hits); }));
+        report(runner.run("lookup_miss", rows, misses.size(), 0, [&] { lookupAll(misses); }));
+
+        // The persisted name index: built and written once offline, then
+        // mapped at startup in place of the name hash table
+        const std::string nameIndex = ExoplanetCatalog::nameIndexPath(input);
+        report(runner.run("name_index_save", rows, rows, 0, [&] { catalog.saveNameIndex(nameIndex); }));
+        report(runner.run("name_index_open", rows, rows, fileSize(nameIndex),
+                          [&] { catalog.useNameIndex(nameIndex); }));
+        report(runner.run("lookup_hit_mapped", rows, hits.size(), 0, [&] { lookupAll(hits); }));
+        report(runner.run("lookup_miss_mapped", rows, misses.size(), 0, [&] { lookupAll(misses); }));
+
+        // Prefixes drop the ".NN" planet suffix, so each names a star's
+        // candidates; typos replace one character of a full name
+        std::vector<std::string> prefixes, typos;
+        for (size_t i = 0; i < kLookupsPerPass; ++i) {
+            const std::string& name = hits[i];
+            prefixes.push_back(name.substr(0, name.find('.')));
+            if (i < kFuzzyLookupsPerPass) {
+                std::string typo = name;
+                typo[1 + random() % (typo.size() - 1)] = 'q';
+                typos.push_back(typo);
+            }
+        }
+        report(runner.run("lookup_prefix", rows, prefixes.size(), 0, [&] {
+            size_t found = 0;
+            for (const auto& prefix : prefixes) found += catalog.findPlanetsByPrefix(prefix, 10).size();
+            consume(found);
+        }));
+        report(runner.run("lookup_fuzzy", rows, typos.size(), 0, [&] {
+            size_t found = 0;
+            for (const auto& typo : typos) found += catalog.findPlanetsByFuzzyName(typo, 2, 10).size();
+            consume(found);
+        }));
+
+        // Diff against a second load of the same file: every row pairs up,
+        // and the row hashes are cached after the warmup, so this times the
+        // partitioned match alone
+        {
+            ExoplanetCatalog release;
+            release.loadData(input);
+            report(runner.run("diff_release", rows, rows, 0,
+                              [&] { consume(catalog.diff(release)); }));
+        }
+
+        bool sorted = false, heapChecked = false;
+
+        // Sorts keep the indices in step, as they do in the application.
+        // Setup reorders by an unrelated key so no pass sees sorted input.
+        static const char* const sortKeys[] = {"period", "radius", "temperature", "insolation", "esi"};
+        for (const char* key : sortKeys) {
+            const char* scramble = std::strcmp(key, "insolation") == 0 ? "period" : "insolation";
+            report(runner.run(std::string("sort_") + key, rows, rows, 0,
+                              [&] { catalog.sortByProperty(key); },
+                              [&] { catalog.sortByProperty(scramble); }));
+        }
+
+        // The plain sort on keys built to defeat its pivot choice, then on
+        // the same keys shuffled; the first must stay within a small
+        // factor of the second rather than grow quadratically
+        {
+            std::vector<int> adversarial = adversarialKeys(rows), shuffled = adversarial, work;
+            std::shuffle(shuffled.begin(), shuffled.end(), random);
+            auto sortWork = [&] { algo::quick_sort(work.begin(), work.end(), [](int a, int b) { return a < b; }); };
+            report(runner.run("quick_sort_adversarial", rows, rows, 0, sortWork, [&] { work = adversarial; }));
+            sorted = std::is_sorted(work.begin(), work.end());
+            report(runner.run("quick_sort_shuffled", rows, rows, 0, sortWork, [&] { work = shuffled; }));
+            sorted = std::is_sorted(work.begin(), work.end()) && sorted;
+            if (!sorted) std::cerr << "quick_sort at " << rows << " rows left keys out of order\n";
+        }
+
+        // Heap construction over one key per row: n pushes against one
+        // linear-time bulk build
+        {
+            DynamicArray<double> keys(rows);
+            for (size_t i = 0; i < rows; ++i) keys[i] = static_cast<double>(random() % 1000003);
+            report(runner.run("heap_push_build", rows, rows, 0, [&] {
+                MaxHeap<double> heap;
+                for (double key : keys) heap.push(key);
+                consume(heap.top());
+            }));
+            report(runner.run("heap_bulk_build", rows, rows, 0, [&] {
+                MaxHeap<double> heap(keys);
+                consume(heap.top());
+            }));
+
+            // Every key changed once in place through its handle, as a
+            // scheduler reprioritises queued work
+            IndexedMaxHeap<double> indexed;
+            DynamicArray<IndexedMaxHeap<double>::Handle> handles(rows);
+            report(runner.run("indexed_heap_update", rows, rows, 0, [&] {
+                for (size_t i = 0; i < rows; ++i) indexed.update_key(handles[i], keys[rows - 1 - i]);
+                consume(indexed.top());
+            }, [&] {
+                indexed = IndexedMaxHeap<double>();
+                for (size_t i = 0; i < rows; ++i) handles[i] = indexed.push(keys[i]);
+            }));
+            heapChecked = checkIndexedHeap(options.seed, 20 * kHeapCheckEntries);
+            if (!heapChecked) std::cerr << "indexed heap disagrees with its brute-force reference\n";
+        }
+
+        // Transits: every window over two years, or as much of it as
+        // stays within the window budget; an interval index over them; then
+        // stabbing probes and the coinciding pairs of one night
+        {
+            const TransitEphemeris& ephemeris = catalog.transitEphemeris();
+            const double from = 1000.0;
+            double days = 730.0;
+            while (days > 1 && ephemeris.countBetween(from, from + days) > kTransitWindowBudget) days /= 2;
+            size_t windows = ephemeris.countBetween(from, from + days);
+            std::cerr << "Transit range: " << days << " days, " << windows << " windows\n";
+            report(runner.run("transit_windows", rows, windows, 0,
+                              [&] { consume(ephemeris.windowsBetween(from, from + days)); }));
+
+            DynamicArray<TransitWindow> pending;
+            report(runner.run("transit_index_build", rows, windows, 0,
+                              [&] { consume(TransitIndex(std::move(pending))); },
+                              [&] { pending = ephemeris.windowsBetween(from, from + days); }));
+
+            TransitIndex index(ephemeris.windowsBetween(from, from + days));
+            std::vector<double> probes;
+            for (size_t i = 0; i < kStabsPerPass; ++i) {
+                probes.push_back(from + days * static_cast<double>(random() % 1000000) / 1e6);
+            }
+            report(runner.run("transit_stab", rows, probes.size(), 0, [&] {
+                size_t found = 0;
+                for (double t : probes) found += index.stab(t).size();
+                consume(found);
+            }));
+            report(runner.run("transit_night_overlaps", rows, rows, 0, [&] {
+                TransitIndex night = catalog.transitsBetween(from + 100.0, from + 100.4);
+                size_t pairs = 0;
+                night.forEachOverlappingPair([&pairs](size_t, size_t) { return ++pairs, true; });
+                consume(pairs);
+            }));
+        }
+
+        // Scans with the result cache off, then the same queries repeated
+        // against it, as menu choices and server requests repeat them
+        catalog.setResultCacheLimit(0);
+        report(runner.run("top_k_radius", rows, rows, 0,
+                          [&] { consume(catalog.topExtremes(10, "radius", true)); }));
+        report(runner.run("habitable_filter", rows, rows, 0,
+                          [&] { consume(catalog.findHabitablePlanets()); }));
+        report(runner.run("type_distribution", rows, rows, 0,
+                          [&] { consume(catalog.analyzePlanetTypes()); }));
+
+        // The same kinds of scan over 8-byte doubles gathered from the rows,
+        // then over compact mode's float32 radius and 16-bit temperature
+        auto compactScans = [&](const std::string& suffix) {
+            report(runner.run("filter_temperature" + suffix, rows, rows, 0,
+                              [&] { consume(catalog.rowsInRange("temperature", 200, 400)); }));
+            report(runner.run("stats_radius" + suffix, rows, rows, 0,
+                              [&] { consume(catalog.analyzeProperty("radius")); }));
+            report(runner.run("sorted_rows_radius" + suffix, rows, rows, 0,
+                              [&] { consume(catalog.sortedRows("radius")); }));
+        };
+        compactScans("");
+        bool compactChecked = checkCompactEdges();
+        if (!compactChecked) std::cerr << "compact column lost a value at the edge of its code range\n";
+        catalog.setCompactMode(true);
+        catalog.warmCaches();
+        compactScans("_compact");
+        report(runner.run("top_k_radius_compact", rows, rows, 0,
+                          [&] { consume(catalog.topExtremes(10, "radius", true)); }));
+        catalog.setCompactMode(false);
+
+        catalog.setResultCacheLimit(ExoplanetCatalog::kDefaultResultCacheBytes);
+        report(runner.run("top_k_radius_cached", rows, rows, 0,
+                          [&] { consume(catalog.topExtremes(10, "radius", true)); }));
+        report(runner.run("habitable_rows_cached", rows, rows, 0,
+                          [&] { consume(catalog.habitableRows()); }));
+        report(runner.run("type_distribution_cached", rows, rows, 0,
+                          [&] { consume(catalog.countBy("type")); }));
+
+        // One untimed export to learn the output size
+        catalog.saveResults(output);
+        uint64_t outputBytes = fileSize(output);
+        report(runner.run("export_csv", rows, rows, outputBytes,
+                          [&] { catalog.saveResults(output); }));
+
+        // Arrow IPC: export, then load from the mapping, eagerly and lazily
+        std::string arrow = stem + ".arrow", arrowCopy = stem + "_copy.arrow";
+        catalog.saveResults(arrow);
+        uint64_t arrowBytes = fileSize(arrow);
+        report(runner.run("export_arrow", rows, rows, arrowBytes, [&] { catalog.saveResults(arrow); }));
+        report(runner.run("load_arrow", rows, rows, arrowBytes, [&] { fresh->loadData(arrow); }, reset));
+        report(runner.run("load_arrow_lazy", rows, rows, arrowBytes,
+                          [&] { fresh->loadData(arrow, ExoplanetCatalog::LoadMode::Lazy); }, reset));
+
+        // The loaded file written again must match it byte for byte, and
+        // as CSV must match the catalog it came from
+        bool roundTrip = false;
+        {
+            ExoplanetCatalog loaded;
+            loaded.loadData(arrow, ExoplanetCatalog::LoadMode::Lazy);
+            std::string csvCopy = stem + "_copy.csv";
+            roundTrip = loaded.saveResults(arrowCopy) && loaded.saveResults(csvCopy) &&
+                        readWhole(arrowCopy) == readWhole(arrow) && readWhole(csvCopy) == readWhole(output);
+            std::remove(csvCopy.c_str());
+        }
+        if (!roundTrip) std::cerr << "arrow round trip at " << rows << " rows: bytes differ\n";
+        fresh.reset();
+
+        for (const std::string& derived : {input, output, nameIndex, messy, rejects, stem + ".csv.gz",
+                                           stem + ".csv.bgz", stem + ".csv.zst", arrow, arrowCopy}) {
+            std::remove(derived.c_str());
+        }
+        return roundTrip && sameIndex && sorted && heapChecked && compactChecked;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        size_t value;
+        if (std::strncmp(arg, "--sizes=", 8) == 0 && parseSizes(arg + 8, options.sizes)) {
+        } else if (std::strncmp(arg, "--reps=", 7) == 0 && parseCount(arg + 7, value)) {
+            options.config.reps = value;
+        } else if (std::strncmp(arg, "--warmup=", 9) == 0 && parseCount(arg + 9, value)) {
+            options.config.warmup = value;
+        } else if (std::strncmp(arg, "--seed=", 7) == 0) {
+            options.seed = std::strtoull(arg + 7, nullptr, 10);
+        } else if (std::strncmp(arg, "--threads=", 10) == 0 && parseCount(arg + 10, value)) {
+            ThreadPool::configure(value);
+        } else if (std::strncmp(arg, "--workdir=", 10) == 0) {
+            options.workDir = arg + 10;
+        } else if (std::strncmp(arg, "--json=", 7) == 0) {
+            options.jsonFile = arg + 7;
+        } else {
+            std::cerr << "Unknown option: " << arg << "\n";
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    BenchmarkRunner runner(options.config);
+    bool consistent = true;
+    for (size_t rows : options.sizes) consistent = runSize(runner, options, rows) && consistent;
+
+    if (!options.jsonFile.empty()) {
+        std::ofstream json(options.jsonFile);
+        if (!json) {
+            std::cerr << "Error creating file: " << options.jsonFile << std::endl;
+            return 1;
+        }
+        char date[32];
+        std::time_t now = std::time(nullptr);
+        std::strftime(date, sizeof date, "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+        runner.writeJson(json, {
+            {"date", date},
+            {"compiler", __VERSION__},
+            {"threads", std::to_string(ThreadPool::instance().workerCount())},
+            {"warmup", std::to_string(options.config.warmup)},
+            {"reps", std::to_string(options.config.reps)},
+            {"seed", std::to_string(options.seed)},
+        });
+    }
+    return consistent ? 0 : 1;
+}
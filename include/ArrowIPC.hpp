@@ -0,0 +1,95 @@
+#pragma once
+#include "Columns.hpp"
+#include "Exoplanet.hpp"
+#include "MappedFile.hpp"
+#include "datastructs/DynamicArray.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Apache Arrow IPC files (the format Feather v2, pyarrow and Polars read)
+// holding the catalog columns, written as
+//   rowid, kepid                       int32
+//   kepoi_name, kepler_name            utf8: offsets and data buffers
+//   koi_disposition, koi_pdisposition  dictionary<int32, utf8>, one
+//                                      dictionary each for the whole file
+//   koi_fpflag_*                       bool
+//   every other column                 float64
+// NaN and empty strings are nulls in the validity bitmap, and read back as
+// NaN and empty, so writing a catalog read from such a file gives the same
+// bytes again.
+
+// Whether a file name asks for Arrow: .arrow, .feather or .ipc
+bool isArrowPath(const std::string& filename);
+
+bool writeArrowFile(const std::string& filename, const DynamicArray<Exoplanet>& planets);
+// Only planets[rows[0]], planets[rows[1]], ... in that order
+bool writeArrowFile(const std::string& filename, const DynamicArray<Exoplanet>& planets,
+                    const DynamicArray<size_t>& rows);
+
+// An Arrow IPC file mapped as a catalog source. Columns are found by
+// name, so files written elsewhere load too, as long as each catalog column
+// they have is an integer, float, bool, utf8 or large_utf8 column, or a
+// dictionary of strings, no column is nested, and the body is not
+// compressed. Columns the file lacks read as missing. Values are decoded
+// straight from the mapping.
+class ArrowTable {
+public:
+    static bool isArrowFile(const std::string& filename);
+
+    // Maps the file and checks its layout; reports on std::cerr why not
+    bool open(const std::string& filename);
+    void close();
+    bool isOpen() const { return file.isOpen(); }
+    size_t rows() const { return rowCount; }
+    size_t fileSize() const { return file.size(); }
+
+    // Appends rows() planets with `columns` decoded; other numeric
+    // columns read as missing until decoded
+    void appendTo(DynamicArray<Exoplanet>& planets, ColumnMask columns) const;
+    // Decodes `columns` of every row into planets[firstRow ..]
+    void decode(ColumnMask columns, DynamicArray<Exoplanet>& planets, size_t firstRow) const;
+
+private:
+    enum class Kind : uint8_t { Absent, Int, Float, Bool, Utf8, Dictionary };
+
+    // How a column is stored; width is of the values, offsets or indices
+    struct Layout {
+        Kind kind = Kind::Absent;
+        uint8_t width = 0;
+        bool isSigned = true;    // of integers and indices
+        int64_t dictionary = -1; // id, for Kind::Dictionary
+        uint8_t valueWidth = 0;  // of the dictionary's string offsets
+    };
+
+    // One column's buffers in one record batch, or a dictionary's values
+    struct Slice {
+        const uint8_t* validity = nullptr; // none when nothing is null
+        const uint8_t* values = nullptr;   // values, bits, offsets or indices
+        const uint8_t* data = nullptr;     // string bytes
+        size_t dataSize = 0;
+    };
+
+    struct Batch {
+        size_t firstRow = 0, length = 0;
+        Slice columns[static_cast<size_t>(Column::Count)];
+    };
+
+    struct Dictionary {
+        int64_t id = -1;
+        uint8_t width = 0; // of its offsets
+        size_t length = 0;
+        Slice values;
+    };
+
+    MappedFile file;
+    Layout layouts[static_cast<size_t>(Column::Count)];
+    const Dictionary* dictionaryOf[static_cast<size_t>(Column::Count)] = {};
+    DynamicArray<Batch> batches;
+    DynamicArray<Dictionary> dictionaries;
+    size_t rowCount = 0;
+
+    bool readLayout(const std::string& filename);
+    void decodeBatch(const Batch& batch, ColumnMask columns, Exoplanet* planets) const;
+    void stringAt(const Slice& slice, uint8_t width, size_t row, std::string& out) const;
+};
@@ -0,0 +1,111 @@
+#pragma once
+#include "Exoplanet.hpp"
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Columns of the cleaned cumulative table that the catalog decodes.
+// csvIndex is the field position in the source file (see FileIO::parseCSV).
+enum class Column {
+    RowId, KepId, KepoiName, KeplerName, Disposition, PDisposition, Score,
+    FpFlagNt, FpFlagSs, FpFlagCo, FpFlagEc,
+    Period, Time0bk, Impact, Duration, Depth, Prad, Teq, Insol,
+    Steff, Slogg, Srad, Ra, Dec,
+    Count
+};
+
+struct ColumnInfo {
+    const char* name;
+    size_t csvIndex;
+    double Exoplanet::* field; // nullptr for non-double columns
+};
+
+inline const ColumnInfo& columnInfo(Column column) {
+    static const ColumnInfo table[] = {
+        {"rowid",            0,  nullptr},
+        {"kepid",            1,  nullptr},
+        {"kepoi_name",       2,  nullptr},
+        {"kepler_name",      3,  nullptr},
+        {"koi_disposition",  4,  nullptr},
+        {"koi_pdisposition", 5,  nullptr},
+        {"koi_score",        6,  &Exoplanet::koi_score},
+        {"koi_fpflag_nt",    7,  nullptr},
+        {"koi_fpflag_ss",    8,  nullptr},
+        {"koi_fpflag_co",    9,  nullptr},
+        {"koi_fpflag_ec",    10, nullptr},
+        {"koi_period",       11, &Exoplanet::koi_period},
+        {"koi_time0bk",      14, &Exoplanet::koi_time0bk},
+        {"koi_impact",       17, &Exoplanet::koi_impact},
+        {"koi_duration",     20, &Exoplanet::koi_duration},
+        {"koi_depth",        23, &Exoplanet::koi_depth},
+        {"koi_prad",         26, &Exoplanet::koi_prad},
+        {"koi_teq",          29, &Exoplanet::koi_teq},
+        {"koi_insol",        30, &Exoplanet::koi_insol},
+        {"koi_steff",        36, &Exoplanet::koi_steff},
+        {"koi_slogg",        39, &Exoplanet::koi_slogg},
+        {"koi_srad",         42, &Exoplanet::koi_srad},
+        {"ra",               45, &Exoplanet::ra},
+        {"dec",              46, &Exoplanet::dec},
+    };
+    static_assert(sizeof(table) / sizeof(table[0]) == static_cast<size_t>(Column::Count),
+                  "column table out of sync with Column");
+    return table[static_cast<size_t>(column)];
+}
+
+// Members behind the columns that are not doubles
+inline int Exoplanet::* intField(Column column) {
+    switch (column) {
+    case Column::RowId: return &Exoplanet::rowid;
+    case Column::KepId: return &Exoplanet::kepid;
+    default: return nullptr;
+    }
+}
+
+inline std::string Exoplanet::* textField(Column column) {
+    switch (column) {
+    case Column::KepoiName: return &Exoplanet::kepoi_name;
+    case Column::KeplerName: return &Exoplanet::kepler_name;
+    case Column::Disposition: return &Exoplanet::koi_disposition;
+    case Column::PDisposition: return &Exoplanet::koi_pdisposition;
+    default: return nullptr;
+    }
+}
+
+inline bool Exoplanet::* flagField(Column column) {
+    switch (column) {
+    case Column::FpFlagNt: return &Exoplanet::koi_fpflag_nt;
+    case Column::FpFlagSs: return &Exoplanet::koi_fpflag_ss;
+    case Column::FpFlagCo: return &Exoplanet::koi_fpflag_co;
+    case Column::FpFlagEc: return &Exoplanet::koi_fpflag_ec;
+    default: return nullptr;
+    }
+}
+
+// A fresh row: every double missing until decoded, including
+// koi_model_snr and koi_kepmag, which no column decodes
+inline Exoplanet blankPlanet() {
+    Exoplanet planet = {};
+    for (size_t i = 0; i < static_cast<size_t>(Column::Count); ++i) {
+        if (double Exoplanet::* field = columnInfo(static_cast<Column>(i)).field) planet.*field = std::nan("");
+    }
+    planet.koi_model_snr = std::nan("");
+    planet.koi_kepmag = std::nan("");
+    return planet;
+}
+
+using ColumnMask = uint32_t;
+
+inline constexpr ColumnMask columnBit(Column column) {
+    return ColumnMask(1) << static_cast<unsigned>(column);
+}
+
+constexpr ColumnMask kAllColumns = (ColumnMask(1) << static_cast<unsigned>(Column::Count)) - 1;
+
+// Columns a lazy load materializes up front: identity, names for the
+// name index, and the handful of fields most menu queries touch.
+constexpr ColumnMask kLazyKeyColumns =
+    columnBit(Column::RowId) | columnBit(Column::KepId) |
+    columnBit(Column::KepoiName) | columnBit(Column::KeplerName) |
+    columnBit(Column::Disposition) | columnBit(Column::Period) |
+    columnBit(Column::Prad) | columnBit(Column::Teq);
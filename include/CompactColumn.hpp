@@ -0,0 +1,127 @@
+#pragma once
+#include "datastructs/DynamicArray.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// How compact mode stores a numeric column, and the error that allows:
+//   Float32   4 bytes; relative error at most 2^-24, NaN kept as NaN
+//   Scaled16  2 bytes; value = origin + code * step, absolute error at most
+//             step / 2; the top code marks a missing value. A column whose
+//             values span more codes than that falls back to Float32.
+struct ColumnEncoding {
+    enum class Kind { Float32, Scaled16 };
+    Kind kind;
+    double step; // Scaled16 only
+};
+
+// One numeric column in compact form, for scans that would otherwise
+// gather 8-byte doubles out of the planet rows: filters compare stored
+// codes, and other scans decode each value as they read it.
+class CompactColumn {
+public:
+    static const uint16_t kMissingCode = UINT16_MAX;
+
+    // Encodes get(0) .. get(n - 1) (NaN for missing) as `wanted` asks, if
+    // the values fit it
+    template <typename Get>
+    void encode(size_t n, ColumnEncoding wanted, Get get) {
+        encoding = wanted;
+        count = n;
+        floats = DynamicArray<float>();
+        codes = DynamicArray<uint16_t>();
+        if (encoding.kind == ColumnEncoding::Kind::Scaled16) {
+            double low = INFINITY, high = -INFINITY;
+            for (size_t i = 0; i < n; ++i) {
+                double value = get(i);
+                if (std::isnan(value)) continue;
+                low = std::min(low, value);
+                high = std::max(high, value);
+            }
+            // A whole number of steps, so bounds on round values map to codes exactly
+            origin = low <= high ? std::floor(low / encoding.step) * encoding.step : 0.0;
+            // Codes count from origin, up to a step below low, so the top
+            // one is measured from there and rounded as the codes are; it
+            // must stay clear of kMissingCode (NaN and infinities fail too)
+            double top = low <= high ? std::round((high - origin) / encoding.step) : 0.0;
+            if (!(top < kMissingCode)) encoding.kind = ColumnEncoding::Kind::Float32;
+        }
+
+        if (encoding.kind == ColumnEncoding::Kind::Float32) {
+            floats = DynamicArray<float>(n);
+            for (size_t i = 0; i < n; ++i) floats.data[i] = static_cast<float>(get(i));
+        } else {
+            codes = DynamicArray<uint16_t>(n);
+            for (size_t i = 0; i < n; ++i) {
+                double value = get(i);
+                codes.data[i] = std::isnan(value) ? kMissingCode
+                                                  : static_cast<uint16_t>(std::lround((value - origin) / encoding.step));
+            }
+        }
+    }
+
+    size_t size() const { return count; }
+    ColumnEncoding::Kind kind() const { return encoding.kind; }
+    size_t bytes() const {
+        return count * (encoding.kind == ColumnEncoding::Kind::Float32 ? sizeof(float) : sizeof(uint16_t));
+    }
+
+    // The stored value of row i, NaN if missing
+    double operator[](size_t i) const {
+        if (encoding.kind == ColumnEncoding::Kind::Float32) return floats.data[i];
+        uint16_t code = codes.data[i];
+        return code == kMissingCode ? NAN : origin + code * encoding.step;
+    }
+
+    // A value worked out from stored ones (a mean, a median), given to the
+    // column's precision: the shortest decimal that float32 stores the
+    // same way, or the nearest step. Widening a float to double otherwise
+    // shows digits the column never held (0.02999999933 for 0.03).
+    double rounded(double value) const {
+        if (!std::isfinite(value)) return value;
+        if (encoding.kind == ColumnEncoding::Kind::Scaled16) {
+            return origin + std::round((value - origin) / encoding.step) * encoding.step;
+        }
+        char text[32];
+        auto written = std::to_chars(text, text + sizeof(text), static_cast<float>(value));
+        double decimal = value;
+        std::from_chars(text, written.ptr, decimal);
+        return decimal;
+    }
+
+    // Rows whose stored value lies in [min, max]. Scaled columns turn the
+    // bounds into codes once and compare codes.
+    DynamicArray<size_t> rowsInRange(double min, double max) const {
+        DynamicArray<size_t> rows;
+        if (encoding.kind == ColumnEncoding::Kind::Float32) {
+            // Rounding is monotonic, so a value on a bound stays inside it
+            const float low = static_cast<float>(min), high = static_cast<float>(max);
+            const float* values = floats.data;
+            for (size_t i = 0; i < count; ++i) {
+                if (values[i] >= low && values[i] <= high) rows.push_back(i); // NaN never matches
+            }
+            return rows;
+        }
+        double first = std::ceil((min - origin) / encoding.step - 1e-9);
+        double last = std::floor((max - origin) / encoding.step + 1e-9);
+        if (std::isnan(first) || std::isnan(last)) return rows;
+        first = std::max(first, 0.0);
+        last = std::min(last, static_cast<double>(kMissingCode - 1));
+        if (first > last) return rows;
+        uint16_t low = static_cast<uint16_t>(first), high = static_cast<uint16_t>(last);
+        const uint16_t* stored = codes.data;
+        for (size_t i = 0; i < count; ++i) {
+            if (stored[i] >= low && stored[i] <= high) rows.push_back(i);
+        }
+        return rows;
+    }
+
+private:
+    ColumnEncoding encoding = {ColumnEncoding::Kind::Float32, 0.0};
+    double origin = 0.0;
+    size_t count = 0;
+    DynamicArray<float> floats;
+    DynamicArray<uint16_t> codes;
+};
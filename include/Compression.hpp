@@ -0,0 +1,61 @@
+#pragma once
+#include "datastructs/DynamicArray.hpp"
+#include <cstddef>
+#include <memory>
+#include <string>
+
+// Compressed formats the loaders read, told apart by their first bytes
+enum class Compression { None, Gzip, Zstd };
+Compression detectCompression(const char* data, size_t size);
+const char* compressionName(Compression compression);
+// Whether this build links the library for it (make WITH_ZLIB=1, WITH_ZSTD=1)
+bool compressionSupported(Compression compression);
+
+// Decompresses a gzip or zstd file held in memory, usually mapped, front
+// to back. Pieces of the stream that say where they end and how much they
+// hold decompress on their own, so runs of them are decompressed in
+// parallel, a batch per read:
+//   gzip  BGZF blocks, as bgzip writes: members of at most 64 KiB whose
+//         "BC" extra field gives their compressed size
+//   zstd  frames that record their content size, as pzstd or a
+//         concatenation of separately compressed files has
+// Anything else (a plain gzip member, a zstd frame of unknown size) is
+// decompressed in order, one block per read.
+class CompressedReader {
+public:
+    CompressedReader(const char* data, size_t size, Compression compression);
+    ~CompressedReader();
+
+    CompressedReader(const CompressedReader&) = delete;
+    CompressedReader& operator=(const CompressedReader&) = delete;
+
+    // Appends the next decompressed blocks to `blocks`, in order; false
+    // once the input is used up, or is found corrupt (error() says how)
+    bool read(DynamicArray<std::string>& blocks);
+
+    size_t consumed() const { return offset; } // compressed bytes read so far
+    const std::string& error() const { return failure; }
+
+private:
+    // A piece that decompresses on its own
+    struct Piece {
+        size_t offset, size; // compressed
+        size_t output;       // decompressed bytes
+    };
+    struct Stream; // decoder state inside a piece read in order
+
+    const char* data;
+    size_t size;
+    Compression compression;
+    size_t offset = 0;
+    std::string failure;
+    std::unique_ptr<Stream> stream; // set while inside an in-order piece
+
+    bool pieceAt(size_t at, Piece& piece) const;
+    // Decompresses [first, last) into out, one after another; false if any
+    // is corrupt or does not hold what it said
+    bool decompressPieces(const Piece* first, const Piece* last, char* out) const;
+    bool readPieces(DynamicArray<std::string>& blocks);
+    bool readStream(DynamicArray<std::string>& blocks);
+    bool fail(const std::string& why);
+};
@@ -0,0 +1,58 @@
+#pragma once
+#include "Exoplanet.hpp"
+#include "datastructs/DynamicArray.hpp"
+#include "datastructs/IntervalTree.hpp"
+#include <cstddef>
+#include <cstdint>
+
+// Times are BKJD (Kepler barycentric Julian date, BJD - 2454833), the
+// scale koi_time0bk is given in.
+const double kBkjdOffset = 2454833.0;
+
+// One transit: the window mid-transit +- half of koi_duration around
+// koi_time0bk + epoch * koi_period.
+struct TransitWindow {
+    double start, end; // BKJD
+    uint32_t row;      // into the catalog's planets
+    int32_t epoch;     // orbits since koi_time0bk; negative before it
+
+    double mid() const { return start + (end - start) / 2; }
+};
+
+// Linear ephemerides of every planet with a period, a reference epoch and
+// a duration, kept as separate arrays so enumerating the transits in a
+// range is passes of straight-line arithmetic over all planets: find each
+// planet's epochs in the range, count them per slice of time, prefix-sum
+// the counts into offsets, then write and sort each slice in place.
+class TransitEphemeris {
+public:
+    TransitEphemeris() = default;
+    explicit TransitEphemeris(const DynamicArray<Exoplanet>& planets);
+
+    // Planets with a usable ephemeris
+    size_t size() const { return rows.size(); }
+
+    // Transits whose window meets [from, to], in start order
+    size_t countBetween(double from, double to) const;
+    DynamicArray<TransitWindow> windowsBetween(double from, double to) const;
+
+private:
+    DynamicArray<double> epoch0;     // koi_time0bk
+    DynamicArray<double> period;     // days
+    DynamicArray<double> halfWidth;  // days
+    DynamicArray<uint32_t> rows;
+    double widestHalf = 0.0;
+
+    // First and one-past-last epoch of the transits meeting [from, to],
+    // for planets begin .. end - 1 into first[0 ..] and stop[0 ..]
+    void epochRange(size_t begin, size_t end, double from, double to,
+                    int64_t* first, int64_t* stop) const;
+    double startOf(size_t i, int64_t epoch) const;
+    // First epoch in [first, stop) of planet i starting at or after edge
+    int64_t firstStartingFrom(size_t i, double edge, int64_t first, int64_t stop) const;
+};
+
+// Interval index over transit windows, for stabbing ("what is transiting
+// at t") and overlap ("what transits during this window", "which transits
+// coincide") queries on a fixed set of windows
+using TransitIndex = IntervalTree<TransitWindow>;
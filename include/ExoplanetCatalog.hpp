@@ -1,10 +1,42 @@
 #pragma once
 #include "Exoplanet.hpp"
+#include "ArrowIPC.hpp"
+#include "Columns.hpp"
+#include "CompactColumn.hpp"
+#include "Ephemeris.hpp"
+#include "MappedFile.hpp"
+#include "PerfectHashIndex.hpp"
+#include "fileio.hpp"
 #include "datastructs/DynamicArray.hpp"
 #include "datastructs/BinarySearchTree.hpp"
+#include "datastructs/CompactTrie.hpp"
 #include "datastructs/HashTable.hpp"
+#include "datastructs/KDTree.hpp"
+#include "datastructs/LRUCache.hpp"
+#include "datastructs/ShardedHashTable.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
 #include <string>
 
+// How far a loadData call has got, for another thread to report. Bytes of
+// the source file: paged in, and run through the parser.
+struct LoadProgress {
+    std::atomic<uint64_t> totalBytes{0};
+    std::atomic<uint64_t> readBytes{0};
+    std::atomic<uint64_t> parsedBytes{0};
+};
+
+// Quantities derived from the source columns for every planet. They are
+// computed in batch and cached until the catalog changes.
+enum class DerivedColumn {
+    Gravity,        // surface gravity in Earth g, R^1.7
+    EscapeVelocity, // km/s, 11.2 R^1.35
+    Esi,            // Earth Similarity Index from radius and insolation
+    HzDistance,     // Earth-equivalent orbital distance in AU, S^-1/2
+    Count
+};
 
 struct PlanetComparator {
     std::string prop;
@@ -15,36 +47,276 @@ struct PlanetComparator {
 class ExoplanetCatalog {
 private:
     DynamicArray<Exoplanet> planets;
-    BinarySearchTree<double, Exoplanet*> tempTree;
-    HashTable<std::string, Exoplanet*> nameIndex;
+    // Indices are rebuilt wholesale, so their nodes live in arenas
+    BinarySearchTree<double, Exoplanet*, ArenaAllocator> tempTree;
+    // Built on every worker at once (see ShardedHashTable::build)
+    ShardedHashTable<std::string, Exoplanet*, ArenaAllocator> nameIndex;
+
+    // Name index mapped from disk in place of nameIndex. Its rows are
+    // positions in load order, so it serves until the first reorder.
+    PerfectHashIndex namePerfectHash;
+    bool perfectHashCurrent = false;
+    // Identifies the files loaded so far; asLoaded is cleared once rows
+    // are reordered or added, after which the rows no longer match them
+    uint64_t sourceTag = 0;
+    bool asLoaded = true;
+
+    // The same names, case-folded, for inexact queries; built on first use
+    mutable CompactTrie<size_t> nameTrie;
+    mutable uint64_t nameTrieVersion = UINT64_MAX;
+
+    // Lazy mode: rows [lazyFirstRow, size) were indexed from `source`, or
+    // come from `arrowSource`, and only the columns in loadedColumns have
+    // been decoded for them so far. Decoding fills in the cache, so it is
+    // allowed from const queries.
+    mutable MappedFile source;
+    mutable DynamicArray<size_t> rowOffsets;
+    mutable ArrowTable arrowSource;
+    mutable ColumnMask loadedColumns = kAllColumns;
+    size_t lazyFirstRow = 0;
+
+    // How loads treat rows that do not parse, and what the last one rejected
+    ParsePolicy parsePolicy;
+    ParseSummary parseSummary;
+
+    // Bumped by every load, insert and reorder; caches keyed on it go stale
+    uint64_t version = 0;
+    bool indexed = false;
+
+    mutable DynamicArray<double> derived[static_cast<size_t>(DerivedColumn::Count)];
+    mutable uint64_t derivedVersion = UINT64_MAX;
+
+    // Similarity search: standardized log-feature space over the rows that
+    // have every selected feature, rebuilt when the catalog version moves
+    DynamicArray<std::string> similarityFeatures;
+    mutable KDTree<size_t> similarityTree;
+    mutable DynamicArray<double> similarityPoints; // row-major, NaN rows included
+    mutable uint64_t similarityVersion = UINT64_MAX;
+
+    // Sky index: unit vectors of ra/dec in a 3-D k-d tree for cones, and
+    // rows ordered by dec for boxes
+    mutable KDTree<size_t> skyTree;
+    mutable DynamicArray<size_t> decOrder;
+    mutable DynamicArray<double> decSorted;
+    mutable uint64_t skyVersion = UINT64_MAX;
+
+    // Transit ephemerides of the rows with period, epoch and duration
+    mutable TransitEphemeris ephemeris;
+    mutable uint64_t ephemerisVersion = UINT64_MAX;
+
+    // kepid -> rows of the planets orbiting that star
+    mutable HashTable<int, DynamicArray<size_t>, ArenaAllocator> systemIndex;
+    mutable uint64_t systemVersion = UINT64_MAX;
+
+    // Compact mode: the scanned source columns in compact form, rebuilt
+    // when the version moves
+    static const size_t kCompactColumnCount = 4;
+    bool compactMode = false;
+    mutable CompactColumn compactColumns[kCompactColumnCount];
+    mutable uint64_t compactVersion = UINT64_MAX;
+
+    // Row content hashes for diff and merge
+    mutable DynamicArray<uint64_t> rowHashes;
+    mutable uint64_t rowHashVersion = UINT64_MAX;
+
+    void computeDerivedColumns() const;
+    void buildNameTrie() const;
+    void buildSimilarityPoints() const;
+    size_t rowOf(const Exoplanet& planet) const;
+    DynamicArray<double> propertyValues(const std::string& property) const;
+    double propertyValue(const std::string& property, size_t row) const;
+    const CompactColumn* compactColumn(const std::string& property) const; // nullptr if not compact
+    void buildCompactColumns() const;
+    void reordered();
       
 public:
-    // Core functionality
-    void loadData(const std::string& filename);
+    enum class LoadMode {
+        Eager, // parse every field at load time
+        Lazy   // materialize key columns now, the rest on first use
+    };
+
+    // Core functionality. Gzip and zstd files are read as they are, and
+    // always eagerly; Arrow IPC files (see ArrowTable) are mapped, and in
+    // lazy mode decoded column by column straight from the mapping.
+    void loadData(const std::string& filename, LoadMode mode = LoadMode::Eager,
+                  LoadProgress* progress = nullptr);
     void buildIndices();
+
+    // Rejected rows, quarantine file and limits for later loads; a load
+    // over the limits throws and adds no rows
+    void setParsePolicy(const ParsePolicy& policy) { parsePolicy = policy; }
+    const ParsePolicy& getParsePolicy() const { return parsePolicy; }
+    const ParseSummary& lastParseSummary() const { return parseSummary; }
+
+    // Lazy columns: decode any of `columns` not yet materialized.
+    void requireColumns(ColumnMask columns) const;
+    void requireAllColumns() const { requireColumns(kAllColumns); }
+    bool isColumnLoaded(Column column) const { return loadedColumns & columnBit(column); }
     
+    // Sky position queries (degrees). Results are rows in getPlanets().
+    // A box with raMin > raMax wraps through ra = 0.
+    void buildSkyIndex() const;
+    DynamicArray<size_t> coneSearch(double ra, double dec, double radiusDeg) const;
+    DynamicArray<size_t> boxSearch(double raMin, double raMax, double decMin, double decMax) const;
+    DynamicArray<size_t> coneSearchBruteForce(double ra, double dec, double radiusDeg) const;
+    DynamicArray<size_t> boxSearchBruteForce(double raMin, double raMax, double decMin, double decMax) const;
+
+    // Transit timing (BKJD; see Ephemeris.hpp). Window rows are rows in
+    // getPlanets() until the catalog next changes.
+    const TransitEphemeris& transitEphemeris() const;
+    // Every transit meeting [from, to], indexed for stabbing and overlap queries
+    TransitIndex transitsBetween(double from, double to) const;
+
+    // Planetary systems: planets grouped by host star (kepid)
+    struct SystemSummary {
+        int kepid;
+        size_t multiplicity;
+        DynamicArray<double> periodRatios; // outer/inner, adjacent planets by period
+        double totalDepth;                 // ppm, summed over planets with a depth
+    };
+    void buildSystemIndex() const;
+    DynamicArray<size_t> getSystemRows(int kepid) const;
+    DynamicArray<SystemSummary> analyzeSystems(size_t minPlanets = 1) const;
+    void printSystemAnalysis() const;
+
+    // Hash join a host-star CSV on kepid: its koi_steff, koi_slogg and
+    // koi_srad columns overwrite those of every matching planet (missing
+    // values keep the planet's own). Returns the number of planets matched.
+    size_t joinStellarData(const std::string& filename);
+
+    // Release diff and merge, keyed on kepoi_name. Rows are compared by a
+    // hash of every decoded column except rowid (a position in the file,
+    // not content); rows with equal hashes count as equal. A name that
+    // repeats within one catalog is represented by its last row.
+    struct RowChange {
+        size_t oldRow, newRow;
+        ColumnMask changed; // columns whose values differ
+    };
+    struct CatalogDiff {
+        DynamicArray<size_t> added;      // rows of the newer catalog, ascending
+        DynamicArray<size_t> removed;    // rows of this one, ascending
+        DynamicArray<RowChange> changed; // by newRow
+        size_t unchanged = 0;
+    };
+    CatalogDiff diff(const ExoplanetCatalog& newer) const;
+
+    // What a merge does with a name both catalogs have but whose rows differ
+    enum class MergePrecedence {
+        Incoming,   // take the incoming row
+        Existing,   // keep ours
+        FillMissing // keep ours, filling its missing values from the incoming row
+    };
+    struct MergeSummary {
+        size_t added, updated, removed, unchanged; // removed counts every row of a dropped name
+    };
+    // Appends the planets only `incoming` has, resolves changed rows by
+    // precedence and, with dropMissing, removes the planets it lacks.
+    // Existing rows keep their rowid and position; appended rows are
+    // numbered on from the largest rowid this catalog held, so rowids stay
+    // unique. Given an rvalue, the rows taken are moved out of `incoming`,
+    // which is left empty.
+    MergeSummary merge(const ExoplanetCatalog& incoming, MergePrecedence precedence,
+                       bool dropMissing = false);
+    MergeSummary merge(ExoplanetCatalog&& incoming, MergePrecedence precedence,
+                       bool dropMissing = false);
+
+    // Compact mode (opt-in): scans, sorts, filters, top lists and statistics
+    // on radius, temperature, period and insolation read compact copies of
+    // those columns instead of gathering doubles from the rows. Radius,
+    // period and insolation are stored as float32 (relative error under
+    // 6e-8), temperature in 16-bit quarter-kelvin steps (at most 0.125 K
+    // off); missing values stay missing. Results are those of the stored
+    // values, so rows within that error of a bound or of each other may
+    // fall or order differently. The rows themselves keep full precision,
+    // so the copies cost 14 bytes a row on top of them: compact mode buys
+    // scan bandwidth, not memory.
+    void setCompactMode(bool enabled);
+    bool isCompactMode() const { return compactMode; }
+    size_t compactBytes() const; // of the compact columns built so far
+
+    // Content hash of each row as used by diff; decodes every lazy column
+    const DynamicArray<uint64_t>& getRowHashes() const;
+
     // Sorting
     void sortByPeriod();
     void sortByRadius();
     void sortByTemperature();
+    void sortByProperty(const std::string& property); // any property below
+    // The order sortByProperty would give, as rows, leaving the catalog as
+    // is. If given, *present is set to the number of rows with a value;
+    // they come first.
+    DynamicArray<size_t> sortedRows(const std::string& property, size_t* present = nullptr) const;
     
     // Analysis
     struct Stats {
+        size_t count; // planets with a value; the rest are missing
         double mean;
         double median;
         double min;
         double max;
     };
+    // Properties: radius, temperature, period, insolation, and the derived
+    // gravity, escape_velocity, esi and hz_distance
+    static bool isProperty(const std::string& property);
+    // Row and group lists shared with the result cache: read-only, and
+    // still valid after the cache lets them go. Copy one to change it.
+    using RowList = std::shared_ptr<const DynamicArray<size_t>>;
+    using GroupList = std::shared_ptr<const DynamicArray<std::pair<std::string, int>>>;
     void findTopExtremes(size_t n, const std::string& property, bool findMax);
-    Stats analyzePeriods() const;
+    RowList topExtremes(size_t n, const std::string& property, bool findMax) const;
+    DynamicArray<Exoplanet> filterByRange(const std::string& property, double min, double max) const;
+    RowList rowsInRange(const std::string& property, double min, double max) const;
+    Stats analyzeProperty(const std::string& property) const; // NaN stats if count is 0
+    Stats analyzePeriods() const { return analyzeProperty("period"); }
+
+    // Planets per group, ordered by group name. Groups are "type" (radius
+    // and temperature class, as in analyzePlanetTypes), "disposition", or
+    // "multiplicity" (planets in the host system).
+    GroupList countBy(const std::string& key) const;
 
     void printGravityAndWeightForPlanet(const Exoplanet& planet) const;
     
     Exoplanet* findPlanetByName(const std::string& name) const;
 
+    // Persisted name index: a minimal perfect hash over KOI and Kepler
+    // names, saved next to the catalog (nameIndexPath) by bin/exoplanet_index.
+    // useNameIndex maps it after loading, and buildIndices then skips the
+    // name hash table. It fails if the file is missing or was built from
+    // other data. Saving needs the rows in load order.
+    static std::string nameIndexPath(const std::string& catalogFile) { return catalogFile + ".names"; }
+    bool saveNameIndex(const std::string& filename) const;
+    bool useNameIndex(const std::string& filename);
+
+    // Inexact name search over KOI and Kepler names, ignoring case. Each
+    // planet appears once, under its best-matching name. By prefix, results
+    // are in name order ("K00752" gives every K00752.xx); fuzzy results are
+    // within maxDistance edits (insert, delete, substitute or swap adjacent
+    // characters), closest first.
+    struct NameMatch {
+        Exoplanet* planet;
+        unsigned distance; // 0 for prefix matches
+    };
+    DynamicArray<NameMatch> findPlanetsByPrefix(const std::string& prefix, size_t limit) const;
+    DynamicArray<NameMatch> findPlanetsByFuzzyName(const std::string& name, unsigned maxDistance,
+                                                   size_t limit) const;
+
+    // "Planets like this one": nearest neighbours in the space spanned by
+    // the selected properties (default radius, temperature, insolation,
+    // period). weights, if given, has one entry per feature.
+    using Neighbor = KDTree<size_t>::Neighbor; // value is a row in getPlanets()
+    void setSimilarityFeatures(const DynamicArray<std::string>& features);
+    void buildSimilarityIndex() const;
+    DynamicArray<Neighbor> findSimilarPlanets(const Exoplanet& planet, size_t k,
+                                              const DynamicArray<double>& weights = DynamicArray<double>()) const;
+    DynamicArray<Neighbor> findPlanetsWithin(const Exoplanet& planet, double radius,
+                                             const DynamicArray<double>& weights = DynamicArray<double>()) const;
+    DynamicArray<Neighbor> findSimilarPlanetsBruteForce(const Exoplanet& planet, size_t k,
+                                                        const DynamicArray<double>& weights = DynamicArray<double>()) const;
+
     // Visualization
     void printTopNByRadius(int n) const;
     void addPlanet(const Exoplanet& planet);
+    void addPlanet(Exoplanet&& planet);
     HashTable<std::string, int> analyzePlanetTypes() const;
     void printPlanetTypeAnalysis() const;
     
@@ -53,10 +325,61 @@ public:
     // Habitable planets functionality
     void printHabitablePlanets() const;
    DynamicArray<Exoplanet> findHabitablePlanets() const;
+    RowList habitableRows() const;
     
-    // Data export
+    // Data export: Arrow IPC for a .arrow, .feather or .ipc name (see
+    // writeArrowFile), CSV otherwise
     bool saveResults(const std::string& filename) const;
+    bool saveRows(const std::string& filename, const DynamicArray<size_t>& rows) const;
     
-    // Data access
+    // Builds every lazily built cache (columns, derived values, the name
+    // trie, sky, system and similarity indices, the ephemerides) up front. Until the catalog
+    // next changes, const queries then only read it, apart from the locked
+    // result cache, so any number of threads may run them at once.
+    void warmCaches() const;
+
+    // Result cache: habitableRows, topExtremes, rowsInRange, analyzeProperty
+    // and countBy keep their results, keyed on the query, until the catalog
+    // version moves; a repeated query is a lookup, handing out the cached
+    // list itself rather than a copy. Least recently used
+    // results are evicted to stay within the limit, in bytes (0 disables).
+    struct ResultCacheStats {
+        uint64_t hits, misses, evictions;
+        size_t entries, bytes, limit;
+    };
+    static const size_t kDefaultResultCacheBytes = 64 << 20;
+    void setResultCacheLimit(size_t bytes);
+    ResultCacheStats resultCacheStats() const;
+
+    // Data access. In lazy mode only kLazyKeyColumns are guaranteed to be
+    // filled in; call requireColumns for anything else.
     const DynamicArray<Exoplanet>& getPlanets() const;
+    const DynamicArray<double>& getDerivedColumn(DerivedColumn column) const;
+    uint64_t getVersion() const { return version; }
+
+private:
+    struct CachedResult {
+        DynamicArray<size_t> rows;
+        DynamicArray<std::pair<std::string, int>> groups;
+        Stats stats;
+    };
+    mutable std::mutex resultLock;
+    mutable LRUCache<std::string, std::shared_ptr<const CachedResult>> results{kDefaultResultCacheBytes};
+    mutable uint64_t resultsVersion = UINT64_MAX;
+
+    // loadData for an Arrow IPC file
+    void loadArrow(const std::string& filename, LoadMode mode, LoadProgress* progress);
+
+    // Both merges; rows are moved out of `taken` when it is given (it is
+    // incoming's own rows), else copied
+    MergeSummary mergeRows(const ExoplanetCatalog& incoming, DynamicArray<Exoplanet>* taken,
+                           MergePrecedence precedence, bool dropMissing);
+
+    // The cached result for key, or compute() run and its result cached
+    template <typename Compute>
+    std::shared_ptr<const CachedResult> cachedResult(const std::string& key, Compute compute) const;
+    // The uncached queries behind analyzeProperty, countBy and topExtremes
+    Stats computeStats(const std::string& property) const;
+    DynamicArray<std::pair<std::string, int>> countGroups(const std::string& key) const;
+    DynamicArray<size_t> selectExtremes(size_t n, const std::string& property, bool findMax) const;
 };
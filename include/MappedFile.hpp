@@ -0,0 +1,31 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file. The mapping lives as long as
+// the object, so pointers into data() stay valid until close().
+class MappedFile {
+private:
+    const char* _data;
+    size_t _size;
+
+public:
+    MappedFile() : _data(nullptr), _size(0) {}
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // populate reads the whole file in before returning; without it,
+    // pages are read on first touch or by prefetch()
+    bool open(const std::string& filename, bool populate = true);
+    void close();
+
+    // Reads [offset, offset + length) into memory: starts readahead for
+    // the range, then touches each page, so it blocks until the range is in
+    void prefetch(size_t offset, size_t length) const;
+
+    const char* data() const { return _data; }
+    size_t size() const { return _size; }
+    bool isOpen() const { return _data != nullptr; }
+};
@@ -0,0 +1,61 @@
+#pragma once
+#include "MappedFile.hpp"
+#include "datastructs/DynamicArray.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+// Minimal perfect hash from string keys to row ids (CHD-style: hash and
+// displace). Keys fall into buckets of about three; each bucket stores one
+// 32-bit seed that sends its keys to distinct slots of a table with exactly
+// one slot per key. Buckets are placed largest first; single-key buckets
+// are placed last and store their slot directly. A slot holds the row and
+// a 32-bit fingerprint of the key, so almost every miss is rejected
+// without touching the catalog. A lookup reads one seed and one slot.
+//
+// The built index is one flat image that is written to disk as is and
+// memory-mapped back, so a loaded catalog gets its name index without
+// rebuilding it. The image records a tag naming the data it was built
+// from; open() refuses an index whose tag differs.
+class PerfectHashIndex {
+public:
+    static const uint32_t kNotFound = UINT32_MAX;
+
+    PerfectHashIndex() : header(nullptr), seeds(nullptr), slots(nullptr) {}
+
+    PerfectHashIndex(const PerfectHashIndex&) = delete;
+    PerfectHashIndex& operator=(const PerfectHashIndex&) = delete;
+
+    // Builds in memory over (key, row) pairs. A key listed more than once
+    // keeps its last row.
+    void build(const DynamicArray<std::pair<std::string, uint32_t>>& keys, uint64_t sourceTag);
+    bool save(const std::string& filename) const;
+    // Maps a saved index; false if it is missing, malformed or was built
+    // for a different sourceTag
+    bool open(const std::string& filename, uint64_t sourceTag);
+    void close();
+
+    // Row of `key`, or kNotFound. A fingerprint collision can return the
+    // row of another key (about one miss in 4 billion); callers that need
+    // certainty compare the key with the row's name.
+    uint32_t find(const std::string& key) const;
+
+    bool isOpen() const { return header != nullptr; }
+    size_t size() const;
+
+private:
+    struct Header;
+    struct Slot {
+        uint32_t fingerprint;
+        uint32_t row;
+    };
+
+    DynamicArray<uint64_t> image; // built in memory; 8-byte aligned
+    MappedFile file;              // or mapped from disk
+    const Header* header;
+    const uint32_t* seeds;
+    const Slot* slots;
+
+    bool attach(const char* data, size_t bytes, uint64_t sourceTag);
+};
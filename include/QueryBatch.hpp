@@ -0,0 +1,57 @@
+#pragma once
+#include "ExoplanetCatalog.hpp"
+#include "datastructs/DynamicArray.hpp"
+#include <cstddef>
+#include <string>
+
+// A batch of outputs produced from one loaded catalog. The manifest lists
+// one job per line; blank lines and lines starting with '#' are skipped:
+//
+//   input <catalog.csv>                       catalog to load (optional)
+//   sort <property> <out.csv>                 whole catalog, ascending
+//   top <property> <n> min|max <out.csv>
+//   filter <property> <min> <max> <out.csv>
+//   habitable <out.csv>
+//   group type|disposition|multiplicity <out.csv>
+//   stats <property> <out.csv>
+//   transits <from> <to> <out.csv>            every transit meeting [from, to] (BKJD),
+//                                             at most 2^22 of them
+//
+// Planet outputs are in the saveResults format (Arrow IPC for a .arrow,
+// .feather or .ipc name, CSV otherwise); group and stats outputs
+// are small CSV tables, and transits one line per transit in start order.
+//
+// Jobs are planned together rather than run one by one: each property
+// that some export sorts by is sorted once, as a row permutation, without
+// reordering the catalog; top lists come from that permutation when there
+// is one, else from one selection per property and direction at the
+// largest n asked for. Those shared pieces are built in parallel, then all
+// outputs are written in parallel.
+class QueryBatch {
+public:
+    // Reads a manifest; false, after reporting the line, if any is invalid
+    bool load(const std::string& manifest);
+
+    // The manifest's input line, or empty
+    const std::string& inputFile() const { return input; }
+    size_t size() const { return jobs.size(); }
+
+    // Writes every output and reports each; false if any failed. The
+    // catalog must have warmCaches() applied, since jobs run concurrently.
+    bool run(const ExoplanetCatalog& catalog) const;
+
+private:
+    enum class Kind { Sort, Top, Filter, Habitable, Group, Stats, Transits };
+
+    struct Job {
+        Kind kind;
+        std::string key; // property, or grouping
+        size_t n;
+        bool findMax;
+        double min, max; // filter bounds, or the transit range
+        std::string output;
+    };
+
+    std::string input;
+    DynamicArray<Job> jobs;
+};
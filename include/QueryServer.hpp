@@ -0,0 +1,56 @@
+#pragma once
+#include "ExoplanetCatalog.hpp"
+#include <cstddef>
+#include <string>
+
+// Serves queries against a resident catalog over a Unix domain socket, so
+// scripts pay for loading and indexing once instead of per query.
+//
+// Protocol: a request is one line of text; the reply is a header line,
+// "OK <n>" followed by n tab-separated lines, or "ERR <message>". A client
+// may send several requests without waiting; replies come back in order.
+//
+//   PING                         -> OK 0
+//   NAME <name>                  -> the planet, KOI or Kepler name, any case
+//   SEARCH <limit> <text>        -> names starting with text, else within
+//                                   two typos; each line leads with the
+//                                   edit distance
+//   FILTER <property> <min> <max> [limit]
+//   TOP <property> <n> [min|max] -> default max
+//   STATS <property>             -> count, mean, median, min, max lines
+//   GROUP type|disposition|multiplicity -> "<group>\t<planets>" lines
+//   TRANSITS <from> <to> [limit] -> transits meeting [from, to] (BKJD),
+//                                   by start: kepoi_name, epoch, start,
+//                                   mid, end
+//   OVERLAPS <from> <to> [limit] -> pairs of those transits, of different
+//                                   planets, that coincide: both names and
+//                                   epochs, then when the overlap starts
+//                                   and ends
+//   SHUTDOWN                     -> OK 0, then the server exits
+//
+// Planet lines are kepoi_name, kepler_name, disposition, period (days),
+// radius (Earth radii), teq (K), insolation (Earth flux), ra, dec; a
+// missing value is "-".
+//
+// One thread runs an epoll loop over the listening socket and every
+// connection; requests run on the ThreadPool, at most one per connection
+// at a time, and hand their replies back through an eventfd.
+class QueryServer {
+public:
+    static constexpr const char* kDefaultSocket = "/tmp/exoplanet.sock";
+    static const size_t kMaxRequestLength = 4096;
+
+    // The catalog must stay unchanged while the server runs; call
+    // warmCaches() on it first so concurrent queries only read it
+    explicit QueryServer(const ExoplanetCatalog& catalog) : catalog(catalog) {}
+
+    // Listens on socketPath until SHUTDOWN, SIGINT or SIGTERM. Replaces a
+    // stale socket file at that path; false if the socket cannot be set up.
+    bool run(const std::string& socketPath);
+
+    // Reply to one request line, header included
+    std::string handle(const std::string& request) const;
+
+private:
+    const ExoplanetCatalog& catalog;
+};
@@ -0,0 +1,120 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+// Built-in instrumentation: named counters, samples (count / sum / max) and
+// scoped phase timers, reported by --stats. The EXO_STATS_* macros expand to
+// nothing unless the build defines EXO_STATS (make STATS=1), so a normal
+// build carries no instrumentation at all.
+//
+// Each use site owns a function-local static Metric that registers itself
+// on first use; sites sharing a name are summed in the report. Updates go
+// to one of a few cache-line-sized shards picked per thread, so parallel
+// loops do not contend on a single counter.
+namespace stats {
+
+#ifdef EXO_STATS
+    constexpr bool kEnabled = true;
+#else
+    constexpr bool kEnabled = false;
+#endif
+
+    class Metric {
+    public:
+        enum class Kind {
+            Counter, // sum of added values
+            Sample,  // count, sum and max of recorded values
+            Phase    // calls and total nanoseconds
+        };
+
+        Metric(const char* name, Kind kind);
+        Metric(const Metric&) = delete;
+        Metric& operator=(const Metric&) = delete;
+
+        void add(uint64_t value) {
+            shard().sum.fetch_add(value, std::memory_order_relaxed);
+        }
+
+        void record(uint64_t value) {
+            Shard& s = shard();
+            s.count.fetch_add(1, std::memory_order_relaxed);
+            s.sum.fetch_add(value, std::memory_order_relaxed);
+            uint64_t max = s.max.load(std::memory_order_relaxed);
+            while (value > max && !s.max.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+            }
+        }
+
+        const char* name() const { return _name; }
+        Kind kind() const { return _kind; }
+        uint64_t count() const;
+        uint64_t sum() const;
+        uint64_t max() const;
+        const Metric* next() const { return _next; }
+
+    private:
+        static const size_t kShards = 8;
+
+        struct alignas(64) Shard {
+            std::atomic<uint64_t> count{0};
+            std::atomic<uint64_t> sum{0};
+            std::atomic<uint64_t> max{0};
+        };
+
+        const char* _name;
+        Kind _kind;
+        Shard shards[kShards];
+        Metric* _next; // registry list, newest first
+
+        static Shard& shardOf(Metric& metric);
+        Shard& shard() { return shardOf(*this); }
+    };
+
+    // Records the lifetime of the enclosing scope against a Phase metric
+    class PhaseTimer {
+    private:
+        Metric& metric;
+        std::chrono::steady_clock::time_point start;
+
+    public:
+        explicit PhaseTimer(Metric& metric)
+            : metric(metric), start(std::chrono::steady_clock::now()) {}
+        ~PhaseTimer() {
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count();
+            metric.record(static_cast<uint64_t>(ns));
+        }
+        PhaseTimer(const PhaseTimer&) = delete;
+        PhaseTimer& operator=(const PhaseTimer&) = delete;
+    };
+
+    // Human-readable summary, grouped into phases, counters and samples
+    void report(std::ostream& out);
+
+    // {"phases": {...}, "counters": {...}, "samples": {...}}
+    void writeJson(std::ostream& out);
+}
+
+#ifdef EXO_STATS
+#define EXO_STATS_CONCAT_(a, b) a##b
+#define EXO_STATS_CONCAT(a, b) EXO_STATS_CONCAT_(a, b)
+#define EXO_STATS_METRIC_(name, kind) \
+    static ::stats::Metric EXO_STATS_CONCAT(exoStatsMetric_, __LINE__)(name, ::stats::Metric::Kind::kind)
+
+// Time the rest of the enclosing scope
+#define EXO_STATS_PHASE(name)                                   \
+    EXO_STATS_METRIC_(name, Phase);                             \
+    ::stats::PhaseTimer EXO_STATS_CONCAT(exoStatsTimer_, __LINE__)(EXO_STATS_CONCAT(exoStatsMetric_, __LINE__))
+// Add n to a counter
+#define EXO_STATS_COUNT(name, n) \
+    do { EXO_STATS_METRIC_(name, Counter); EXO_STATS_CONCAT(exoStatsMetric_, __LINE__).add(n); } while (0)
+// Record one value of a distribution
+#define EXO_STATS_SAMPLE(name, value) \
+    do { EXO_STATS_METRIC_(name, Sample); EXO_STATS_CONCAT(exoStatsMetric_, __LINE__).record(value); } while (0)
+#else
+#define EXO_STATS_PHASE(name) do {} while (0)
+#define EXO_STATS_COUNT(name, n) do { (void)sizeof(n); } while (0)
+#define EXO_STATS_SAMPLE(name, value) do { (void)sizeof(value); } while (0)
+#endif
@@ -0,0 +1,106 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Process-wide work-stealing scheduler. Each worker owns a deque: it pushes
+// and pops its own tasks at the back, and idle workers steal from the front
+// of the others. Threads outside the pool submit into a shared queue. A
+// thread waiting on a TaskGroup runs queued tasks instead of blocking, so
+// fork/join nests without deadlock.
+class ThreadPool {
+public:
+    using Task = std::function<void()>;
+
+    static ThreadPool& instance();
+
+    // Sets the total thread count (the waiting caller counts as one; 0 means
+    // defaultWorkerCount()). Call before parallel work starts.
+    static void configure(size_t threads);
+
+    // EXO_THREADS if set, else the CPUs this process may use: the affinity
+    // mask, capped by a cgroup v2/v1 CPU quota when one is in force
+    static size_t defaultWorkerCount();
+
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t workerCount() const { return threads.size() + 1; }
+
+    void submit(Task task);
+
+    // Runs one queued task on the calling thread; false if none was found
+    bool runPendingTask();
+
+private:
+    struct Queue {
+        std::mutex lock;
+        std::deque<Task> tasks;
+    };
+
+    // queues[0] receives submissions from outside the pool; worker i owns
+    // queues[i + 1]
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> threads;
+    std::atomic<bool> stopping;
+    std::atomic<size_t> queued;
+    std::mutex sleepLock;
+    std::condition_variable wake;
+
+    explicit ThreadPool(size_t threadCount);
+    void workerLoop(size_t queueIndex);
+    bool takeTask(Task& task);
+};
+
+// Fork/join scope: run() spawns tasks, wait() returns once all have
+// finished and rethrows the first exception any of them threw
+class TaskGroup {
+public:
+    explicit TaskGroup(ThreadPool& pool = ThreadPool::instance())
+        : pool(pool), pending(0) {}
+    ~TaskGroup() {
+        try { wait(); } catch (...) {}
+    }
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    template <typename F>
+    void run(F&& fn) {
+        if (pool.workerCount() <= 1) { // no one to hand it to
+            invoke(fn);
+            return;
+        }
+        ++pending;
+        pool.submit([this, fn]() mutable {
+            invoke(fn);
+            --pending;
+        });
+    }
+
+    void wait();
+
+private:
+    ThreadPool& pool;
+    std::atomic<size_t> pending;
+    std::mutex errorLock;
+    std::exception_ptr error;
+
+    template <typename F>
+    void invoke(F& fn) {
+        try {
+            fn();
+        } catch (...) {
+            std::lock_guard<std::mutex> guard(errorLock);
+            if (!error) error = std::current_exception();
+        }
+    }
+};
@@ -0,0 +1,58 @@
+#pragma once
+#include "Stats.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Timeline tracing in the Chrome trace-event format, for chrome://tracing
+// or ui.perfetto.dev. Tracing is off until start(); a disabled scope costs
+// one relaxed load.
+//
+// Each thread appends to its own fixed-size ring buffer; the owner is the
+// only writer and publishes each slot with a per-slot sequence number, so
+// recording takes no lock. When a ring wraps, the oldest events are
+// dropped. stop() writes every ring to the file: each scope becomes one
+// complete ("X") event carrying its begin time and duration. Threads may
+// still be recording while stop() reads; it keeps only slots whose
+// sequence shows them whole.
+namespace trace {
+    // Begins recording; events go to `filename` when stop() runs (at the
+    // latest, at exit). Names the calling thread "main".
+    bool start(const std::string& filename, size_t eventsPerThread = 1 << 16);
+    // Writes the trace and stops recording; false if the file could not be written
+    bool stop();
+    bool enabled();
+
+    // Label for the calling thread's track in the viewer
+    void setThreadName(const std::string& name);
+
+    uint64_t now(); // ns on the trace clock
+    // name must outlive the trace (a string literal)
+    void record(const char* name, uint64_t beginNs, uint64_t endNs);
+
+    class Scope {
+    private:
+        const char* name;
+        uint64_t begin;
+        bool active;
+
+    public:
+        explicit Scope(const char* name) : name(name), begin(0), active(enabled()) {
+            if (active) begin = now();
+        }
+        ~Scope() {
+            if (active) record(name, begin, now());
+        }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+}
+
+#define EXO_TRACE_CONCAT_(a, b) a##b
+#define EXO_TRACE_CONCAT(a, b) EXO_TRACE_CONCAT_(a, b)
+
+// Trace the rest of the enclosing scope
+#define EXO_TRACE_SCOPE(name) ::trace::Scope EXO_TRACE_CONCAT(exoTraceScope_, __LINE__)(name)
+
+// A phase is both timed for --stats and drawn on the --trace timeline
+#define EXO_PHASE(name) EXO_STATS_PHASE(name); EXO_TRACE_SCOPE(name)
@@ -0,0 +1,83 @@
+// kernels.hpp
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace algo {
+    // Branch-free log/exp for batch kernels. Unlike std::pow these inline
+    // into the loop body, so the loops over whole columns can vectorize.
+    // Relative error is below 1e-14 for normal positive inputs.
+    inline double fast_log(double x) {
+        uint64_t bits;
+        std::memcpy(&bits, &x, sizeof bits);
+        double e = static_cast<double>(static_cast<int64_t>((bits >> 52) & 0x7ff) - 1023);
+        uint64_t mantissaBits = (bits & 0x000fffffffffffffULL) | 0x3ff0000000000000ULL;
+        double m;
+        std::memcpy(&m, &mantissaBits, sizeof m);
+
+        // Keep m in [sqrt(1/2), sqrt(2)) so the series below converges fast
+        bool high = m > 1.4142135623730951;
+        m = high ? m * 0.5 : m;
+        e = high ? e + 1.0 : e;
+
+        // log(m) = 2 atanh(s), s = (m - 1) / (m + 1)
+        double s = (m - 1.0) / (m + 1.0);
+        double s2 = s * s;
+        double p = 1.0 / 15 + s2 * (1.0 / 17);
+        p = 1.0 / 13 + s2 * p;
+        p = 1.0 / 11 + s2 * p;
+        p = 1.0 / 9 + s2 * p;
+        p = 1.0 / 7 + s2 * p;
+        p = 1.0 / 5 + s2 * p;
+        p = 1.0 / 3 + s2 * p;
+        p = 1.0 + s2 * p;
+        return 2.0 * s * p + e * 0.6931471805599453;
+    }
+
+    inline double fast_exp(double y) {
+        y = y < -708.0 ? -708.0 : (y > 709.0 ? 709.0 : y);
+
+        // y = n ln2 + r with |r| <= ln2 / 2; the magic constant rounds to nearest
+        const double round = 6755399441055744.0;
+        double n = (y * 1.4426950408889634 + round) - round;
+        double r = (y - n * 0.6931471803691238) - n * 1.9082149292705877e-10;
+
+        double p = 1.0 / 39916800;
+        p = 1.0 / 3628800 + r * p;
+        p = 1.0 / 362880 + r * p;
+        p = 1.0 / 40320 + r * p;
+        p = 1.0 / 5040 + r * p;
+        p = 1.0 / 720 + r * p;
+        p = 1.0 / 120 + r * p;
+        p = 1.0 / 24 + r * p;
+        p = 1.0 / 6 + r * p;
+        p = 0.5 + r * p;
+        p = 1.0 + r * p;
+        p = 1.0 + r * p;
+
+        uint64_t bits = static_cast<uint64_t>(static_cast<int64_t>(n) + 1023) << 52;
+        double scale;
+        std::memcpy(&scale, &bits, sizeof scale);
+        return p * scale;
+    }
+
+    // out[i] = scale * x[i]^exponent; NaN for missing or non-positive x
+    inline void scaled_pow(const double* x, double exponent, double scale, double* out, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            double v = scale * fast_exp(exponent * fast_log(x[i]));
+            out[i] = x[i] > 0.0 ? v : NAN; // false for NaN too
+        }
+    }
+
+    // Earth Similarity Index from radius and insolation, both in Earth
+    // units (Schulze-Makuch et al. 2011, as used by the PHL catalog)
+    inline void earth_similarity(const double* radius, const double* insolation, double* out, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            double r = (radius[i] - 1.0) / (radius[i] + 1.0);
+            double s = (insolation[i] - 1.0) / (insolation[i] + 1.0);
+            out[i] = 1.0 - std::sqrt(0.5 * (r * r + s * s));
+        }
+    }
+}
@@ -0,0 +1,102 @@
+// parallel.hpp
+#pragma once
+#include "../ThreadPool.hpp"
+#include "sorting.hpp"
+#include <cstddef>
+#include <vector>
+
+namespace algo {
+    inline size_t worker_count() {
+        return ThreadPool::instance().workerCount();
+    }
+
+    namespace detail {
+        // Fork/join splitting: hand off the upper half, keep the lower
+        template <typename Body>
+        void split_range(TaskGroup& group, size_t begin, size_t end, size_t grain, const Body& body) {
+            while (end - begin > grain) {
+                size_t mid = begin + (end - begin) / 2;
+                group.run([&group, mid, end, grain, &body] {
+                    split_range(group, mid, end, grain, body);
+                });
+                end = mid;
+            }
+            body(begin, end);
+        }
+
+        // Ranges no larger than this are sorted serially
+        const size_t kParallelSortCutoff = 1 << 13;
+
+        template <typename Iterator, typename Compare>
+        void sort_range(TaskGroup& group, Iterator first, Iterator last, const Compare& comp, int depth) {
+            while (last - first > static_cast<std::ptrdiff_t>(kParallelSortCutoff)) {
+                if (depth-- == 0) {
+                    heap_sort(first, last, comp);
+                    return;
+                }
+                auto bounds = quick_partition(first, last, comp);
+                Iterator right = bounds.first, left = bounds.second;
+                group.run([&group, first, right, &comp, depth] { sort_range(group, first, right, comp, depth); });
+                first = left;
+            }
+            intro_sort(first, last, comp, depth);
+        }
+    }
+
+    // Calls body(begin, end) over subranges of [0, n) on the shared pool.
+    // grain is the smallest range worth a task of its own.
+    template <typename Body>
+    void parallel_for(size_t n, size_t grain, Body body) {
+        size_t workers = worker_count();
+        if (grain == 0) grain = 1;
+        if (workers <= 1 || n <= grain) {
+            body(size_t(0), n);
+            return;
+        }
+
+        // A few tasks per worker is enough to balance the load
+        size_t minimum = n / (workers * 8);
+        if (grain < minimum) grain = minimum;
+
+        TaskGroup group;
+        detail::split_range(group, 0, n, grain, body);
+        group.wait();
+    }
+
+    // Maps fixed chunks of [0, n) to partial results in parallel, then
+    // folds them left to right, so the result does not depend on timing
+    template <typename T, typename Map, typename Combine>
+    T parallel_reduce(size_t n, size_t grain, const T& identity, Map map, Combine combine) {
+        size_t workers = worker_count();
+        if (grain == 0) grain = 1;
+        size_t minimum = n / (workers * 8);
+        if (grain < minimum) grain = minimum;
+
+        size_t chunks = (n + grain - 1) / grain;
+        if (workers <= 1 || chunks <= 1) return combine(identity, map(size_t(0), n));
+
+        std::vector<T> partial(chunks, identity);
+        parallel_for(chunks, 1, [&](size_t begin, size_t end) {
+            for (size_t c = begin; c < end; ++c) {
+                size_t to = (c + 1) * grain < n ? (c + 1) * grain : n;
+                partial[c] = map(c * grain, to);
+            }
+        });
+
+        T result = identity;
+        for (const auto& value : partial) result = combine(result, value);
+        return result;
+    }
+
+    // quick_sort whose partitions above the cutoff become pool tasks
+    template <typename Iterator, typename Compare>
+    void parallel_quick_sort(Iterator first, Iterator last, Compare comp) {
+        if (worker_count() <= 1 || last - first <= static_cast<std::ptrdiff_t>(detail::kParallelSortCutoff)) {
+            quick_sort(first, last, comp);
+            return;
+        }
+        TaskGroup group;
+        detail::sort_range(group, first, last, comp, quick_sort_depth(first, last));
+        group.wait();
+    }
+}
@@ -1,16 +1,26 @@
 // sorting.hpp
 #pragma once
 #include "../datastructs/DynamicArray.hpp"
+#include <cstddef>
+#include <utility>
 
 namespace algo {
-    // Improved QuickSort implementation
+    // Partitions [first, last) around a median-of-three pivot. Returns
+    // (pivot position, start of the upper part): everything before the
+    // pivot is not greater than it, everything from the second iterator on
+    // is not less.
     template <typename Iterator, typename Compare>
-    void quick_sort(Iterator first, Iterator last, Compare comp) {
-        if (first >= last) return;
+    std::pair<Iterator, Iterator> quick_partition(Iterator first, Iterator last, Compare& comp) {
+        Iterator mid = first + (last - first) / 2;
+        Iterator back = last - 1;
+        if (comp(*mid, *first)) std::swap(*mid, *first);
+        if (comp(*back, *first)) std::swap(*back, *first);
+        if (comp(*back, *mid)) std::swap(*back, *mid);
+        std::swap(*first, *mid);
 
         Iterator pivot = first;
         Iterator left = first + 1;
-        Iterator right = last;
+        Iterator right = last - 1;
 
         while (left <= right) {
             while (left <= right && comp(*left, *pivot)) ++left;
@@ -23,8 +33,89 @@ namespace algo {
         }
 
         std::swap(*pivot, *right);
-        quick_sort(first, right - 1, comp);
-        quick_sort(left, last, comp);
+        return std::make_pair(right, left);
+    }
+
+    // Restores the max-heap below root in [first, first + size)
+    template <typename Iterator, typename Compare>
+    void sift_down(Iterator first, std::ptrdiff_t root, std::ptrdiff_t size, Compare& comp) {
+        while (2 * root + 1 < size) {
+            std::ptrdiff_t child = 2 * root + 1;
+            if (child + 1 < size && comp(*(first + child), *(first + child + 1))) ++child;
+            if (!comp(*(first + root), *(first + child))) return;
+            std::swap(*(first + root), *(first + child));
+            root = child;
+        }
+    }
+
+    // HeapSort over [first, last): O(n log n) whatever the input order
+    template <typename Iterator, typename Compare>
+    void heap_sort(Iterator first, Iterator last, Compare comp) {
+        std::ptrdiff_t size = last - first;
+        for (std::ptrdiff_t root = size / 2 - 1; root >= 0; --root) sift_down(first, root, size, comp);
+        while (size > 1) {
+            --size;
+            std::swap(*first, *(first + size));
+            sift_down(first, std::ptrdiff_t(0), size, comp);
+        }
+    }
+
+    // Partitioning levels quick_sort allows before it hands a range to
+    // heap_sort: twice the depth of a balanced split
+    template <typename Iterator>
+    int quick_sort_depth(Iterator first, Iterator last) {
+        int depth = 0;
+        for (std::ptrdiff_t n = last - first; n > 1; n >>= 1) depth += 2;
+        return depth;
+    }
+
+    namespace detail {
+        template <typename Iterator, typename Compare>
+        void intro_sort(Iterator first, Iterator last, Compare& comp, int depth) {
+            while (last - first > 1) {
+                // Median-of-three still has inputs it splits badly every
+                // time; past the budget, fall back to a guaranteed bound
+                if (depth-- == 0) {
+                    heap_sort(first, last, comp);
+                    return;
+                }
+                auto bounds = quick_partition(first, last, comp);
+                if (bounds.first - first < last - bounds.second) {
+                    intro_sort(first, bounds.first, comp, depth);
+                    first = bounds.second;
+                } else {
+                    intro_sort(bounds.second, last, comp, depth);
+                    last = bounds.first;
+                }
+            }
+        }
+    }
+
+    // Improved QuickSort implementation over the half-open range [first, last).
+    // Recursing into the smaller part bounds the stack depth to O(log n);
+    // a range that keeps splitting badly is finished by heap_sort, so the
+    // worst case is O(n log n) too.
+    template <typename Iterator, typename Compare>
+    void quick_sort(Iterator first, Iterator last, Compare comp) {
+        detail::intro_sort(first, last, comp, quick_sort_depth(first, last));
+    }
+
+    // Partial sort: afterwards *nth is the element a full sort would put
+    // there, with nothing greater before it and nothing smaller after it.
+    // Sorts what is left once quick_sort would give up on partitioning.
+    template <typename Iterator, typename Compare>
+    void quick_select(Iterator first, Iterator nth, Iterator last, Compare comp) {
+        int depth = quick_sort_depth(first, last);
+        while (last - first > 1) {
+            if (depth-- == 0) {
+                heap_sort(first, last, comp);
+                return;
+            }
+            auto bounds = quick_partition(first, last, comp);
+            if (nth >= bounds.first && nth < bounds.second) return; // equal to the pivot
+            if (nth < bounds.first) last = bounds.first;
+            else first = bounds.second;
+        }
     }
 
     // Basic quick_sort without comparator (uses operator<)
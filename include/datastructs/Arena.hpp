@@ -0,0 +1,143 @@
+#pragma once
+#include "../Stats.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Bump allocator over a chain of blocks. Allocation is a pointer bump;
+// nothing is freed individually. reset() returns everything at once and
+// keeps the largest block, so a container that is cleared and refilled
+// reuses the same memory without going back to the heap.
+class Arena {
+private:
+    struct Block {
+        Block* next;
+        size_t size; // usable bytes after the header
+    };
+
+    static const size_t kMinBlock = 4096;
+    static const size_t kMaxBlock = 1 << 22; // growth stops doubling here
+
+    Block* blocks;      // newest first; the newest is being carved
+    char* cursor;
+    char* limit;
+    size_t nextBlockSize;
+
+    static char* payload(Block* block) {
+        return reinterpret_cast<char*>(block) + sizeof(Block);
+    }
+
+    void addBlock(size_t minBytes) {
+        size_t size = nextBlockSize;
+        while (size < minBytes) size *= 2;
+        Block* block = static_cast<Block*>(std::malloc(sizeof(Block) + size));
+        if (!block) throw std::bad_alloc();
+        EXO_STATS_COUNT("arena.blocks", 1);
+        EXO_STATS_COUNT("arena.bytes", size);
+        block->next = blocks;
+        block->size = size;
+        blocks = block;
+        cursor = payload(block);
+        limit = cursor + size;
+        if (nextBlockSize < kMaxBlock) nextBlockSize *= 2;
+    }
+
+public:
+    Arena() : blocks(nullptr), cursor(nullptr), limit(nullptr), nextBlockSize(kMinBlock) {}
+    ~Arena() {
+        while (blocks) {
+            Block* next = blocks->next;
+            std::free(blocks);
+            blocks = next;
+        }
+    }
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t bytes, size_t align) {
+        uintptr_t p = (reinterpret_cast<uintptr_t>(cursor) + align - 1) & ~(uintptr_t(align) - 1);
+        if (!cursor || p + bytes > reinterpret_cast<uintptr_t>(limit)) {
+            addBlock(bytes + align);
+            p = (reinterpret_cast<uintptr_t>(cursor) + align - 1) & ~(uintptr_t(align) - 1);
+        }
+        cursor = reinterpret_cast<char*>(p + bytes);
+        return reinterpret_cast<void*>(p);
+    }
+
+    // Make room for `bytes` more in one block, so what follows is contiguous
+    void reserve(size_t bytes) {
+        if (static_cast<size_t>(limit - cursor) < bytes) addBlock(bytes);
+    }
+
+    // Releases every allocation. Keeps the largest block for reuse.
+    void reset() {
+        Block* keep = nullptr;
+        while (blocks) {
+            Block* next = blocks->next;
+            if (!keep || blocks->size > keep->size) {
+                if (keep) std::free(keep);
+                keep = blocks;
+            } else {
+                std::free(blocks);
+            }
+            blocks = next;
+        }
+        blocks = keep;
+        if (keep) {
+            keep->next = nullptr;
+            cursor = payload(keep);
+            limit = cursor + keep->size;
+        } else {
+            cursor = limit = nullptr;
+        }
+    }
+};
+
+// Node allocation policies for the node-based containers (HashTable,
+// BinarySearchTree). A policy creates and destroys nodes and may release
+// all of them at once; kBulkRelease says release() frees the memory, so a
+// container only walks its nodes on clear() when they have destructors.
+
+// One heap allocation per node
+class HeapAllocator {
+public:
+    static constexpr bool kBulkRelease = false;
+
+    template <typename T, typename... Args>
+    T* create(Args&&... args) { return new T(std::forward<Args>(args)...); }
+
+    template <typename T>
+    void destroy(T* node) { delete node; }
+
+    template <typename T>
+    void reserve(size_t) {}
+
+    void release() {}
+};
+
+// Nodes bump-allocated from a per-container arena: contiguous in insertion
+// order, freed together on release()
+class ArenaAllocator {
+private:
+    Arena arena;
+
+public:
+    static constexpr bool kBulkRelease = true;
+
+    template <typename T, typename... Args>
+    T* create(Args&&... args) {
+        return new (arena.allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    template <typename T>
+    void destroy(T* node) { node->~T(); } // memory comes back on release()
+
+    template <typename T>
+    void reserve(size_t count) { arena.reserve(count * sizeof(T) + alignof(T)); }
+
+    void release() { arena.reset(); }
+};
@@ -1,8 +1,11 @@
 #pragma once
+#include "Arena.hpp"
 #include <functional>
 #include <stdexcept>
+#include <type_traits>
 
-template <typename K, typename V>
+// Alloc is a node allocation policy from Arena.hpp
+template <typename K, typename V, typename Alloc = HeapAllocator>
 class BinarySearchTree {
     struct Node {
         K key;
@@ -13,9 +16,10 @@ class BinarySearchTree {
     };
 
     Node* root;
+    Alloc alloc;
 
     Node* insert(Node* node, K key, V value) {
-        if (!node) return new Node(key, value);
+        if (!node) return alloc.template create<Node>(key, value);
         if (key < node->key) {
             node->left = insert(node->left, key, value);
         } else {
@@ -24,6 +28,17 @@ class BinarySearchTree {
         return node;
     }
 
+    // Balanced subtree over entries [lo, hi) of a key-sorted array
+    template <typename Pairs>
+    Node* build_sorted(const Pairs& sorted, size_t lo, size_t hi) {
+        if (lo >= hi) return nullptr;
+        size_t mid = lo + (hi - lo) / 2;
+        Node* node = alloc.template create<Node>(sorted[mid].first, sorted[mid].second);
+        node->left = build_sorted(sorted, lo, mid);
+        node->right = build_sorted(sorted, mid + 1, hi);
+        return node;
+    }
+
     Node* find(Node* node, K key) const {
         if (!node) return nullptr;
         if (key == node->key) return node;
@@ -34,7 +49,7 @@ class BinarySearchTree {
         if (node) {
             clear(node->left);
             clear(node->right);
-            delete node;
+            alloc.destroy(node);
         }
     }
 
@@ -48,12 +63,22 @@ class BinarySearchTree {
 
 public:
     BinarySearchTree() : root(nullptr) {}
-    ~BinarySearchTree() { clear(root); }
+    ~BinarySearchTree() { clear(); }
 
     void insert(K key, V value) { 
         root = insert(root, key, value); 
     }
     
+    // Replaces the contents with a balanced tree built from (key, value)
+    // pairs already sorted by key. Inserting sorted keys one at a time would
+    // degrade the tree to a list.
+    template <typename Pairs>
+    void assign_sorted(const Pairs& sorted) {
+        clear();
+        alloc.template reserve<Node>(sorted.size());
+        root = build_sorted(sorted, 0, sorted.size());
+    }
+
     bool contains(K key) const { 
         return find(root, key) != nullptr; 
     }
@@ -65,7 +90,9 @@ public:
     }
 
     void clear() {
-        clear(root);
+        // An arena frees every node at once; only destructors need a walk
+        if (!Alloc::kBulkRelease || !std::is_trivially_destructible<Node>::value) clear(root);
+        alloc.release();
         root = nullptr;
     }
 
@@ -0,0 +1,280 @@
+#pragma once
+#include "DynamicArray.hpp"
+#include "../algorithms/sorting.hpp"
+#include <cctype>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+// Static, path-compressed trie over case-folded string keys, for name
+// completion and typo-tolerant lookup.
+//
+// Keys are sorted and stored back to back in one text buffer. Nodes sit in
+// breadth-first order in a flat array, so the children of a node are
+// contiguous, and a node stands for the sorted key range sharing its
+// prefix: edge labels are read from the first key of that range instead of
+// being stored. A prefix query ends at a node (or inside the edge into
+// it) and its answer is that node's key range, already in sorted order.
+template <typename V>
+class CompactTrie {
+public:
+    struct Match {
+        size_t key;        // index into the sorted keys
+        unsigned distance; // edits between the query and the key
+    };
+
+private:
+    // Nodes with at most this many keys are ordered by insertion sort
+    static const uint32_t kInsertionRange = 32;
+
+    struct Node {
+        uint32_t keyLo, keyHi; // keys below this node, [keyLo, keyHi)
+        uint32_t terminalEnd;  // keys [keyLo, terminalEnd) end at this node
+        uint32_t depth;        // length of the prefix this node stands for
+        uint32_t firstChild;
+        uint32_t childCount;
+    };
+
+    DynamicArray<char> text;       // sorted folded keys, concatenated
+    DynamicArray<size_t> keyStart; // key i is text[keyStart[i], keyStart[i + 1])
+    DynamicArray<V> values;        // per sorted key
+    DynamicArray<Node> nodes;      // [0] is the root
+    DynamicArray<unsigned char> labels; // per node: first byte of the edge into it
+
+    const char* keyText(size_t i) const { return text.data + keyStart.data[i]; }
+    size_t keyLength(size_t i) const { return keyStart.data[i + 1] - keyStart.data[i]; }
+
+    static char fold(char c) {
+        return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+
+    // Child of `node` whose edge starts with c, or 0 (the root is never a child)
+    uint32_t child(uint32_t node, char c) const {
+        const Node& n = nodes.data[node];
+        unsigned char byte = static_cast<unsigned char>(c);
+        for (uint32_t i = n.firstChild; i < n.firstChild + n.childCount; ++i) {
+            if (labels.data[i] == byte) return i;
+            if (labels.data[i] > byte) break; // children are in byte order
+        }
+        return 0;
+    }
+
+    // Optimal string alignment distance (Levenshtein plus adjacent
+    // transpositions). rows holds one row of width m + 1 per trie depth;
+    // the rows down to `from` are filled in on entry. Only the diagonal
+    // band |r - j| <= maxDistance can stay within the bound, so each row
+    // computes that band and caps its two neighbours at maxDistance + 1.
+    void fuzzyVisit(uint32_t node, size_t from, const std::string& query, unsigned maxDistance,
+                    DynamicArray<unsigned>& rows, DynamicArray<Match>& out) const {
+        const Node& n = nodes.data[node];
+        size_t m = query.size();
+        const char* key = keyText(n.keyLo);
+        unsigned beyond = maxDistance + 1;
+
+        for (size_t r = from + 1; r <= n.depth; ++r) {
+            if (r > m + maxDistance) return; // r - m deletions at least
+            unsigned* row = rows.data + r * (m + 1);
+            const unsigned* above = row - (m + 1);
+            char c = key[r - 1];
+            size_t lo = r > maxDistance ? r - maxDistance : 1;
+            size_t hi = r + maxDistance < m ? r + maxDistance : m;
+
+            row[0] = static_cast<unsigned>(r);
+            if (lo > 1) row[lo - 1] = beyond;
+            unsigned best = row[lo - 1];
+            for (size_t j = lo; j <= hi; ++j) {
+                unsigned d = above[j - 1] + (query[j - 1] == c ? 0 : 1);
+                if (above[j] + 1 < d) d = above[j] + 1;
+                if (row[j - 1] + 1 < d) d = row[j - 1] + 1;
+                if (r > 1 && j > 1 && c == query[j - 2] && key[r - 2] == query[j - 1]) {
+                    unsigned swapped = rows.data[(r - 2) * (m + 1) + j - 2] + 1;
+                    if (swapped < d) d = swapped;
+                }
+                row[j] = d;
+                if (d < best) best = d;
+            }
+            if (hi < m) row[hi + 1] = beyond;
+            if (best > maxDistance) return; // every extension is further still
+        }
+
+        unsigned distance = n.depth + maxDistance >= m ? rows.data[n.depth * (m + 1) + m] : beyond;
+        if (distance <= maxDistance) {
+            for (uint32_t k = n.keyLo; k < n.terminalEnd; ++k) out.push_back(Match{k, distance});
+        }
+        for (uint32_t i = n.firstChild; i < n.firstChild + n.childCount; ++i) {
+            fuzzyVisit(i, n.depth, query, maxDistance, rows, out);
+        }
+    }
+
+public:
+    CompactTrie() { clear(); }
+
+    void clear() {
+        text = DynamicArray<char>();
+        keyStart = DynamicArray<size_t>();
+        keyStart.push_back(0);
+        values = DynamicArray<V>();
+        nodes = DynamicArray<Node>();
+        nodes.push_back(Node{0, 0, 0, 0, 0, 0});
+        labels = DynamicArray<unsigned char>();
+        labels.push_back(0);
+    }
+
+    // Replaces the contents with `entries`. Keys are folded to lower case;
+    // duplicates are kept, each with its own value.
+    //
+    // Built top-down as an MSD radix sort: each node distributes its keys
+    // on their byte at the node's depth, which orders them and yields its
+    // children in one pass. Work is linear in the total key length, with
+    // no string comparisons.
+    void build(const DynamicArray<std::pair<std::string, V>>& entries) {
+        clear();
+        size_t count = entries.size();
+
+        // Folded keys in input order; order[] is permuted into sorted order
+        DynamicArray<size_t> start(count + 1);
+        size_t bytes = 0;
+        for (size_t i = 0; i < count; ++i) {
+            start[i] = bytes;
+            bytes += entries[i].first.size();
+        }
+        start[count] = bytes;
+        DynamicArray<char> raw(bytes);
+        for (size_t i = 0; i < count; ++i) {
+            const std::string& name = entries[i].first;
+            for (size_t j = 0; j < name.size(); ++j) raw.data[start.data[i] + j] = fold(name[j]);
+        }
+        DynamicArray<uint32_t> order(count), scratch(count);
+        for (size_t i = 0; i < count; ++i) order[i] = static_cast<uint32_t>(i);
+
+        auto length = [&start](uint32_t key) { return start.data[key + 1] - start.data[key]; };
+        auto textOf = [&raw, &start](uint32_t key) { return raw.data + start.data[key]; };
+        // Bucket of a key at depth d: 0 if it ends there, else its byte + 1
+        auto bucketOf = [&](uint32_t key, size_t d) -> size_t {
+            return length(key) == d ? 0 : static_cast<unsigned char>(textOf(key)[d]) + 1;
+        };
+
+        // Breadth-first: nodes.size() grows as children are appended behind
+        // the node being expanded, which keeps siblings contiguous
+        nodes[0].keyHi = static_cast<uint32_t>(count);
+        size_t counts[257];
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            Node n = nodes[i];
+            uint32_t* keys = order.data;
+
+            if (n.keyHi - n.keyLo <= kInsertionRange) {
+                // Few keys: a stable insertion sort on the byte at this depth
+                for (uint32_t k = n.keyLo + 1; k < n.keyHi; ++k) {
+                    uint32_t key = keys[k];
+                    size_t bucket = bucketOf(key, n.depth);
+                    uint32_t j = k;
+                    for (; j > n.keyLo && bucketOf(keys[j - 1], n.depth) > bucket; --j) keys[j] = keys[j - 1];
+                    keys[j] = key;
+                }
+            } else {
+                for (size_t b = 0; b < 257; ++b) counts[b] = 0;
+                for (uint32_t k = n.keyLo; k < n.keyHi; ++k) ++counts[bucketOf(keys[k], n.depth)];
+                size_t offset = n.keyLo;
+                for (size_t b = 0; b < 257; ++b) {
+                    size_t c = counts[b];
+                    counts[b] = offset;
+                    offset += c;
+                }
+                for (uint32_t k = n.keyLo; k < n.keyHi; ++k) {
+                    scratch.data[counts[bucketOf(keys[k], n.depth)]++] = keys[k];
+                }
+                for (uint32_t k = n.keyLo; k < n.keyHi; ++k) keys[k] = scratch.data[k];
+            }
+
+            uint32_t k = n.keyLo;
+            while (k < n.keyHi && length(keys[k]) == n.depth) ++k;
+            n.terminalEnd = k;
+            n.firstChild = static_cast<uint32_t>(nodes.size());
+            while (k < n.keyHi) {
+                const char* first = textOf(keys[k]);
+                size_t depth = length(keys[k]);
+                uint32_t end = k + 1;
+                for (; end < n.keyHi && textOf(keys[end])[n.depth] == first[n.depth]; ++end) {
+                    // The child's prefix is what every key of the group shares
+                    const char* other = textOf(keys[end]);
+                    size_t limit = length(keys[end]) < depth ? length(keys[end]) : depth;
+                    size_t d = n.depth + 1;
+                    while (d < limit && other[d] == first[d]) ++d;
+                    depth = d;
+                }
+                nodes.push_back(Node{k, end, end, static_cast<uint32_t>(depth), 0, 0});
+                labels.push_back(static_cast<unsigned char>(first[n.depth]));
+                ++n.childCount;
+                k = end;
+            }
+            nodes[i] = n;
+        }
+
+        // Lay the keys out in sorted order
+        text = DynamicArray<char>(bytes);
+        keyStart = DynamicArray<size_t>(count + 1);
+        values = DynamicArray<V>(count);
+        size_t offset = 0;
+        for (size_t i = 0; i < count; ++i) {
+            uint32_t key = order[i];
+            keyStart[i] = offset;
+            for (size_t j = 0; j < length(key); ++j) text.data[offset + j] = textOf(key)[j];
+            offset += length(key);
+            values[i] = entries[order[i]].second;
+        }
+        keyStart[count] = offset;
+    }
+
+    size_t size() const { return values.size(); }
+    size_t nodeCount() const { return nodes.size(); }
+    std::string key(size_t i) const { return std::string(keyText(i), keyLength(i)); }
+    const V& value(size_t i) const { return values[i]; }
+
+    // Keys starting with `prefix` are the sorted range [lo, hi); false if none
+    bool prefixRange(const std::string& prefix, size_t& lo, size_t& hi) const {
+        uint32_t node = 0;
+        size_t pos = 0;
+        while (true) {
+            const Node& n = nodes.data[node];
+            if (n.keyLo == n.keyHi) return false;
+            const char* key = keyText(n.keyLo);
+            for (; pos < n.depth && pos < prefix.size(); ++pos) {
+                if (key[pos] != fold(prefix[pos])) return false;
+            }
+            if (pos == prefix.size()) {
+                lo = n.keyLo;
+                hi = n.keyHi;
+                return true;
+            }
+            node = child(node, fold(prefix[pos]));
+            if (node == 0) return false;
+        }
+    }
+
+    // Index of the first key equal to `name` (folded), or size() if absent
+    size_t find(const std::string& name) const {
+        size_t lo, hi;
+        if (!prefixRange(name, lo, hi) || keyLength(lo) != name.size()) return size();
+        return lo;
+    }
+
+    // Keys within maxDistance edits of `query`, closest first, ties in key
+    // order. Branches are cut once every alignment exceeds the bound, so
+    // the work grows with the matches and the bound, not with the key count.
+    DynamicArray<Match> fuzzySearch(const std::string& query, unsigned maxDistance, size_t limit) const {
+        std::string folded = query;
+        for (char& c : folded) c = fold(c);
+        size_t m = folded.size();
+
+        DynamicArray<Match> matches;
+        DynamicArray<unsigned> rows((m + maxDistance + 2) * (m + 1));
+        for (size_t j = 0; j <= m; ++j) rows[j] = static_cast<unsigned>(j);
+        fuzzyVisit(0, 0, folded, maxDistance, rows, matches);
+
+        algo::quick_sort(matches.begin(), matches.end(), [](const Match& a, const Match& b) {
+            return a.distance != b.distance ? a.distance < b.distance : a.key < b.key;
+        });
+        while (matches.size() > limit) matches.pop_back();
+        return matches;
+    }
+};
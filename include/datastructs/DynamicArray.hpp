@@ -1,4 +1,5 @@
 #pragma once
+#include "../Stats.hpp"
 #include <cstdlib>
 #include <stdexcept>
 #include <iterator>
@@ -12,15 +13,23 @@ public:
     size_t _size;
 
     void resize(size_t new_capacity) {
+        EXO_STATS_COUNT("dynamic_array.reallocations", 1);
+        EXO_STATS_COUNT("dynamic_array.bytes_copied", _size * sizeof(T));
         T* new_data = new T[new_capacity];
         for (size_t i = 0; i < _size; ++i) {
-            new_data[i] = data[i];
+            new_data[i] = std::move(data[i]);
         }
         delete[] data;
         data = new_data;
         _capacity = new_capacity;
     }
 
+    // Room for at least min_capacity elements, so pushes up to that many
+    // do not reallocate; never shrinks
+    void reserve(size_t min_capacity) {
+        if (min_capacity > _capacity) resize(min_capacity);
+    }
+
     // ✅ Default Constructor
     DynamicArray() : data(new T[1]), _capacity(1), _size(0) {}
 
@@ -35,6 +44,8 @@ public:
     // ✅ Copy Constructor (Deep Copy)
     DynamicArray(const DynamicArray& other) 
         : _capacity(other._capacity), _size(other._size) {
+        EXO_STATS_COUNT("dynamic_array.copies", 1);
+        EXO_STATS_COUNT("dynamic_array.bytes_copied", _size * sizeof(T));
         data = new T[_capacity];
         for (size_t i = 0; i < _size; ++i) {
             data[i] = other.data[i];
@@ -44,6 +55,8 @@ public:
     // ✅ Copy Assignment Operator (Deep Copy)
     DynamicArray& operator=(const DynamicArray& other) {
         if (this == &other) return *this; // Avoid self-assignment
+        EXO_STATS_COUNT("dynamic_array.copies", 1);
+        EXO_STATS_COUNT("dynamic_array.bytes_copied", other._size * sizeof(T));
 
         delete[] data; // Free old memory
 
@@ -104,11 +117,18 @@ public:
 
     void push_back(const T& value) {
         if (_size == _capacity) {
-            resize(_capacity * 2);
+            resize(_capacity ? _capacity * 2 : 1); // a moved-from array has none
         }
         data[_size++] = value;
     }
 
+    void push_back(T&& value) {
+        if (_size == _capacity) {
+            resize(_capacity ? _capacity * 2 : 1); // a moved-from array has none
+        }
+        data[_size++] = std::move(value);
+    }
+
     T& operator[](size_t index) {
         if (index >= _size) throw std::out_of_range("Index out of bounds");
         return data[index];
@@ -1,7 +1,11 @@
 #pragma once
 #include "DynamicArray.hpp"
+#include "Arena.hpp"
+#include "../Stats.hpp"
+#include <type_traits>
 
-template <typename K, typename V>
+// Alloc is a node allocation policy from Arena.hpp
+template <typename K, typename V, typename Alloc = HeapAllocator>
 class HashTable {
 private:
     struct Entry {
@@ -13,9 +17,34 @@ private:
 
     DynamicArray<Entry*> buckets;
     size_t _size;
+    Alloc alloc;
 
     size_t hash(const K& key) const {
-        return std::hash<K>{}(key) % buckets.size();
+        return hashKey(key) % buckets.size();
+    }
+
+    // The entry for key in bucket `index`, or nullptr
+    Entry* findEntry(const K& key, size_t index) const {
+        Entry* current = buckets[index];
+        size_t probes = 0;
+        while (current && !(current->key == key)) {
+            current = current->next;
+            ++probes;
+        }
+        EXO_STATS_SAMPLE("hash_table.probe_length", probes);
+        return current;
+    }
+
+    static size_t nextPrime(size_t n) {
+        if (n < 3) return 3;
+        if (n % 2 == 0) ++n;
+        for (;; n += 2) {
+            bool prime = true;
+            for (size_t d = 3; d * d <= n; d += 2) {
+                if (n % d == 0) { prime = false; break; }
+            }
+            if (prime) return n;
+        }
     }
 
 public:
@@ -29,72 +58,119 @@ public:
         clear();
     }
 
+    // The full hash the buckets are chosen from. Callers that already have
+    // it (see ShardedHashTable) pass it to the overloads taking keyHash.
+    static size_t hashKey(const K& key) {
+        return std::hash<K>{}(key);
+    }
+
     void insert(const K& key, const V& value) {
-        size_t index = hash(key);
-        Entry* current = buckets[index];
+        insert(key, value, hashKey(key));
+    }
 
-        while (current) {
-            if (current->key == key) {
-                current->value = value;
-                return;
-            }
-            current = current->next;
+    void insert(const K& key, const V& value, size_t keyHash) {
+        size_t index = keyHash % buckets.size();
+        if (Entry* existing = findEntry(key, index)) {
+            existing->value = value;
+            return;
         }
 
-        Entry* newEntry = new Entry(key, value);
+        Entry* newEntry = alloc.template create<Entry>(key, value);
         newEntry->next = buckets[index];
         buckets[index] = newEntry;
         _size++;
     }
 
-    bool contains(const K& key) const {
+    // Unlinks key's entry; false if there was none
+    bool erase(const K& key) {
         size_t index = hash(key);
-        Entry* current = buckets[index];
-
-        while (current) {
-            if (current->key == key) return true;
-            current = current->next;
+        for (Entry** link = &buckets[index]; *link; link = &(*link)->next) {
+            if ((*link)->key == key) {
+                Entry* entry = *link;
+                *link = entry->next;
+                alloc.destroy(entry);
+                _size--;
+                return true;
+            }
         }
         return false;
     }
 
-    V& operator[](const K& key) {
-        size_t index = hash(key);
-        Entry* current = buckets[index];
+    bool contains(const K& key) const {
+        return findEntry(key, hash(key)) != nullptr;
+    }
 
-        while (current) {
-            if (current->key == key) return current->value;
-            current = current->next;
-        }
+    // Pointer to the value for key, or nullptr: one lookup instead of
+    // contains() followed by operator[]
+    V* find(const K& key) {
+        Entry* entry = findEntry(key, hash(key));
+        return entry ? &entry->value : nullptr;
+    }
 
-        throw std::out_of_range("Key not found");
+    const V* find(const K& key) const {
+        Entry* entry = findEntry(key, hash(key));
+        return entry ? &entry->value : nullptr;
     }
 
-    const V& operator[](const K& key) const { // const overload
-        size_t index = hash(key);
-        Entry* current = buckets[index];
+    const V* find(const K& key, size_t keyHash) const {
+        Entry* entry = findEntry(key, keyHash % buckets.size());
+        return entry ? &entry->value : nullptr;
+    }
 
-        while (current) {
-            if (current->key == key) return current->value;
-            current = current->next;
-        }
+    V& operator[](const K& key) {
+        Entry* entry = findEntry(key, hash(key));
+        if (!entry) throw std::out_of_range("Key not found");
+        return entry->value;
+    }
 
-        throw std::out_of_range("Key not found");
+    const V& operator[](const K& key) const { // const overload
+        Entry* entry = findEntry(key, hash(key));
+        if (!entry) throw std::out_of_range("Key not found");
+        return entry->value;
     }
 
     void clear() {
+        // An arena frees every entry at once; only destructors need a walk
+        bool walk = !Alloc::kBulkRelease || !std::is_trivially_destructible<Entry>::value;
         for (size_t i = 0; i < buckets.size(); ++i) {
-            Entry* current = buckets[i];
+            Entry* current = walk ? buckets[i] : nullptr;
             while (current) {
                 Entry* temp = current;
                 current = current->next;
-                delete temp;
+                alloc.destroy(temp);
             }
             buckets[i] = nullptr;
         }
+        alloc.release();
         _size = 0;
     }
 
+    // Grow the bucket array (to a prime) so `count` keys average at most
+    // one entry per chain, and let the allocator set aside room for the
+    // entries. Existing entries are relinked, not copied.
+    void reserve(size_t count) {
+        if (count > _size) alloc.template reserve<Entry>(count - _size);
+        size_t capacity = nextPrime(count);
+        if (capacity <= buckets.size()) return;
+        EXO_STATS_COUNT("hash_table.rehashes", 1);
+
+        DynamicArray<Entry*> old(std::move(buckets));
+        buckets = DynamicArray<Entry*>(capacity);
+        for (size_t i = 0; i < capacity; ++i) {
+            buckets[i] = nullptr;
+        }
+        for (size_t i = 0; i < old.size(); ++i) {
+            Entry* current = old[i];
+            while (current) {
+                Entry* next = current->next;
+                size_t index = hash(current->key);
+                current->next = buckets[index];
+                buckets[index] = current;
+                current = next;
+            }
+        }
+    }
+
     size_t size() const { return _size; }
     size_t bucketCount() const { return buckets.size(); }
 
@@ -0,0 +1,143 @@
+#pragma once
+#include "DynamicArray.hpp"
+#include "../Stats.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+
+// Max-heap whose entries can be changed or removed after insertion, through
+// the handle push returns: a d-ary heap of handles (laid out as in MaxHeap)
+// plus, per handle, its value and its position in the heap, so update_key
+// and erase are O(log n). Handles of removed entries are reused by later
+// pushes.
+template <typename T, typename Compare = std::less<T>, size_t Arity = 4>
+class IndexedMaxHeap {
+    static_assert(Arity >= 2, "a heap node needs at least two children");
+
+public:
+    using Handle = size_t;
+
+private:
+    static constexpr size_t kAbsent = SIZE_MAX;
+
+    DynamicArray<Handle> heap;      // handles in heap order
+    DynamicArray<T> values;         // by handle
+    DynamicArray<size_t> positions; // by handle: index in heap, or kAbsent
+    DynamicArray<Handle> freeHandles;
+    Compare comp;
+
+    bool less(Handle a, Handle b) const { return comp(values[a], values[b]); }
+
+    void place(size_t index, Handle handle) {
+        heap[index] = handle;
+        positions[handle] = index;
+    }
+
+    void siftUp(size_t index) {
+        Handle handle = heap[index];
+        while (index > 0) {
+            size_t parent = (index - 1) / Arity;
+            if (!less(heap[parent], handle)) break;
+            EXO_STATS_COUNT("heap.sift_moves", 1);
+            place(index, heap[parent]);
+            index = parent;
+        }
+        place(index, handle);
+    }
+
+    void siftDown(size_t index) {
+        size_t n = heap.size();
+        Handle handle = heap[index];
+        while (true) {
+            size_t first = Arity * index + 1;
+            if (first >= n) break;
+            size_t last = first + Arity < n ? first + Arity : n;
+            size_t largest = first;
+            for (size_t child = first + 1; child < last; ++child) {
+                if (less(heap[largest], heap[child])) largest = child;
+            }
+            if (!less(handle, heap[largest])) break;
+            EXO_STATS_COUNT("heap.sift_moves", 1);
+            place(index, heap[largest]);
+            index = largest;
+        }
+        place(index, handle);
+    }
+
+    void requireHandle(Handle handle) const {
+        if (!contains(handle)) throw std::out_of_range("Heap handle is not in the heap");
+    }
+
+public:
+    IndexedMaxHeap(const Compare& comp = Compare()) : comp(comp) {}
+
+    Handle push(T value) {
+        EXO_STATS_COUNT("heap.pushes", 1);
+        Handle handle;
+        if (!freeHandles.empty()) {
+            handle = freeHandles.back();
+            freeHandles.pop_back();
+            values[handle] = std::move(value);
+        } else {
+            handle = values.size();
+            values.push_back(std::move(value));
+            positions.push_back(kAbsent);
+        }
+        heap.push_back(handle);
+        siftUp(heap.size() - 1);
+        return handle;
+    }
+
+    const T& top() const {
+        if (heap.empty()) throw std::out_of_range("Heap is empty");
+        return values[heap[0]];
+    }
+
+    Handle top_handle() const {
+        if (heap.empty()) throw std::out_of_range("Heap is empty");
+        return heap[0];
+    }
+
+    void pop() {
+        if (heap.empty()) return;
+        EXO_STATS_COUNT("heap.pops", 1);
+        erase(heap[0]);
+    }
+
+    bool contains(Handle handle) const {
+        return handle < positions.size() && positions[handle] != kAbsent;
+    }
+
+    const T& value(Handle handle) const {
+        requireHandle(handle);
+        return values[handle];
+    }
+
+    // Gives an entry a new value and restores heap order around it,
+    // whichever way the value moved
+    void update_key(Handle handle, T value) {
+        requireHandle(handle);
+        values[handle] = std::move(value);
+        siftUp(positions[handle]);
+        siftDown(positions[handle]);
+    }
+
+    void erase(Handle handle) {
+        requireHandle(handle);
+        size_t index = positions[handle];
+        Handle last = heap.back();
+        heap.pop_back();
+        positions[handle] = kAbsent;
+        values[handle] = T(); // release what the value holds
+        freeHandles.push_back(handle);
+        if (index < heap.size()) {
+            place(index, last);
+            siftUp(index);
+            siftDown(positions[last]);
+        }
+    }
+
+    bool empty() const { return heap.empty(); }
+    size_t size() const { return heap.size(); }
+};
@@ -0,0 +1,139 @@
+#pragma once
+#include "DynamicArray.hpp"
+#include "../algorithms/parallel.hpp"
+#include <cstddef>
+#include <utility>
+
+// Static interval tree over closed intervals [start, end]; T is any type
+// with double start and end members. The intervals are kept sorted by
+// start in one flat array that doubles as an implicit binary tree: index i
+// sits at the level given by its trailing one bits, with its subtree
+// spanning the indices around it, and each inner node records the
+// greatest end in its subtree. Queries descend only into subtrees that can
+// reach the query, so they cost O(log n + matches) with no pointers.
+template <typename T>
+class IntervalTree {
+    // Subtrees this small are scanned instead of descended
+    static const size_t kScanLevel = 3;
+
+    DynamicArray<T> items;       // by start
+    DynamicArray<double> maxEnd; // per index: greatest end in its subtree
+    size_t rootLevel = 0;
+
+    void sortByStart() {
+        size_t n = items.size();
+        size_t i = 1;
+        while (i < n && !(items.data[i].start < items.data[i - 1].start)) ++i;
+        if (i >= n) return; // already in order
+        algo::parallel_quick_sort(items.data, items.data + n,
+                                  [](const T& a, const T& b) { return a.start < b.start; });
+    }
+
+    void build() {
+        size_t n = items.size();
+        maxEnd = DynamicArray<double>(n);
+        if (n == 0) return;
+
+        // Leaves are the even indices; `last` is the greatest end under
+        // the rightmost node of the previous level, standing in for right
+        // children past the end of the array
+        size_t lastIndex = 0;
+        double last = 0.0;
+        for (size_t i = 0; i < n; i += 2) {
+            lastIndex = i;
+            last = maxEnd.data[i] = items.data[i].end;
+        }
+        size_t level = 1;
+        for (; (size_t(1) << level) <= n; ++level) {
+            size_t half = size_t(1) << (level - 1);
+            for (size_t i = 2 * half - 1; i < n; i += 4 * half) {
+                double value = items.data[i].end;
+                double left = maxEnd.data[i - half];
+                double right = i + half < n ? maxEnd.data[i + half] : last;
+                if (left > value) value = left;
+                if (right > value) value = right;
+                maxEnd.data[i] = value;
+            }
+            lastIndex = (lastIndex >> level & 1) ? lastIndex - half : lastIndex + half;
+            if (lastIndex < n && maxEnd.data[lastIndex] > last) last = maxEnd.data[lastIndex];
+        }
+        rootLevel = level - 1;
+    }
+
+public:
+    IntervalTree() = default;
+
+    // Intervals already in start order are taken as they are
+    explicit IntervalTree(DynamicArray<T> intervals) : items(std::move(intervals)) {
+        sortByStart();
+        build();
+    }
+
+    size_t size() const { return items.size(); }
+    bool empty() const { return items.empty(); }
+
+    // Intervals in start order
+    const T& operator[](size_t i) const { return items[i]; }
+    const DynamicArray<T>& intervals() const { return items; }
+
+    // Calls visit(i) for every interval i that meets [low, high]
+    template <typename Visit>
+    void forEachOverlapping(double low, double high, Visit visit) const {
+        size_t n = items.size();
+        if (n == 0 || low > high) return;
+
+        struct Frame {
+            size_t index, level;
+            bool leftDone;
+        };
+        Frame stack[2 * (sizeof(size_t) * 8 + 1)];
+        size_t top = 0;
+        stack[top++] = Frame{(size_t(1) << rootLevel) - 1, rootLevel, false};
+        while (top > 0) {
+            Frame frame = stack[--top];
+            if (frame.level <= kScanLevel) {
+                size_t first = frame.index >> frame.level << frame.level;
+                size_t stop = first + (size_t(2) << frame.level) - 1;
+                if (stop > n) stop = n;
+                for (size_t i = first; i < stop && items.data[i].start <= high; ++i) {
+                    if (items.data[i].end >= low) visit(i);
+                }
+            } else if (!frame.leftDone) {
+                size_t left = frame.index - (size_t(1) << (frame.level - 1));
+                stack[top++] = Frame{frame.index, frame.level, true};
+                // A left child past the end stores no maximum but may hold the tail
+                if (left >= n || maxEnd.data[left] >= low) {
+                    stack[top++] = Frame{left, frame.level - 1, false};
+                }
+            } else if (frame.index < n && items.data[frame.index].start <= high) {
+                if (items.data[frame.index].end >= low) visit(frame.index);
+                stack[top++] = Frame{frame.index + (size_t(1) << (frame.level - 1)), frame.level - 1, false};
+            }
+        }
+    }
+
+    // Indices of the intervals that meet [low, high], in start order
+    DynamicArray<size_t> overlapping(double low, double high) const {
+        DynamicArray<size_t> found;
+        forEachOverlapping(low, high, [&found](size_t i) { found.push_back(i); });
+        algo::quick_sort(found.data, found.data + found.size());
+        return found;
+    }
+
+    // Indices of the intervals containing point
+    DynamicArray<size_t> stab(double point) const { return overlapping(point, point); }
+
+    // Calls visit(i, j), i < j, once for every pair of intervals that meet,
+    // until visit returns false. A sweep in start order: interval i meets
+    // exactly those after it that start before it ends.
+    template <typename Visit>
+    void forEachOverlappingPair(Visit visit) const {
+        size_t n = items.size();
+        for (size_t i = 0; i < n; ++i) {
+            double end = items.data[i].end;
+            for (size_t j = i + 1; j < n && items.data[j].start <= end; ++j) {
+                if (!visit(i, j)) return;
+            }
+        }
+    }
+};
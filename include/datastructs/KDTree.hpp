@@ -0,0 +1,167 @@
+#pragma once
+#include "DynamicArray.hpp"
+#include "MaxHeap.hpp"
+#include "../algorithms/sorting.hpp"
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+// Static k-d tree over points of a fixed (runtime) dimension. Points are
+// stored in tree order in one flat array, so a subtree is a contiguous
+// range and leaves are scanned linearly. Queries take per-dimension weights:
+// distance^2 = sum_d w[d] * (p[d] - q[d])^2.
+template <typename V>
+class KDTree {
+public:
+    struct Neighbor {
+        V value;
+        double distance;
+    };
+
+private:
+    static const size_t kLeafSize = 8;
+
+    size_t dims;
+    DynamicArray<double> coords;   // point i at coords[i * dims]
+    DynamicArray<V> values;
+    DynamicArray<size_t> splitDim; // per median position of an inner range
+
+    const double* point(size_t i) const { return coords.data + i * dims; }
+
+    double distance2(const double* p, const double* q, const double* weights) const {
+        double sum = 0.0;
+        for (size_t d = 0; d < dims; ++d) {
+            double diff = p[d] - q[d];
+            sum += (weights ? weights[d] : 1.0) * diff * diff;
+        }
+        return sum;
+    }
+
+    // Splits [lo, hi) of `order` at its median along the widest dimension
+    void build(DynamicArray<size_t>& order, const DynamicArray<double>& source,
+               size_t lo, size_t hi) {
+        if (hi - lo <= kLeafSize) return;
+
+        size_t dim = 0;
+        double widest = -1.0;
+        for (size_t d = 0; d < dims; ++d) {
+            double lowest = source[order[lo] * dims + d], highest = lowest;
+            for (size_t i = lo + 1; i < hi; ++i) {
+                double v = source[order[i] * dims + d];
+                if (v < lowest) lowest = v;
+                if (v > highest) highest = v;
+            }
+            if (highest - lowest > widest) {
+                widest = highest - lowest;
+                dim = d;
+            }
+        }
+
+        size_t mid = lo + (hi - lo) / 2;
+        const double* data = source.data;
+        size_t stride = dims;
+        algo::quick_select(order.begin() + lo, order.begin() + mid, order.begin() + hi,
+            [data, stride, dim](size_t a, size_t b) {
+                return data[a * stride + dim] < data[b * stride + dim];
+            });
+        splitDim[mid] = dim;
+
+        build(order, source, lo, mid);
+        build(order, source, mid + 1, hi);
+    }
+
+    template <typename Visit>
+    void search(size_t lo, size_t hi, const double* query, const double* weights,
+                double& bound, Visit& visit) const {
+        if (hi - lo <= kLeafSize) {
+            for (size_t i = lo; i < hi; ++i) {
+                double d2 = distance2(point(i), query, weights);
+                if (d2 <= bound) visit(i, d2, bound);
+            }
+            return;
+        }
+
+        size_t mid = lo + (hi - lo) / 2;
+        size_t dim = splitDim[mid];
+        double diff = query[dim] - point(mid)[dim];
+        double planeDistance = (weights ? weights[dim] : 1.0) * diff * diff;
+
+        double d2 = distance2(point(mid), query, weights);
+        if (d2 <= bound) visit(mid, d2, bound);
+
+        // Nearer side first so the bound shrinks before the far side
+        if (diff < 0) {
+            search(lo, mid, query, weights, bound, visit);
+            if (planeDistance <= bound) search(mid + 1, hi, query, weights, bound, visit);
+        } else {
+            search(mid + 1, hi, query, weights, bound, visit);
+            if (planeDistance <= bound) search(lo, mid, query, weights, bound, visit);
+        }
+    }
+
+public:
+    explicit KDTree(size_t dimensions = 1) : dims(dimensions) {}
+
+    // points holds n rows of `dimensions` coordinates, values one entry per row
+    void build(size_t dimensions, const DynamicArray<double>& points, const DynamicArray<V>& pointValues) {
+        if (dimensions == 0 || points.size() != pointValues.size() * dimensions) {
+            throw std::invalid_argument("KDTree: points do not match dimensions");
+        }
+        dims = dimensions;
+        size_t n = pointValues.size();
+
+        DynamicArray<size_t> order(n);
+        for (size_t i = 0; i < n; ++i) order[i] = i;
+        splitDim = DynamicArray<size_t>(n);
+        build(order, points, 0, n);
+
+        // Lay the points out in tree order
+        coords = DynamicArray<double>(n * dims);
+        values = DynamicArray<V>(n);
+        for (size_t i = 0; i < n; ++i) {
+            for (size_t d = 0; d < dims; ++d) {
+                coords[i * dims + d] = points[order[i] * dims + d];
+            }
+            values[i] = pointValues[order[i]];
+        }
+    }
+
+    // The k nearest points, closest first. weights may be nullptr.
+    DynamicArray<Neighbor> nearest(const double* query, size_t k, const double* weights = nullptr) const {
+        DynamicArray<Neighbor> result;
+        if (k == 0 || values.empty()) return result;
+
+        // Max-heap of the best k so far; its top is the current bound
+        MaxHeap<std::pair<double, size_t>> best;
+        double bound = INFINITY;
+        auto visit = [&best, k](size_t i, double d2, double& limit) {
+            if (best.size() < k) best.emplace(d2, i);
+            else best.replace_top(std::make_pair(d2, i));
+            if (best.size() == k) limit = best.top().first;
+        };
+        search(0, values.size(), query, weights, bound, visit);
+
+        DynamicArray<Neighbor> reversed;
+        while (!best.empty()) {
+            reversed.push_back(Neighbor{values[best.top().second], std::sqrt(best.top().first)});
+            best.pop();
+        }
+        for (size_t i = reversed.size(); i > 0; --i) result.push_back(reversed[i - 1]);
+        return result;
+    }
+
+    // Every point within `radius` of the query, in no particular order
+    DynamicArray<Neighbor> within(const double* query, double radius, const double* weights = nullptr) const {
+        DynamicArray<Neighbor> result;
+        double bound = radius * radius;
+        auto visit = [this, &result](size_t i, double d2, double&) {
+            result.push_back(Neighbor{values[i], std::sqrt(d2)});
+        };
+        search(0, values.size(), query, weights, bound, visit);
+        return result;
+    }
+
+    size_t size() const { return values.size(); }
+    size_t dimensions() const { return dims; }
+    bool empty() const { return values.empty(); }
+};
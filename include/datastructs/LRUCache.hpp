@@ -0,0 +1,122 @@
+#pragma once
+#include "HashTable.hpp"
+#include "../Stats.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+// Least-recently-used cache bounded by the total cost of its entries (e.g.
+// bytes) rather than their number. Entries form a list, most recently used
+// first, and a hash table maps each key to its node, so get and put are
+// O(1) apart from the evictions a put makes room with. An entry costing
+// more than the whole capacity is not kept.
+template <typename K, typename V>
+class LRUCache {
+private:
+    struct Node {
+        K key;
+        V value;
+        size_t cost;
+        Node* prev;
+        Node* next;
+    };
+
+    HashTable<K, Node*> index;
+    Node* head = nullptr; // most recently used
+    Node* tail = nullptr;
+    size_t _capacity;
+    size_t _cost = 0;
+    uint64_t _hits = 0, _misses = 0, _evictions = 0;
+
+    void unlink(Node* node) {
+        (node->prev ? node->prev->next : head) = node->next;
+        (node->next ? node->next->prev : tail) = node->prev;
+    }
+
+    void pushFront(Node* node) {
+        node->prev = nullptr;
+        node->next = head;
+        (head ? head->prev : tail) = node;
+        head = node;
+    }
+
+    void evictDownTo(size_t limit) {
+        while (tail && _cost > limit) {
+            Node* victim = tail;
+            unlink(victim);
+            index.erase(victim->key);
+            _cost -= victim->cost;
+            delete victim;
+            ++_evictions;
+            EXO_STATS_COUNT("lru_cache.evictions", 1);
+        }
+    }
+
+public:
+    explicit LRUCache(size_t capacity) : index(211), _capacity(capacity) {}
+    ~LRUCache() { clear(); }
+    LRUCache(const LRUCache&) = delete;
+    LRUCache& operator=(const LRUCache&) = delete;
+
+    // The value for key, now the most recently used, or nullptr
+    const V* get(const K& key) {
+        Node** found = index.find(key);
+        if (!found) {
+            ++_misses;
+            EXO_STATS_COUNT("lru_cache.misses", 1);
+            return nullptr;
+        }
+        ++_hits;
+        EXO_STATS_COUNT("lru_cache.hits", 1);
+        Node* node = *found;
+        if (node != head) {
+            unlink(node);
+            pushFront(node);
+        }
+        return &node->value;
+    }
+
+    // Stores value under key, evicting least recently used entries until
+    // it fits; false, keeping nothing, if cost exceeds the capacity
+    bool put(const K& key, V value, size_t cost) {
+        if (Node** found = index.find(key)) {
+            Node* old = *found;
+            unlink(old);
+            index.erase(key);
+            _cost -= old->cost;
+            delete old;
+        }
+        if (cost > _capacity) return false;
+        evictDownTo(_capacity - cost);
+        Node* node = new Node{key, std::move(value), cost, nullptr, nullptr};
+        pushFront(node);
+        if (index.size() >= index.bucketCount()) index.reserve(index.size() * 2);
+        index.insert(key, node);
+        _cost += cost;
+        return true;
+    }
+
+    void clear() {
+        while (head) {
+            Node* next = head->next;
+            delete head;
+            head = next;
+        }
+        tail = nullptr;
+        index.clear();
+        _cost = 0;
+    }
+
+    // Shrinking evicts at once; 0 turns the cache off
+    void setCapacity(size_t capacity) {
+        _capacity = capacity;
+        evictDownTo(capacity);
+    }
+
+    size_t size() const { return index.size(); }
+    size_t cost() const { return _cost; }
+    size_t capacity() const { return _capacity; }
+    uint64_t hits() const { return _hits; }
+    uint64_t misses() const { return _misses; }
+    uint64_t evictions() const { return _evictions; }
+};
@@ -1,62 +1,114 @@
 #pragma once
 #include "DynamicArray.hpp"
+#include "../Stats.hpp"
+#include <cstddef>
 #include <functional>
+#include <utility>
 
-template <typename T, typename Compare = std::less<T>>
+// d-ary max-heap: the top is the greatest element under Compare. A node's
+// Arity children sit next to each other, so the default 4-ary layout
+// halves the depth of a binary heap and reads a node's children from one
+// or two cache lines. Sifting moves elements into a hole instead of
+// swapping them.
+template <typename T, typename Compare = std::less<T>, size_t Arity = 4>
 class MaxHeap {
+    static_assert(Arity >= 2, "a heap node needs at least two children");
+
     DynamicArray<T> heap;
     Compare comp;
 
     void heapify_up(size_t index) {
+        T value = std::move(heap[index]);
         while (index > 0) {
-            size_t parent = (index - 1) / 2;
-            if (comp(heap[parent], heap[index])) {
-                std::swap(heap[parent], heap[index]);
-                index = parent;
-            } else {
-                break;
-            }
+            size_t parent = (index - 1) / Arity;
+            if (!comp(heap[parent], value)) break;
+            EXO_STATS_COUNT("heap.sift_moves", 1);
+            heap[index] = std::move(heap[parent]);
+            index = parent;
         }
+        heap[index] = std::move(value);
     }
 
     void heapify_down(size_t index) {
+        size_t n = heap.size();
+        T value = std::move(heap[index]);
         while (true) {
-            size_t left = 2 * index + 1;
-            size_t right = 2 * index + 2;
-            size_t largest = index;
-
-            if (left < heap.size() && comp(heap[largest], heap[left])) {
-                largest = left;
-            }
-
-            if (right < heap.size() && comp(heap[largest], heap[right])) {
-                largest = right;
-            }
-
-            if (largest != index) {
-                std::swap(heap[index], heap[largest]);
-                index = largest;
-            } else {
-                break;
+            size_t first = Arity * index + 1;
+            if (first >= n) break;
+            size_t last = first + Arity < n ? first + Arity : n;
+            size_t largest = first;
+            for (size_t child = first + 1; child < last; ++child) {
+                if (comp(heap[largest], heap[child])) largest = child;
             }
+            if (!comp(value, heap[largest])) break;
+            EXO_STATS_COUNT("heap.sift_moves", 1);
+            heap[index] = std::move(heap[largest]);
+            index = largest;
         }
+        heap[index] = std::move(value);
     }
 
 public:
     MaxHeap(const Compare& comp = Compare()) : comp(comp) {}
-    
+
+    // Bulk build in O(n) (Floyd): sift down every internal node, last first
+    explicit MaxHeap(DynamicArray<T> values, const Compare& comp = Compare())
+        : heap(std::move(values)), comp(comp) {
+        EXO_STATS_COUNT("heap.bulk_builds", 1);
+        if (heap.size() < 2) return;
+        for (size_t i = (heap.size() - 2) / Arity + 1; i-- > 0;) heapify_down(i);
+    }
+
     void push(const T& value) {
+        EXO_STATS_COUNT("heap.pushes", 1);
         heap.push_back(value);
         heapify_up(heap.size() - 1);
     }
 
+    void push(T&& value) {
+        EXO_STATS_COUNT("heap.pushes", 1);
+        heap.push_back(std::move(value));
+        heapify_up(heap.size() - 1);
+    }
+
+    template <typename... Args>
+    void emplace(Args&&... args) {
+        push(T(std::forward<Args>(args)...));
+    }
+
     void pop() {
         if (heap.empty()) return;
-        heap[0] = heap.back();
+        EXO_STATS_COUNT("heap.pops", 1);
+        if (heap.size() > 1) heap[0] = std::move(heap.back());
         heap.pop_back();
         if (!heap.empty()) heapify_down(0);
     }
 
+    // Removes and returns the top
+    T pop_top() {
+        if (heap.empty()) throw std::out_of_range("Heap is empty");
+        T top = std::move(heap[0]);
+        pop();
+        return top;
+    }
+
+    // Puts value in place of the top: one sift instead of a pop and a
+    // push, which is what streaming top-k does once its heap is full
+    void replace_top(T value) {
+        if (heap.empty()) throw std::out_of_range("Heap is empty");
+        EXO_STATS_COUNT("heap.replacements", 1);
+        heap[0] = std::move(value);
+        heapify_down(0);
+    }
+
+    // replace_top, returning the top it removed
+    T pop_push(T value) {
+        if (heap.empty()) throw std::out_of_range("Heap is empty");
+        T top = std::move(heap[0]);
+        replace_top(std::move(value));
+        return top;
+    }
+
     const T& top() const {
         if (heap.empty()) throw std::out_of_range("Heap is empty");
         return heap[0];
@@ -64,4 +116,4 @@ public:
 
     bool empty() const { return heap.empty(); }
     size_t size() const { return heap.size(); }
-};
\ No newline at end of file
+};
@@ -0,0 +1,142 @@
+#pragma once
+#include "DynamicArray.hpp"
+#include "HashTable.hpp"
+#include "../algorithms/parallel.hpp"
+#include "../Stats.hpp"
+#include <cstddef>
+#include <cstdint>
+
+// A HashTable split into 2^ShardBits shards by the top bits of each key's
+// (mixed) hash, so every shard owns a disjoint set of keys and has its own
+// buckets and allocator. The bucket within a shard comes from the same
+// hash, computed once per lookup.
+//
+// build() fills the table on every worker without locks: keys are first
+// partitioned by shard, keeping their order, and then each shard inserts
+// its own keys on one thread. A key that comes up twice keeps the value
+// given last, exactly as inserting one by one would, so the table holds
+// the same entries whatever the thread count.
+template <typename K, typename V, typename Alloc = HeapAllocator, unsigned ShardBits = 6>
+class ShardedHashTable {
+public:
+    static const size_t kShards = size_t(1) << ShardBits;
+
+private:
+    using Shard = HashTable<K, V, Alloc>;
+
+    // Keys per task when partitioning in build()
+    static const size_t kPartitionGrain = 16384;
+
+    // Marks a position build() skips
+    static const uint8_t kSkip = 0xFF;
+    static_assert(kShards < kSkip, "shard ids must fit below kSkip");
+
+    Shard shards[kShards];
+
+    // Fibonacci mixing, so integer keys (whose std::hash is the value)
+    // spread over the shards too
+    static size_t shardOf(size_t keyHash) {
+        return static_cast<size_t>((static_cast<uint64_t>(keyHash) * 0x9E3779B97F4A7C15ull) >> (64 - ShardBits));
+    }
+
+public:
+    void insert(const K& key, const V& value) {
+        size_t keyHash = Shard::hashKey(key);
+        shards[shardOf(keyHash)].insert(key, value, keyHash);
+    }
+
+    const V* find(const K& key) const {
+        size_t keyHash = Shard::hashKey(key);
+        return shards[shardOf(keyHash)].find(key, keyHash);
+    }
+
+    bool contains(const K& key) const { return find(key) != nullptr; }
+
+    // Inserts keyAt(i) => valueAt(i) for i in [0, count), in that order as
+    // far as duplicates go. keyAt returns a const K*, nullptr to skip i.
+    template <typename KeyAt, typename ValueAt>
+    void build(size_t count, KeyAt keyAt, ValueAt valueAt) {
+        // Partitioning only pays off when shards can fill side by side
+        if (algo::worker_count() <= 1 || count <= kPartitionGrain) {
+            for (auto& shard : shards) shard.reserve(shard.size() + count / kShards + 1);
+            for (size_t i = 0; i < count; ++i) {
+                if (const K* key = keyAt(i)) insert(*key, valueAt(i));
+            }
+            return;
+        }
+
+        // Hash every key and count each chunk's keys per shard
+        size_t chunks = (count + kPartitionGrain - 1) / kPartitionGrain;
+        DynamicArray<size_t> hashes(count);
+        DynamicArray<uint8_t> shardIds(count);
+        DynamicArray<size_t> slots(chunks * kShards); // counts, then next free slot
+        algo::parallel_for(chunks, 1, [&](size_t begin, size_t end) {
+            for (size_t chunk = begin; chunk < end; ++chunk) {
+                size_t* counts = slots.data + chunk * kShards;
+                for (size_t s = 0; s < kShards; ++s) counts[s] = 0;
+                size_t last = (chunk + 1) * kPartitionGrain < count ? (chunk + 1) * kPartitionGrain : count;
+                for (size_t i = chunk * kPartitionGrain; i < last; ++i) {
+                    const K* key = keyAt(i);
+                    if (!key) {
+                        shardIds.data[i] = kSkip;
+                        continue;
+                    }
+                    hashes.data[i] = Shard::hashKey(*key);
+                    shardIds.data[i] = static_cast<uint8_t>(shardOf(hashes.data[i]));
+                    ++counts[shardIds.data[i]];
+                }
+            }
+        });
+
+        // Lay the shards out one after another, each chunk's keys after
+        // those of the chunks before it
+        DynamicArray<size_t> shardStart(kShards + 1);
+        size_t total = 0;
+        for (size_t s = 0; s < kShards; ++s) {
+            shardStart.data[s] = total;
+            for (size_t chunk = 0; chunk < chunks; ++chunk) {
+                size_t n = slots.data[chunk * kShards + s];
+                slots.data[chunk * kShards + s] = total;
+                total += n;
+            }
+        }
+        shardStart.data[kShards] = total;
+
+        DynamicArray<size_t> order(total);
+        algo::parallel_for(chunks, 1, [&](size_t begin, size_t end) {
+            for (size_t chunk = begin; chunk < end; ++chunk) {
+                size_t* next = slots.data + chunk * kShards;
+                size_t last = (chunk + 1) * kPartitionGrain < count ? (chunk + 1) * kPartitionGrain : count;
+                for (size_t i = chunk * kPartitionGrain; i < last; ++i) {
+                    if (shardIds.data[i] != kSkip) order.data[next[shardIds.data[i]]++] = i;
+                }
+            }
+        });
+
+        // Each shard inserts its keys, in order, on one thread
+        algo::parallel_for(kShards, 1, [&](size_t begin, size_t end) {
+            for (size_t s = begin; s < end; ++s) {
+                Shard& shard = shards[s];
+                shard.reserve(shard.size() + shardStart.data[s + 1] - shardStart.data[s]);
+                for (size_t k = shardStart.data[s]; k < shardStart.data[s + 1]; ++k) {
+                    size_t i = order.data[k];
+                    shard.insert(*keyAt(i), valueAt(i), hashes.data[i]);
+                }
+            }
+        });
+        EXO_STATS_COUNT("sharded_hash_table.built_keys", total);
+    }
+
+    // Shards are cleared in parallel; their entries may have destructors
+    void clear() {
+        algo::parallel_for(kShards, 1, [this](size_t begin, size_t end) {
+            for (size_t s = begin; s < end; ++s) shards[s].clear();
+        });
+    }
+
+    size_t size() const {
+        size_t total = 0;
+        for (const auto& shard : shards) total += shard.size();
+        return total;
+    }
+};
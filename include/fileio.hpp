@@ -1,12 +1,86 @@
 #pragma once
 #include "Exoplanet.hpp"
+#include "Columns.hpp"
+#include "Compression.hpp"
+#include "MappedFile.hpp"
+#include "datastructs/DynamicArray.hpp"
+#include <cstddef>
+#include <cstdint>
 #include <string>
 
 // Forward declaration to resolve circular dependency
 class ExoplanetCatalog;
+struct LoadProgress;
+
+// Why a field kept its row from loading
+enum class FieldError : uint8_t {
+    None,
+    Missing,    // the row ends before a required field
+    NotInteger, // identity or flag field that is not a whole number
+    NotNumber,  // numeric field that is not a number
+    OutOfRange, // a number beyond what the field holds
+    Count
+};
+const char* fieldErrorName(FieldError error);
+
+// What the CSV loaders do with rows that do not parse. Rejected rows are
+// written with their line number, column and reason to quarantineFile, if
+// set. The load fails, adding nothing, once more than maxRejectedRows rows
+// or a larger fraction of the data rows than maxRejectedFraction are
+// rejected.
+struct ParsePolicy {
+    std::string quarantineFile;
+    size_t maxRejectedRows = SIZE_MAX;
+    double maxRejectedFraction = 1.0;
+};
+
+// Row counts of one load, rejections broken down by reason
+struct ParseSummary {
+    size_t accepted = 0;
+    size_t rejected = 0;
+    size_t byError[static_cast<size_t>(FieldError::Count)] = {};
+
+    bool withinLimits(const ParsePolicy& policy) const;
+};
+
+// A side table keyed on kepid, e.g. host-star parameters: one row of
+// numeric values per star, row-major in `values`
+struct StellarTable {
+    DynamicArray<std::string> columns;
+    DynamicArray<int> kepids;
+    DynamicArray<double> values;
+};
 
 class FileIO {
 public:
-    static bool parseCSV(const std::string& filename, ExoplanetCatalog& catalog);
+    // Rows are parsed without exceptions: each field reports a FieldError,
+    // and a row with any is rejected as the policy says. summary, if
+    // given, receives the counts.
+    static bool parseCSV(const std::string& filename, ExoplanetCatalog& catalog,
+                         LoadProgress* progress = nullptr, const ParsePolicy& policy = ParsePolicy(),
+                         ParseSummary* summary = nullptr);
     static bool writeCSV(const std::string& filename, const DynamicArray<Exoplanet>& planets);
-};
\ No newline at end of file
+    // From the first bytes of the file; parseCSV reads gzip and zstd input
+    // as it is, without a temporary copy (see CompressedReader)
+    static Compression compressionOf(const std::string& filename);
+    // Only planets[rows[0]], planets[rows[1]], ... in that order
+    static bool writeCSV(const std::string& filename, const DynamicArray<Exoplanet>& planets,
+                         const DynamicArray<size_t>& rows);
+
+    // Reads a CSV whose first non-comment line names the columns. Keeps the
+    // kepid column plus those of `wanted` present in the header.
+    static bool parseStellarCSV(const std::string& filename,
+                                const DynamicArray<std::string>& wanted, StellarTable& table);
+
+    // Lazy loading: decode only `columns` of each row in a mapped CSV and
+    // record where every accepted row starts, so the remaining columns can
+    // be decoded later with decodeColumns. Every field is validated, as in
+    // parseCSV, so a bad field in any column rejects the row; only
+    // `columns` are stored.
+    static bool indexCSV(const MappedFile& file, ColumnMask columns,
+                         ExoplanetCatalog& catalog, DynamicArray<size_t>& rowOffsets,
+                         const ParsePolicy& policy = ParsePolicy(), ParseSummary* summary = nullptr);
+    static void decodeColumns(const MappedFile& file, const DynamicArray<size_t>& rowOffsets,
+                              ColumnMask columns, DynamicArray<Exoplanet>& planets,
+                              size_t firstRow);
+};
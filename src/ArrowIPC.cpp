@@ -0,0 +1,1076 @@
+#include "../include/ArrowIPC.hpp"
+#include "../include/algorithms/parallel.hpp"
+#include "../include/datastructs/HashTable.hpp"
+#include "../include/Stats.hpp"
+#include "../include/Trace.hpp"
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+// Rows per record batch written
+const size_t kBatchRows = 1 << 16;
+
+// Arrow buffers start on 8-byte boundaries
+const size_t kBufferAlignment = 8;
+
+const char kMagic[] = "ARROW1";
+const size_t kMagicSize = 6;
+const uint32_t kContinuation = 0xFFFFFFFF;
+
+// Enum values from the Arrow flatbuffer schemas (Schema.fbs, Message.fbs)
+const int16_t kMetadataV5 = 4;
+const uint8_t kHeaderSchema = 1, kHeaderDictionaryBatch = 2, kHeaderRecordBatch = 3;
+const uint8_t kTypeNull = 1, kTypeInt = 2, kTypeFloatingPoint = 3, kTypeBinary = 4, kTypeUtf8 = 5,
+              kTypeBool = 6, kTypeDecimal = 7, kTypeDate = 8, kTypeTime = 9, kTypeTimestamp = 10,
+              kTypeInterval = 11, kTypeFixedSizeBinary = 15, kTypeDuration = 18, kTypeLargeBinary = 19,
+              kTypeLargeUtf8 = 20;
+const int16_t kPrecisionSingle = 1, kPrecisionDouble = 2;
+
+size_t padded(size_t size) {
+    return (size + kBufferAlignment - 1) / kBufferAlignment * kBufferAlignment;
+}
+
+template <typename T>
+void appendRaw(std::string& out, T value) {
+    char raw[sizeof(T)];
+    std::memcpy(raw, &value, sizeof(T));
+    out.append(raw, sizeof(T));
+}
+
+template <typename T>
+T readRaw(const uint8_t* p) {
+    T value;
+    std::memcpy(&value, p, sizeof(T));
+    return value;
+}
+
+// Builds a flatbuffer back to front, as the flatbuffers library does:
+// children are written before the tables that point at them, and an
+// object is known by its distance from the end of the buffer. Only as much
+// as the Arrow metadata needs; it is small, so prepending copies are fine.
+class FlatBuilder {
+public:
+    using Ref = uint32_t;
+
+    Ref string(const std::string& text) {
+        align(4, text.size() + 1);
+        bytes.insert(0, 1, '\0');
+        bytes.insert(0, text);
+        prepend(static_cast<uint32_t>(text.size()));
+        return here();
+    }
+
+    // A vector of scalars or structs given as their bytes
+    Ref vector(const std::string& elements, size_t count, size_t alignment) {
+        align(alignment > 4 ? alignment : 4, elements.size());
+        bytes.insert(0, elements);
+        prepend(static_cast<uint32_t>(count));
+        return here();
+    }
+
+    Ref vector(const DynamicArray<Ref>& tables) {
+        align(4, tables.size() * 4);
+        for (size_t i = tables.size(); i-- > 0;) offset(tables[i]);
+        prepend(static_cast<uint32_t>(tables.size()));
+        return here();
+    }
+
+    // A table: startTable, then add fields in any order, then endTable.
+    // Tables do not nest; build the children first.
+    void startTable() {
+        fields = DynamicArray<Field>();
+        tableStart = here();
+    }
+
+    template <typename T>
+    void add(uint16_t id, T value) {
+        align(sizeof(T));
+        prepend(value);
+        fields.push_back(Field{id, here()});
+    }
+
+    void addOffset(uint16_t id, Ref target) {
+        offset(target);
+        fields.push_back(Field{id, here()});
+    }
+
+    Ref endTable() {
+        align(4);
+        prepend(int32_t(0)); // to the vtable, once it is written
+        Ref table = here();
+
+        size_t slots = 0;
+        for (const auto& field : fields) slots = field.id + 1u > slots ? field.id + 1u : slots;
+        DynamicArray<uint16_t> vtable(slots);
+        for (size_t i = 0; i < slots; ++i) vtable[i] = 0;
+        for (const auto& field : fields) vtable[field.id] = static_cast<uint16_t>(table - field.at);
+        for (size_t i = slots; i-- > 0;) prepend(vtable[i]);
+        prepend(static_cast<uint16_t>(table - tableStart));
+        prepend(static_cast<uint16_t>(4 + 2 * slots));
+
+        int32_t toVtable = static_cast<int32_t>(here() - table);
+        std::memcpy(&bytes[bytes.size() - table], &toVtable, sizeof(toVtable));
+        return table;
+    }
+
+    std::string finish(Ref root) {
+        align(maxAlignment, 4);
+        offset(root);
+        return std::move(bytes);
+    }
+
+private:
+    struct Field {
+        uint16_t id;
+        Ref at;
+    };
+
+    std::string bytes;
+    size_t maxAlignment = 4;
+    DynamicArray<Field> fields;
+    Ref tableStart = 0;
+
+    Ref here() const { return static_cast<Ref>(bytes.size()); }
+
+    // Pads so that after `extra` more bytes the front is aligned
+    void align(size_t alignment, size_t extra = 0) {
+        if (alignment > maxAlignment) maxAlignment = alignment;
+        size_t padding = (alignment - (bytes.size() + extra) % alignment) % alignment;
+        bytes.insert(0, padding, '\0');
+    }
+
+    template <typename T>
+    void prepend(T value) {
+        char raw[sizeof(T)];
+        std::memcpy(raw, &value, sizeof(T));
+        bytes.insert(0, raw, sizeof(T));
+    }
+
+    void offset(Ref target) {
+        align(4);
+        prepend(static_cast<uint32_t>(here() + 4 - target));
+    }
+};
+
+// A table in a flatbuffer read from a file; every offset is checked
+// against the buffer before it is followed
+class FlatTable {
+public:
+    bool at(const uint8_t* buffer, size_t bufferSize, size_t position) {
+        base = buffer;
+        size = bufferSize;
+        table = position;
+        if (table > size || size - table < 4) return false;
+        int64_t start = static_cast<int64_t>(table) - readRaw<int32_t>(base + table);
+        if (start < 0 || static_cast<size_t>(start) > size - 4) return false;
+        vtable = static_cast<size_t>(start);
+        vtableSize = readRaw<uint16_t>(base + vtable);
+        tableSize = readRaw<uint16_t>(base + vtable + 2);
+        return vtableSize >= 4 && vtableSize % 2 == 0 && vtable + vtableSize <= size && table + tableSize <= size;
+    }
+
+    bool root(const uint8_t* buffer, size_t bufferSize) {
+        return bufferSize >= 4 && at(buffer, bufferSize, readRaw<uint32_t>(buffer));
+    }
+
+    template <typename T>
+    T scalar(uint16_t id, T fallback) const {
+        size_t field = fieldAt(id, sizeof(T));
+        return field ? readRaw<T>(base + field) : fallback;
+    }
+
+    bool has(uint16_t id) const { return fieldAt(id, 4) != 0; }
+
+    bool child(uint16_t id, FlatTable& out) const {
+        size_t target;
+        return follow(id, target) && out.at(base, size, target);
+    }
+
+    bool string(uint16_t id, std::string& out) const {
+        size_t start, count;
+        if (!vector(id, 1, start, count)) return false;
+        out.assign(reinterpret_cast<const char*>(base + start), count);
+        return true;
+    }
+
+    // Elements of elementSize bytes at [start, start + count * elementSize)
+    bool vector(uint16_t id, size_t elementSize, size_t& start, size_t& count) const {
+        size_t target;
+        if (!follow(id, target) || size - target < 4) return false;
+        count = readRaw<uint32_t>(base + target);
+        start = target + 4;
+        return count <= (size - start) / elementSize;
+    }
+
+    // Element i of a vector of tables starting at start
+    bool element(size_t start, size_t i, FlatTable& out) const {
+        size_t slot = start + 4 * i;
+        return out.at(base, size, slot + readRaw<uint32_t>(base + slot));
+    }
+
+    const uint8_t* bytes() const { return base; }
+
+private:
+    const uint8_t* base = nullptr;
+    size_t size = 0, table = 0, vtable = 0;
+    uint16_t vtableSize = 0, tableSize = 0;
+
+    // Position of field id, 0 if absent or out of bounds
+    size_t fieldAt(uint16_t id, size_t width) const {
+        size_t slot = 4 + 2 * static_cast<size_t>(id);
+        if (slot + 2 > vtableSize) return 0;
+        uint16_t offset = readRaw<uint16_t>(base + vtable + slot);
+        if (offset == 0 || offset + width > tableSize) return 0;
+        return table + offset;
+    }
+
+    bool follow(uint16_t id, size_t& target) const {
+        size_t field = fieldAt(id, 4);
+        if (!field) return false;
+        uint64_t to = static_cast<uint64_t>(field) + readRaw<uint32_t>(base + field);
+        if (to >= size) return false;
+        target = static_cast<size_t>(to);
+        return true;
+    }
+};
+
+// ---- Writing ----
+
+enum class Storage { Int32, Utf8, Dictionary, Bool, Float64 };
+
+Storage storageOf(Column column) {
+    if (intField(column)) return Storage::Int32;
+    if (column == Column::Disposition || column == Column::PDisposition) return Storage::Dictionary;
+    if (textField(column)) return Storage::Utf8;
+    if (flagField(column)) return Storage::Bool;
+    return Storage::Float64;
+}
+
+// Dictionary id of a dictionary-encoded column
+int64_t dictionaryId(Column column) {
+    return column == Column::Disposition ? 0 : 1;
+}
+
+const size_t kColumnCount = static_cast<size_t>(Column::Count);
+
+// Buffers and field nodes of one record batch body as it is built
+struct BodyWriter {
+    std::string body;
+    std::string nodes;   // FieldNode structs
+    std::string buffers; // Buffer structs
+    size_t bufferCount = 0, nodeCount = 0;
+
+    void node(size_t length, size_t nulls) {
+        appendRaw(nodes, static_cast<int64_t>(length));
+        appendRaw(nodes, static_cast<int64_t>(nulls));
+        ++nodeCount;
+    }
+
+    void buffer(const void* data, size_t size) {
+        appendRaw(buffers, static_cast<int64_t>(body.size()));
+        appendRaw(buffers, static_cast<int64_t>(size));
+        ++bufferCount;
+        body.append(static_cast<const char*>(data), size);
+        body.append(padded(body.size()) - body.size(), '\0');
+    }
+
+    // Validity bitmap, left out when nothing is null
+    void validity(const std::string& bits, size_t nulls) {
+        if (nulls) buffer(bits.data(), bits.size());
+        else buffer(nullptr, 0);
+    }
+};
+
+void setBit(std::string& bits, size_t i) {
+    bits[i / 8] = static_cast<char>(bits[i / 8] | (1 << (i % 8)));
+}
+
+// A utf8 array of `count` strings from text(i); empty strings are null
+template <typename Text>
+void writeStrings(BodyWriter& out, size_t count, Text text) {
+    std::string valid((count + 7) / 8, '\0'), data;
+    DynamicArray<int32_t> offsets(count + 1);
+    size_t nulls = 0;
+    offsets[0] = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const std::string& value = text(i);
+        if (value.empty()) ++nulls;
+        else setBit(valid, i);
+        data += value;
+        offsets[i + 1] = static_cast<int32_t>(data.size());
+    }
+    out.node(count, nulls);
+    out.validity(valid, nulls);
+    out.buffer(offsets.data, (count + 1) * sizeof(int32_t));
+    out.buffer(data.data(), data.size());
+}
+
+// A RecordBatch message header for a body
+FlatBuilder::Ref recordBatch(FlatBuilder& builder, size_t length, const BodyWriter& body) {
+    FlatBuilder::Ref nodes = builder.vector(body.nodes, body.nodeCount, 8);
+    FlatBuilder::Ref buffers = builder.vector(body.buffers, body.bufferCount, 8);
+    builder.startTable();
+    builder.add<int64_t>(0, static_cast<int64_t>(length));
+    builder.addOffset(1, nodes);
+    builder.addOffset(2, buffers);
+    return builder.endTable();
+}
+
+std::string message(FlatBuilder& builder, uint8_t headerType, FlatBuilder::Ref header, size_t bodyLength) {
+    builder.startTable();
+    builder.add<int64_t>(3, static_cast<int64_t>(bodyLength));
+    builder.addOffset(2, header);
+    builder.add<int16_t>(0, kMetadataV5);
+    builder.add<uint8_t>(1, headerType);
+    return builder.finish(builder.endTable());
+}
+
+FlatBuilder::Ref schema(FlatBuilder& builder) {
+    DynamicArray<FlatBuilder::Ref> fields;
+    for (size_t c = 0; c < kColumnCount; ++c) {
+        Column column = static_cast<Column>(c);
+        Storage storage = storageOf(column);
+
+        FlatBuilder::Ref name = builder.string(columnInfo(column).name);
+        FlatBuilder::Ref children = builder.vector(DynamicArray<FlatBuilder::Ref>());
+        builder.startTable();
+        switch (storage) {
+            case Storage::Int32:
+                builder.add<int32_t>(0, 32);
+                builder.add<uint8_t>(1, 1);
+                break;
+            case Storage::Float64:
+                builder.add<int16_t>(0, kPrecisionDouble);
+                break;
+            default:
+                break;
+        }
+        FlatBuilder::Ref type = builder.endTable();
+
+        FlatBuilder::Ref encoding = 0;
+        if (storage == Storage::Dictionary) {
+            builder.startTable();
+            builder.add<int32_t>(0, 32);
+            builder.add<uint8_t>(1, 1);
+            FlatBuilder::Ref indexType = builder.endTable();
+            builder.startTable();
+            builder.add<int64_t>(0, dictionaryId(column));
+            builder.addOffset(1, indexType);
+            encoding = builder.endTable();
+        }
+
+        uint8_t typeType = storage == Storage::Int32 ? kTypeInt
+                         : storage == Storage::Float64 ? kTypeFloatingPoint
+                         : storage == Storage::Bool ? kTypeBool
+                         : kTypeUtf8; // also the value type of a dictionary
+        builder.startTable();
+        builder.addOffset(0, name);
+        builder.addOffset(3, type);
+        if (encoding) builder.addOffset(4, encoding);
+        builder.addOffset(5, children);
+        builder.add<uint8_t>(1, 1); // nullable
+        builder.add<uint8_t>(2, typeType);
+        fields.push_back(builder.endTable());
+    }
+    FlatBuilder::Ref fieldVector = builder.vector(fields);
+    builder.startTable();
+    builder.addOffset(1, fieldVector);
+    return builder.endTable();
+}
+
+// A Block struct of the footer: where a message is in the file
+struct Block {
+    int64_t offset;
+    int32_t metadataLength;
+    int64_t bodyLength;
+};
+
+// Writes one encapsulated message: continuation marker, metadata length,
+// the flatbuffer padded to 8 bytes, then the body
+class MessageWriter {
+public:
+    explicit MessageWriter(std::ofstream& out) : out(out) {}
+
+    Block write(const std::string& metadata, const std::string& body) {
+        std::string prefix;
+        size_t length = padded(metadata.size());
+        appendRaw(prefix, kContinuation);
+        appendRaw(prefix, static_cast<int32_t>(length));
+        Block block{static_cast<int64_t>(position), static_cast<int32_t>(prefix.size() + length),
+                    static_cast<int64_t>(body.size())};
+        put(prefix);
+        put(metadata);
+        put(std::string(length - metadata.size(), '\0'));
+        put(body);
+        return block;
+    }
+
+    void put(const std::string& bytes) {
+        out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        position += bytes.size();
+    }
+
+private:
+    std::ofstream& out;
+    size_t position = 0;
+};
+
+std::string blocks(const DynamicArray<Block>& list) {
+    std::string bytes;
+    for (const auto& block : list) {
+        appendRaw(bytes, block.offset);
+        appendRaw(bytes, block.metadataLength);
+        appendRaw(bytes, int32_t(0));
+        appendRaw(bytes, block.bodyLength);
+    }
+    return bytes;
+}
+
+// Codes of one dictionary-encoded column: values in order of first use
+struct DictionaryColumn {
+    DynamicArray<std::string> values;
+    DynamicArray<int32_t> codes; // per exported row, -1 for null
+};
+
+DictionaryColumn encodeDictionary(const DynamicArray<Exoplanet>& planets, const DynamicArray<size_t>& rows,
+                                  std::string Exoplanet::* field) {
+    DictionaryColumn column;
+    HashTable<std::string, int32_t> codeOf;
+    column.codes = DynamicArray<int32_t>(rows.size());
+    for (size_t i = 0; i < rows.size(); ++i) {
+        const std::string& value = planets[rows[i]].*field;
+        int32_t code = -1;
+        if (!value.empty()) {
+            if (const int32_t* known = codeOf.find(value)) {
+                code = *known;
+            } else {
+                code = static_cast<int32_t>(column.values.size());
+                codeOf.insert(value, code);
+                column.values.push_back(value);
+            }
+        }
+        column.codes.data[i] = code;
+    }
+    return column;
+}
+
+// The body of rows[begin, end) as one record batch
+void encodeBatch(const DynamicArray<Exoplanet>& planets, const DynamicArray<size_t>& rows, size_t begin,
+                 size_t end, const DictionaryColumn* dictionaries, BodyWriter& out) {
+    size_t count = end - begin;
+    auto planet = [&](size_t i) -> const Exoplanet& { return planets.data[rows.data[begin + i]]; };
+    for (size_t c = 0; c < kColumnCount; ++c) {
+        Column column = static_cast<Column>(c);
+        switch (storageOf(column)) {
+            case Storage::Int32: {
+                int Exoplanet::* field = intField(column);
+                DynamicArray<int32_t> values(count);
+                for (size_t i = 0; i < count; ++i) values.data[i] = planet(i).*field;
+                out.node(count, 0);
+                out.buffer(nullptr, 0);
+                out.buffer(values.data, count * sizeof(int32_t));
+                break;
+            }
+            case Storage::Utf8: {
+                std::string Exoplanet::* field = textField(column);
+                writeStrings(out, count, [&](size_t i) -> const std::string& { return planet(i).*field; });
+                break;
+            }
+            case Storage::Dictionary: {
+                const DynamicArray<int32_t>& codes = dictionaries[dictionaryId(column)].codes;
+                std::string valid((count + 7) / 8, '\0');
+                DynamicArray<int32_t> indices(count);
+                size_t nulls = 0;
+                for (size_t i = 0; i < count; ++i) {
+                    int32_t code = codes.data[begin + i];
+                    if (code < 0) ++nulls;
+                    else setBit(valid, i);
+                    indices.data[i] = code < 0 ? 0 : code;
+                }
+                out.node(count, nulls);
+                out.validity(valid, nulls);
+                out.buffer(indices.data, count * sizeof(int32_t));
+                break;
+            }
+            case Storage::Bool: {
+                bool Exoplanet::* field = flagField(column);
+                std::string bits((count + 7) / 8, '\0');
+                for (size_t i = 0; i < count; ++i) {
+                    if (planet(i).*field) setBit(bits, i);
+                }
+                out.node(count, 0);
+                out.buffer(nullptr, 0);
+                out.buffer(bits.data(), bits.size());
+                break;
+            }
+            case Storage::Float64: {
+                double Exoplanet::* field = columnInfo(column).field;
+                std::string valid((count + 7) / 8, '\0');
+                DynamicArray<double> values(count);
+                size_t nulls = 0;
+                for (size_t i = 0; i < count; ++i) {
+                    double value = planet(i).*field;
+                    if (std::isnan(value)) ++nulls;
+                    else setBit(valid, i);
+                    values.data[i] = std::isnan(value) ? 0.0 : value;
+                }
+                out.node(count, nulls);
+                out.validity(valid, nulls);
+                out.buffer(values.data, count * sizeof(double));
+                break;
+            }
+        }
+    }
+}
+
+} // namespace
+
+bool isArrowPath(const std::string& filename) {
+    for (const char* extension : {".arrow", ".feather", ".ipc"}) {
+        size_t length = std::strlen(extension);
+        if (filename.size() > length && filename.compare(filename.size() - length, length, extension) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool writeArrowFile(const std::string& filename, const DynamicArray<Exoplanet>& planets) {
+    DynamicArray<size_t> rows(planets.size());
+    for (size_t i = 0; i < planets.size(); ++i) rows[i] = i;
+    return writeArrowFile(filename, planets, rows);
+}
+
+bool writeArrowFile(const std::string& filename, const DynamicArray<Exoplanet>& planets,
+                    const DynamicArray<size_t>& rows) {
+    EXO_PHASE("export.write_arrow");
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error creating file: " << filename << std::endl;
+        return false;
+    }
+    MessageWriter out(file);
+    out.put(std::string(kMagic, kMagicSize) + std::string(2, '\0'));
+
+    FlatBuilder schemaBuilder;
+    out.write(message(schemaBuilder, kHeaderSchema, schema(schemaBuilder), 0), std::string());
+
+    // One dictionary per encoded column, ahead of the batches that use it
+    DictionaryColumn dictionaries[2] = {
+        encodeDictionary(planets, rows, &Exoplanet::koi_disposition),
+        encodeDictionary(planets, rows, &Exoplanet::koi_pdisposition),
+    };
+    DynamicArray<Block> dictionaryBlocks, batchBlocks;
+    for (int64_t id = 0; id < 2; ++id) {
+        const DynamicArray<std::string>& values = dictionaries[id].values;
+        BodyWriter body;
+        writeStrings(body, values.size(), [&](size_t i) -> const std::string& { return values.data[i]; });
+        FlatBuilder builder;
+        FlatBuilder::Ref data = recordBatch(builder, values.size(), body);
+        builder.startTable();
+        builder.add<int64_t>(0, id);
+        builder.addOffset(1, data);
+        FlatBuilder::Ref batch = builder.endTable();
+        dictionaryBlocks.push_back(out.write(message(builder, kHeaderDictionaryBatch, batch, body.body.size()),
+                                             body.body));
+    }
+
+    // Encode a window of batches in parallel, then write them in order
+    size_t batchCount = (rows.size() + kBatchRows - 1) / kBatchRows;
+    size_t window = algo::worker_count() * 4;
+    std::vector<BodyWriter> bodies(window);
+    for (size_t first = 0; first < batchCount; first += window) {
+        size_t last = first + window < batchCount ? first + window : batchCount;
+        algo::parallel_for(last - first, 1, [&](size_t begin, size_t end) {
+            for (size_t b = begin; b < end; ++b) {
+                size_t rowEnd = (first + b + 1) * kBatchRows < rows.size() ? (first + b + 1) * kBatchRows : rows.size();
+                bodies[b] = BodyWriter();
+                encodeBatch(planets, rows, (first + b) * kBatchRows, rowEnd, dictionaries, bodies[b]);
+            }
+        });
+        for (size_t b = 0; b < last - first; ++b) {
+            size_t rowEnd = (first + b + 1) * kBatchRows < rows.size() ? (first + b + 1) * kBatchRows : rows.size();
+            FlatBuilder builder;
+            FlatBuilder::Ref batch = recordBatch(builder, rowEnd - (first + b) * kBatchRows, bodies[b]);
+            batchBlocks.push_back(out.write(message(builder, kHeaderRecordBatch, batch, bodies[b].body.size()),
+                                            bodies[b].body));
+        }
+    }
+
+    // End of stream, then the footer and its length
+    std::string end;
+    appendRaw(end, kContinuation);
+    appendRaw(end, int32_t(0));
+    out.put(end);
+
+    FlatBuilder builder;
+    FlatBuilder::Ref schemaRef = schema(builder);
+    FlatBuilder::Ref dictionaryVector = builder.vector(blocks(dictionaryBlocks), dictionaryBlocks.size(), 8);
+    FlatBuilder::Ref batchVector = builder.vector(blocks(batchBlocks), batchBlocks.size(), 8);
+    builder.startTable();
+    builder.addOffset(1, schemaRef);
+    builder.addOffset(2, dictionaryVector);
+    builder.addOffset(3, batchVector);
+    builder.add<int16_t>(0, kMetadataV5);
+    std::string footer = builder.finish(builder.endTable());
+    std::string trailer;
+    appendRaw(trailer, static_cast<int32_t>(footer.size()));
+    trailer.append(kMagic, kMagicSize);
+    out.put(footer);
+    out.put(trailer);
+
+    EXO_STATS_COUNT("io.bytes_written", static_cast<uint64_t>(file.tellp()));
+    file.close();
+    return static_cast<bool>(file);
+}
+
+// ---- Reading ----
+
+bool ArrowTable::isArrowFile(const std::string& filename) {
+    char magic[kMagicSize] = {};
+    std::ifstream file(filename, std::ios::binary);
+    file.read(magic, kMagicSize);
+    return file.gcount() == static_cast<std::streamsize>(kMagicSize) && std::memcmp(magic, kMagic, kMagicSize) == 0;
+}
+
+bool ArrowTable::open(const std::string& filename) {
+    close();
+    if (!file.open(filename, false)) return false; // pages come in as columns are decoded
+    if (!readLayout(filename)) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void ArrowTable::close() {
+    file.close();
+    for (auto& layout : layouts) layout = Layout();
+    for (auto& dictionary : dictionaryOf) dictionary = nullptr;
+    batches = DynamicArray<Batch>();
+    dictionaries = DynamicArray<Dictionary>();
+    rowCount = 0;
+}
+
+namespace {
+
+// Buffers a flat field of this type has in a record batch; 0 for types
+// the reader cannot step over
+size_t bufferCount(uint8_t type) {
+    switch (type) {
+        case kTypeNull: return 0;
+        case kTypeBinary: case kTypeUtf8: case kTypeLargeBinary: case kTypeLargeUtf8: return 3;
+        case kTypeInt: case kTypeFloatingPoint: case kTypeBool: case kTypeDecimal: case kTypeDate:
+        case kTypeTime: case kTypeTimestamp: case kTypeInterval: case kTypeFixedSizeBinary:
+        case kTypeDuration: return 2;
+        default: return 0;
+    }
+}
+
+// The body of the message a footer Block points at
+struct MessageView {
+    FlatTable header;
+    const uint8_t* body;
+    size_t bodySize;
+};
+
+bool readMessage(const uint8_t* file, size_t fileSize, const uint8_t* block, uint8_t wantedType,
+                 MessageView& out) {
+    uint64_t offset = static_cast<uint64_t>(readRaw<int64_t>(block));
+    uint64_t metadataLength = static_cast<uint64_t>(readRaw<int32_t>(block + 8));
+    uint64_t bodyLength = static_cast<uint64_t>(readRaw<int64_t>(block + 16));
+    if (offset > fileSize || metadataLength > fileSize - offset || bodyLength > fileSize - offset - metadataLength) {
+        return false;
+    }
+
+    // Continuation marker, then the length; older writers give only the length
+    const uint8_t* prefix = file + offset;
+    size_t skip = metadataLength >= 8 && readRaw<uint32_t>(prefix) == kContinuation ? 8 : 4;
+    if (metadataLength < skip) return false;
+    size_t length = readRaw<uint32_t>(prefix + skip - 4);
+    if (length > metadataLength - skip) return false;
+
+    FlatTable message;
+    if (!message.root(prefix + skip, length)) return false;
+    if (message.scalar<uint8_t>(1, 0) != wantedType || !message.child(2, out.header)) return false;
+    out.body = file + offset + metadataLength;
+    out.bodySize = static_cast<size_t>(bodyLength);
+    return true;
+}
+
+// Walks a RecordBatch's field nodes and buffers in order
+class BatchReader {
+public:
+    bool open(const FlatTable& batch, const uint8_t* bodyStart, size_t bodyLength) {
+        body = bodyStart;
+        bodySize = bodyLength;
+        length = batch.scalar<int64_t>(0, -1);
+        if (length < 0 || batch.has(3)) return false; // compressed bodies are not read
+        base = batch.bytes();
+        return batch.vector(1, 16, nodes, nodeCount) && batch.vector(2, 16, buffers, bufferCount);
+    }
+
+    bool node(size_t& count, size_t& nulls) {
+        if (nextNode == nodeCount) return false;
+        const uint8_t* at = base + nodes + 16 * nextNode++;
+        int64_t n = readRaw<int64_t>(at), nullCount = readRaw<int64_t>(at + 8);
+        if (n < 0 || nullCount < 0 || nullCount > n) return false;
+        count = static_cast<size_t>(n);
+        nulls = static_cast<size_t>(nullCount);
+        return true;
+    }
+
+    // The next buffer, which must hold at least `needed` bytes
+    bool buffer(size_t needed, const uint8_t*& data, size_t& size) {
+        if (nextBuffer == bufferCount) return false;
+        const uint8_t* at = base + buffers + 16 * nextBuffer++;
+        uint64_t offset = static_cast<uint64_t>(readRaw<int64_t>(at));
+        uint64_t bytes = static_cast<uint64_t>(readRaw<int64_t>(at + 8));
+        if (offset > bodySize || bytes > bodySize - offset || bytes < needed) return false;
+        data = bytes ? body + offset : nullptr;
+        size = static_cast<size_t>(bytes);
+        return true;
+    }
+
+    bool skip(size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            const uint8_t* data;
+            size_t size;
+            if (!buffer(0, data, size)) return false;
+        }
+        return true;
+    }
+
+    int64_t rows() const { return length; }
+
+private:
+    const uint8_t* base = nullptr;
+    const uint8_t* body = nullptr;
+    size_t bodySize = 0;
+    int64_t length = 0;
+    size_t nodes = 0, nodeCount = 0, nextNode = 0;
+    size_t buffers = 0, bufferCount = 0, nextBuffer = 0;
+};
+
+uint64_t readUnsigned(const uint8_t* values, uint8_t width, size_t i) {
+    switch (width) {
+        case 1: return values[i];
+        case 2: return readRaw<uint16_t>(values + 2 * i);
+        case 4: return readRaw<uint32_t>(values + 4 * i);
+        default: return readRaw<uint64_t>(values + 8 * i);
+    }
+}
+
+int64_t readSigned(const uint8_t* values, uint8_t width, size_t i) {
+    switch (width) {
+        case 1: return static_cast<int8_t>(values[i]);
+        case 2: return readRaw<int16_t>(values + 2 * i);
+        case 4: return readRaw<int32_t>(values + 4 * i);
+        default: return readRaw<int64_t>(values + 8 * i);
+    }
+}
+
+bool bitAt(const uint8_t* bits, size_t i) {
+    return bits[i / 8] >> (i % 8) & 1;
+}
+
+// Offsets of a string array must rise within its data
+bool checkOffsets(const uint8_t* offsets, uint8_t width, size_t count, size_t dataSize) {
+    uint64_t previous = 0;
+    for (size_t i = 0; i <= count; ++i) {
+        uint64_t offset = static_cast<uint64_t>(readSigned(offsets, width, i));
+        if (offset < previous || offset > dataSize) return false;
+        previous = offset;
+    }
+    return true;
+}
+
+} // namespace
+
+bool ArrowTable::readLayout(const std::string& filename) {
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(file.data());
+    size_t size = file.size();
+    auto bad = [&filename](const std::string& why) {
+        std::cerr << "Cannot read Arrow file " << filename << ": " << why << std::endl;
+        return false;
+    };
+    const char* kCompressed = "compressed bodies are not supported (write with compression='uncompressed')";
+    if (size < 2 * kMagicSize + 6 || std::memcmp(data, kMagic, kMagicSize) != 0 ||
+        std::memcmp(data + size - kMagicSize, kMagic, kMagicSize) != 0) {
+        return bad("not an Arrow IPC file");
+    }
+    uint32_t footerSize = readRaw<uint32_t>(data + size - kMagicSize - 4);
+    if (footerSize > size - kMagicSize - 4 - 8) return bad("bad footer length");
+    FlatTable footer, schemaTable;
+    size_t footerStart = size - kMagicSize - 4 - footerSize;
+    if (!footer.root(data + footerStart, footerSize) || !footer.child(1, schemaTable)) return bad("bad footer");
+
+    // Fields: which catalog column each is, how it is stored, and how
+    // many buffers it takes
+    struct FieldLayout {
+        int column; // -1 if not a catalog column
+        Layout layout;
+        size_t buffers;
+    };
+    DynamicArray<FieldLayout> fields;
+    size_t fieldStart, fieldCount;
+    if (!schemaTable.vector(1, 4, fieldStart, fieldCount)) return bad("schema without fields");
+    for (size_t f = 0; f < fieldCount; ++f) {
+        FlatTable field, type, encoding, indexType;
+        std::string name;
+        if (!schemaTable.element(fieldStart, f, field)) return bad("bad field");
+        field.string(0, name);
+        uint8_t typeType = field.scalar<uint8_t>(2, 0);
+        size_t childStart, childCount = 0;
+        if (field.vector(5, 4, childStart, childCount) && childCount > 0) {
+            return bad("nested column " + name + " is not supported");
+        }
+
+        FieldLayout layout{-1, Layout(), bufferCount(typeType)};
+        for (size_t c = 0; c < kColumnCount; ++c) {
+            if (name == columnInfo(static_cast<Column>(c)).name) layout.column = static_cast<int>(c);
+        }
+        bool hasType = field.child(3, type);
+        if (field.child(4, encoding)) {
+            if (!encoding.child(1, indexType)) return bad("dictionary of " + name + " without an index type");
+            int32_t bits = indexType.scalar<int32_t>(0, 0);
+            if (bits != 8 && bits != 16 && bits != 32 && bits != 64) return bad("bad index width for " + name);
+            layout.layout.kind = typeType == kTypeUtf8 || typeType == kTypeLargeUtf8 ? Kind::Dictionary : Kind::Absent;
+            layout.layout.width = static_cast<uint8_t>(bits / 8);
+            layout.layout.isSigned = indexType.scalar<uint8_t>(1, 0) != 0;
+            layout.layout.dictionary = encoding.scalar<int64_t>(0, 0);
+            layout.layout.valueWidth = typeType == kTypeLargeUtf8 ? 8 : 4;
+            layout.buffers = 2;
+        } else if (typeType == kTypeInt && hasType) {
+            int32_t bits = type.scalar<int32_t>(0, 0);
+            if (bits != 8 && bits != 16 && bits != 32 && bits != 64) return bad("bad integer width for " + name);
+            layout.layout.kind = Kind::Int;
+            layout.layout.width = static_cast<uint8_t>(bits / 8);
+            layout.layout.isSigned = type.scalar<uint8_t>(1, 0) != 0;
+        } else if (typeType == kTypeFloatingPoint && hasType) {
+            int16_t precision = type.scalar<int16_t>(0, 0);
+            if (precision == kPrecisionSingle || precision == kPrecisionDouble) {
+                layout.layout.kind = Kind::Float;
+                layout.layout.width = precision == kPrecisionSingle ? 4 : 8;
+            }
+        } else if (typeType == kTypeBool) {
+            layout.layout.kind = Kind::Bool;
+        } else if (typeType == kTypeUtf8 || typeType == kTypeLargeUtf8) {
+            layout.layout.kind = Kind::Utf8;
+            layout.layout.width = typeType == kTypeLargeUtf8 ? 8 : 4;
+        }
+        if (layout.buffers == 0 && typeType != kTypeNull) {
+            return bad("column " + name + " has a type this reader cannot step over");
+        }
+
+        // Catalog columns must hold what the catalog stores there
+        if (layout.column >= 0) {
+            Column column = static_cast<Column>(layout.column);
+            Kind kind = layout.layout.kind;
+            bool fits = columnInfo(column).field ? kind == Kind::Int || kind == Kind::Float
+                      : intField(column)         ? kind == Kind::Int
+                      : textField(column)        ? kind == Kind::Utf8 || kind == Kind::Dictionary
+                                                 : kind == Kind::Bool || kind == Kind::Int;
+            if (!fits) return bad("column " + name + " has an unexpected type");
+            if (layouts[layout.column].kind != Kind::Absent) layout.column = -1; // first of a name wins
+            else layouts[layout.column] = layout.layout;
+        }
+        fields.push_back(layout);
+    }
+
+    // Dictionaries the catalog columns use; others are skipped
+    size_t blockStart, blockCount;
+    if (footer.vector(2, 24, blockStart, blockCount)) {
+        for (size_t d = 0; d < blockCount; ++d) {
+            MessageView message;
+            if (!readMessage(data, size, footer.bytes() + blockStart + 24 * d, kHeaderDictionaryBatch, message)) {
+                return bad("bad dictionary batch");
+            }
+            int64_t id = message.header.scalar<int64_t>(0, 0);
+            const Layout* user = nullptr;
+            for (const auto& layout : layouts) {
+                if (layout.kind == Kind::Dictionary && layout.dictionary == id) user = &layout;
+            }
+            if (!user) continue;
+            if (message.header.scalar<uint8_t>(2, 0)) return bad("delta dictionaries are not supported");
+
+            FlatTable batchTable;
+            BatchReader batch;
+            Dictionary dictionary;
+            size_t count, nulls, bytes;
+            if (message.header.child(1, batchTable) && batchTable.has(3)) return bad(kCompressed);
+            if (!message.header.child(1, batchTable) || !batch.open(batchTable, message.body, message.bodySize) ||
+                !batch.node(count, nulls)) {
+                return bad("bad dictionary batch");
+            }
+            dictionary.id = id;
+            dictionary.width = user->valueWidth;
+            dictionary.length = count;
+            if (!batch.buffer(nulls ? (count + 7) / 8 : 0, dictionary.values.validity, bytes) ||
+                !batch.buffer((count + 1) * dictionary.width, dictionary.values.values, bytes) ||
+                !batch.buffer(0, dictionary.values.data, dictionary.values.dataSize) ||
+                !checkOffsets(dictionary.values.values, dictionary.width, count, dictionary.values.dataSize)) {
+                return bad("bad dictionary batch");
+            }
+            if (!nulls) dictionary.values.validity = nullptr;
+            dictionaries.push_back(dictionary);
+        }
+    }
+    for (size_t c = 0; c < kColumnCount; ++c) {
+        if (layouts[c].kind != Kind::Dictionary) continue;
+        for (const auto& dictionary : dictionaries) {
+            if (dictionary.id == layouts[c].dictionary) dictionaryOf[c] = &dictionary;
+        }
+        if (!dictionaryOf[c]) return bad(std::string("no dictionary for ") + columnInfo(static_cast<Column>(c)).name);
+    }
+
+    // Record batches: the buffers of each catalog column, checked against
+    // the row count so decoding needs no checks of its own
+    if (!footer.vector(3, 24, blockStart, blockCount)) blockCount = 0;
+    for (size_t b = 0; b < blockCount; ++b) {
+        MessageView message;
+        BatchReader reader;
+        if (!readMessage(data, size, footer.bytes() + blockStart + 24 * b, kHeaderRecordBatch, message) ||
+            !reader.open(message.header, message.body, message.bodySize)) {
+            return bad(message.header.has(3) ? kCompressed : "bad record batch");
+        }
+        Batch batch;
+        batch.firstRow = rowCount;
+        batch.length = static_cast<size_t>(reader.rows());
+        for (const auto& field : fields) {
+            size_t count, nulls, bytes;
+            if (!reader.node(count, nulls)) return bad("record batch with too few field nodes");
+            if (field.column < 0) {
+                if (!reader.skip(field.buffers)) return bad("record batch with too few buffers");
+                continue;
+            }
+            if (count != batch.length) return bad("column length differs from the batch");
+            const Layout& layout = layouts[field.column];
+            Slice& slice = batch.columns[field.column];
+            size_t valuesNeeded = layout.kind == Kind::Bool ? (count + 7) / 8
+                                : layout.kind == Kind::Utf8 ? (count + 1) * layout.width
+                                                            : count * layout.width;
+            if (!reader.buffer(nulls ? (count + 7) / 8 : 0, slice.validity, bytes) ||
+                !reader.buffer(valuesNeeded, slice.values, bytes)) {
+                return bad("bad buffers for " + std::string(columnInfo(static_cast<Column>(field.column)).name));
+            }
+            if (!nulls) slice.validity = nullptr;
+            if (layout.kind == Kind::Utf8) {
+                if (!reader.buffer(0, slice.data, slice.dataSize) ||
+                    (count && !checkOffsets(slice.values, layout.width, count, slice.dataSize))) {
+                    return bad("bad strings in " + std::string(columnInfo(static_cast<Column>(field.column)).name));
+                }
+            }
+            if (layout.kind == Kind::Dictionary) {
+                size_t entries = dictionaryOf[field.column]->length;
+                for (size_t i = 0; i < count; ++i) {
+                    if ((!slice.validity || bitAt(slice.validity, i)) &&
+                        (layout.isSigned ? static_cast<uint64_t>(readSigned(slice.values, layout.width, i))
+                                         : readUnsigned(slice.values, layout.width, i)) >= entries) {
+                        return bad("dictionary index out of range");
+                    }
+                }
+            }
+            // rowid and kepid are ints in the catalog: wider ids must fit
+            bool narrowed = layout.width == 8 || (layout.width == 4 && !layout.isSigned);
+            if (layout.kind == Kind::Int && narrowed && intField(static_cast<Column>(field.column))) {
+                for (size_t i = 0; i < count; ++i) {
+                    if (slice.validity && !bitAt(slice.validity, i)) continue;
+                    bool fits = layout.isSigned ? readSigned(slice.values, layout.width, i) >= INT_MIN &&
+                                                      readSigned(slice.values, layout.width, i) <= INT_MAX
+                                                : readUnsigned(slice.values, layout.width, i) <= INT_MAX;
+                    if (!fits) {
+                        return bad(std::string(columnInfo(static_cast<Column>(field.column)).name) +
+                                   " value out of range");
+                    }
+                }
+            }
+        }
+        rowCount += batch.length;
+        batches.push_back(batch);
+    }
+    EXO_STATS_COUNT("io.arrow_batches", batches.size());
+    return true;
+}
+
+void ArrowTable::stringAt(const Slice& slice, uint8_t width, size_t row, std::string& out) const {
+    if (slice.validity && !bitAt(slice.validity, row)) {
+        out.clear();
+        return;
+    }
+    size_t begin = static_cast<size_t>(readSigned(slice.values, width, row));
+    size_t end = static_cast<size_t>(readSigned(slice.values, width, row + 1));
+    out.assign(reinterpret_cast<const char*>(slice.data) + begin, end - begin);
+}
+
+void ArrowTable::decodeBatch(const Batch& batch, ColumnMask columns, Exoplanet* planets) const {
+    for (size_t c = 0; c < kColumnCount; ++c) {
+        Column column = static_cast<Column>(c);
+        if (!(columns & columnBit(column))) continue;
+        const Layout& layout = layouts[c];
+        const Slice& slice = batch.columns[c];
+        auto valid = [&slice](size_t i) { return !slice.validity || bitAt(slice.validity, i); };
+        auto integer = [&](size_t i) {
+            return layout.isSigned ? readSigned(slice.values, layout.width, i)
+                                   : static_cast<int64_t>(readUnsigned(slice.values, layout.width, i));
+        };
+
+        if (double Exoplanet::* field = columnInfo(column).field) {
+            for (size_t i = 0; i < batch.length; ++i) {
+                double value = std::nan("");
+                if (layout.kind != Kind::Absent && valid(i)) {
+                    value = layout.kind == Kind::Int ? static_cast<double>(integer(i))
+                          : layout.width == 4        ? readRaw<float>(slice.values + 4 * i)
+                                                     : readRaw<double>(slice.values + 8 * i);
+                }
+                planets[i].*field = value;
+            }
+        } else if (int Exoplanet::* field = intField(column)) {
+            for (size_t i = 0; i < batch.length; ++i) {
+                // readLayout turned away ids that do not fit an int
+                planets[i].*field = layout.kind != Kind::Absent && valid(i) ? static_cast<int>(integer(i)) : 0;
+            }
+        } else if (std::string Exoplanet::* field = textField(column)) {
+            const Dictionary* dictionary = dictionaryOf[c];
+            for (size_t i = 0; i < batch.length; ++i) {
+                if (layout.kind == Kind::Utf8) {
+                    stringAt(slice, layout.width, i, planets[i].*field);
+                } else if (layout.kind == Kind::Dictionary && valid(i)) {
+                    stringAt(dictionary->values, dictionary->width, static_cast<size_t>(integer(i)), planets[i].*field);
+                } else {
+                    (planets[i].*field).clear();
+                }
+            }
+        } else {
+            bool Exoplanet::* member = flagField(column);
+            for (size_t i = 0; i < batch.length; ++i) {
+                bool flag = false;
+                if (layout.kind == Kind::Bool) flag = valid(i) && bitAt(slice.values, i);
+                else if (layout.kind == Kind::Int) flag = valid(i) && integer(i) != 0;
+                planets[i].*member = flag;
+            }
+        }
+    }
+}
+
+void ArrowTable::decode(ColumnMask columns, DynamicArray<Exoplanet>& planets, size_t firstRow) const {
+    EXO_PHASE("load.decode_arrow");
+    algo::parallel_for(batches.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t b = begin; b < end; ++b) {
+            decodeBatch(batches.data[b], columns, planets.data + firstRow + batches.data[b].firstRow);
+        }
+    });
+}
+
+void ArrowTable::appendTo(DynamicArray<Exoplanet>& planets, ColumnMask columns) const {
+    Exoplanet blank = blankPlanet();
+    size_t firstRow = planets.size();
+    planets.reserve(firstRow + rowCount);
+    for (size_t i = 0; i < rowCount; ++i) planets.push_back(blank);
+    decode(columns, planets, firstRow);
+}
@@ -0,0 +1,318 @@
+#include "../include/Compression.hpp"
+#include "../include/algorithms/parallel.hpp"
+#include "../include/Stats.hpp"
+#include "../include/Trace.hpp"
+#include <cstdint>
+#include <utility>
+#ifdef EXO_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef EXO_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+    // Decompressed bytes each task of a parallel batch produces, at least
+    const size_t kUnitBytes = 1 << 20;
+
+    // Tasks per worker in one parallel batch
+    const size_t kUnitsPerWorker = 2;
+
+    // Decompressed bytes per read of a piece read in order
+    const size_t kStreamBlock = 4 << 20;
+
+    // BGZF blocks hold at most 64 KiB
+    const size_t kMaxBgzfOutput = 1 << 16;
+
+    // Largest zstd frame decompressed whole: a bigger declared size is not
+    // trusted with an allocation, and the frame is read in order instead
+    const size_t kMaxFrameOutput = 64 << 20;
+
+    uint32_t readLittleEndian(const unsigned char* p, size_t bytes) {
+        uint32_t value = 0;
+        for (size_t i = bytes; i-- > 0;) value = value << 8 | p[i];
+        return value;
+    }
+
+    // Compressed and decompressed size of the BGZF block at p, if it is one:
+    // a gzip member with FEXTRA whose BC subfield holds its size less one,
+    // and whose trailer ends with the decompressed size
+    bool bgzfBlock(const unsigned char* p, size_t available, size_t& blockSize, size_t& output) {
+        const size_t kHeader = 12, kTrailer = 8;
+        if (available < kHeader || p[0] != 0x1f || p[1] != 0x8b || p[2] != 8 || !(p[3] & 4)) return false;
+        size_t extraEnd = kHeader + readLittleEndian(p + 10, 2);
+        if (extraEnd > available) return false;
+
+        blockSize = 0;
+        for (size_t field = kHeader; field + 4 <= extraEnd;) {
+            size_t length = readLittleEndian(p + field + 2, 2);
+            if (p[field] == 'B' && p[field + 1] == 'C' && length == 2 && field + 6 <= extraEnd) {
+                blockSize = readLittleEndian(p + field + 4, 2) + 1;
+            }
+            field += 4 + length;
+        }
+        if (blockSize < extraEnd + kTrailer || blockSize > available) return false;
+        output = readLittleEndian(p + blockSize - 4, 4);
+        return output <= kMaxBgzfOutput;
+    }
+}
+
+Compression detectCompression(const char* data, size_t size) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+    if (size >= 2 && p[0] == 0x1f && p[1] == 0x8b) return Compression::Gzip;
+    if (size >= 4 && readLittleEndian(p, 4) == 0xFD2FB528) return Compression::Zstd;
+    return Compression::None;
+}
+
+const char* compressionName(Compression compression) {
+    switch (compression) {
+        case Compression::Gzip: return "gzip";
+        case Compression::Zstd: return "zstd";
+        default: return "none";
+    }
+}
+
+bool compressionSupported(Compression compression) {
+    switch (compression) {
+        case Compression::None: return true;
+#ifdef EXO_HAVE_ZLIB
+        case Compression::Gzip: return true;
+#endif
+#ifdef EXO_HAVE_ZSTD
+        case Compression::Zstd: return true;
+#endif
+        default: return false;
+    }
+}
+
+struct CompressedReader::Stream {
+#ifdef EXO_HAVE_ZLIB
+    z_stream inflater = {};
+    bool inflating = false;
+#endif
+#ifdef EXO_HAVE_ZSTD
+    ZSTD_DCtx* frame = nullptr;
+#endif
+
+    ~Stream() {
+#ifdef EXO_HAVE_ZLIB
+        if (inflating) inflateEnd(&inflater);
+#endif
+#ifdef EXO_HAVE_ZSTD
+        ZSTD_freeDCtx(frame);
+#endif
+    }
+};
+
+CompressedReader::CompressedReader(const char* data, size_t size, Compression compression)
+    : data(data), size(size), compression(compression) {}
+
+CompressedReader::~CompressedReader() = default;
+
+bool CompressedReader::fail(const std::string& why) {
+    failure = why + " at byte " + std::to_string(offset);
+    stream.reset();
+    return false;
+}
+
+bool CompressedReader::read(DynamicArray<std::string>& blocks) {
+    if (!failure.empty() || (offset >= size && !stream)) return false;
+    if (!compressionSupported(compression)) {
+        failure = std::string("this build cannot read ") + compressionName(compression) +
+                  " (make " + (compression == Compression::Zstd ? "WITH_ZSTD=1" : "WITH_ZLIB=1") + ")";
+        return false;
+    }
+    if (!stream) {
+        if (readPieces(blocks)) return true;
+        if (!failure.empty()) return false;
+    }
+    return readStream(blocks);
+}
+
+bool CompressedReader::pieceAt(size_t at, Piece& piece) const {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data) + at;
+    size_t available = size - at;
+    piece.offset = at;
+    if (compression == Compression::Gzip) return bgzfBlock(p, available, piece.size, piece.output);
+#ifdef EXO_HAVE_ZSTD
+    if (compression == Compression::Zstd) {
+        // The content size is in the header; the frame size takes a walk
+        // over the block headers, so only frames worth it get one
+        unsigned long long content = ZSTD_getFrameContentSize(p, available);
+        if (content == ZSTD_CONTENTSIZE_UNKNOWN || content == ZSTD_CONTENTSIZE_ERROR ||
+            content > kMaxFrameOutput) {
+            return false;
+        }
+        size_t frame = ZSTD_findFrameCompressedSize(p, available);
+        if (ZSTD_isError(frame)) return false;
+        piece.size = frame;
+        piece.output = static_cast<size_t>(content);
+        return true;
+    }
+#endif
+    return false;
+}
+
+bool CompressedReader::decompressPieces(const Piece* first, const Piece* last, char* out) const {
+#ifdef EXO_HAVE_ZLIB
+    if (compression == Compression::Gzip) {
+        bool ok = true;
+        z_stream inflater = {};
+        if (inflateInit2(&inflater, 15 + 16) != Z_OK) return false; // gzip wrapper
+        char empty;
+        for (const Piece* piece = first; ok && piece < last; ++piece) {
+            inflater.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data + piece->offset));
+            inflater.avail_in = static_cast<uInt>(piece->size);
+            inflater.next_out = reinterpret_cast<Bytef*>(piece->output ? out : &empty);
+            inflater.avail_out = static_cast<uInt>(piece->output ? piece->output : 1);
+            ok = inflate(&inflater, Z_FINISH) == Z_STREAM_END && inflater.avail_in == 0 &&
+                 inflater.avail_out == (piece->output ? 0u : 1u);
+            out += piece->output;
+            inflateReset(&inflater);
+        }
+        inflateEnd(&inflater);
+        return ok;
+    }
+#endif
+#ifdef EXO_HAVE_ZSTD
+    if (compression == Compression::Zstd) {
+        ZSTD_DCtx* context = ZSTD_createDCtx();
+        if (!context) return false;
+        bool ok = true;
+        for (const Piece* piece = first; ok && piece < last; ++piece) {
+            size_t written = ZSTD_decompressDCtx(context, out, piece->output, data + piece->offset, piece->size);
+            ok = !ZSTD_isError(written) && written == piece->output;
+            out += piece->output;
+        }
+        ZSTD_freeDCtx(context);
+        return ok;
+    }
+#endif
+    (void)first;
+    (void)last;
+    (void)out;
+    return false;
+}
+
+bool CompressedReader::readPieces(DynamicArray<std::string>& blocks) {
+    // Gather the pieces from here on into units of about kUnitBytes of
+    // output, enough units to keep every worker busy
+    DynamicArray<Piece> pieces;
+    DynamicArray<size_t> unitStart; // first piece of each unit
+    size_t maxUnits = algo::worker_count() * kUnitsPerWorker;
+    size_t at = offset, unitBytes = 0;
+    bool unitOpen = false;
+    Piece piece;
+    while (at < size && pieceAt(at, piece)) {
+        if (!unitOpen) {
+            if (unitStart.size() == maxUnits) break;
+            unitStart.push_back(pieces.size());
+            unitOpen = true;
+            unitBytes = 0;
+        }
+        pieces.push_back(piece);
+        at += piece.size;
+        unitBytes += piece.output;
+        if (unitBytes >= kUnitBytes) unitOpen = false;
+    }
+    if (pieces.empty()) return false;
+
+    EXO_PHASE("load.decompress_batch");
+    size_t units = unitStart.size();
+    unitStart.push_back(pieces.size());
+    DynamicArray<std::string> outputs(units);
+    DynamicArray<unsigned char> ok(units);
+    algo::parallel_for(units, 1, [&](size_t begin, size_t end) {
+        for (size_t u = begin; u < end; ++u) {
+            const Piece* first = pieces.data + unitStart.data[u];
+            const Piece* last = pieces.data + unitStart.data[u + 1];
+            size_t bytes = 0;
+            for (const Piece* p = first; p < last; ++p) bytes += p->output;
+            outputs.data[u].resize(bytes);
+            ok.data[u] = decompressPieces(first, last, &outputs.data[u][0]);
+        }
+    });
+
+    for (size_t u = 0; u < units; ++u) {
+        if (!ok.data[u]) {
+            offset = pieces.data[unitStart.data[u]].offset;
+            return fail(std::string("corrupt ") + compressionName(compression) + " data");
+        }
+    }
+    size_t produced = 0;
+    for (size_t u = 0; u < units; ++u) {
+        produced += outputs.data[u].size();
+        if (!outputs.data[u].empty()) blocks.push_back(std::move(outputs.data[u]));
+    }
+    EXO_STATS_COUNT("io.pieces_decompressed", pieces.size());
+    EXO_STATS_COUNT("io.bytes_decompressed", produced);
+    offset = at;
+    return true;
+}
+
+bool CompressedReader::readStream(DynamicArray<std::string>& blocks) {
+    EXO_PHASE("load.decompress_stream");
+    std::string block(kStreamBlock, '\0');
+    size_t produced = 0;
+    bool ended = false;
+#ifdef EXO_HAVE_ZLIB
+    if (compression == Compression::Gzip) {
+        if (!stream) {
+            stream.reset(new Stream());
+            if (inflateInit2(&stream->inflater, 15 + 16) != Z_OK) return fail("cannot start inflating");
+            stream->inflating = true;
+        }
+        z_stream& inflater = stream->inflater;
+        inflater.next_out = reinterpret_cast<Bytef*>(&block[0]);
+        inflater.avail_out = static_cast<uInt>(block.size());
+        while (inflater.avail_out > 0) {
+            if (offset == size) return fail("gzip data ends early");
+            size_t chunk = size - offset < (size_t(1) << 30) ? size - offset : size_t(1) << 30;
+            inflater.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data + offset));
+            inflater.avail_in = static_cast<uInt>(chunk);
+            int status = inflate(&inflater, Z_NO_FLUSH);
+            offset += chunk - inflater.avail_in;
+            if (status == Z_STREAM_END) {
+                ended = true;
+                break;
+            }
+            if (status != Z_OK) return fail(inflater.msg ? inflater.msg : "corrupt gzip data");
+        }
+        produced = block.size() - inflater.avail_out;
+    }
+#endif
+#ifdef EXO_HAVE_ZSTD
+    if (compression == Compression::Zstd) {
+        if (!stream) {
+            stream.reset(new Stream());
+            stream->frame = ZSTD_createDCtx();
+            if (!stream->frame) return fail("cannot start decompressing");
+        }
+        ZSTD_inBuffer in = {data, size, offset};
+        ZSTD_outBuffer out = {&block[0], block.size(), 0};
+        while (out.pos < out.size) {
+            if (in.pos == in.size) {
+                offset = in.pos;
+                return fail("zstd data ends early");
+            }
+            size_t status = ZSTD_decompressStream(stream->frame, &out, &in);
+            if (ZSTD_isError(status)) {
+                offset = in.pos;
+                return fail(ZSTD_getErrorName(status));
+            }
+            if (status == 0) { // end of the frame, all of it flushed
+                ended = true;
+                break;
+            }
+        }
+        offset = in.pos;
+        produced = out.pos;
+    }
+#endif
+    // The next piece may decompress on its own again
+    if (ended) stream.reset();
+    EXO_STATS_COUNT("io.bytes_decompressed", produced);
+    block.resize(produced);
+    if (!block.empty()) blocks.push_back(std::move(block));
+    return true;
+}
@@ -0,0 +1,192 @@
+#include "../include/Ephemeris.hpp"
+#include "../include/algorithms/parallel.hpp"
+#include "../include/Stats.hpp"
+#include "../include/Trace.hpp"
+#include <cmath>
+#include <cstdint>
+
+namespace {
+    // Planets per task in the ephemeris passes
+    const size_t kEphemerisGrain = 16384;
+
+    const double kHoursPerDay = 24.0;
+
+    // Transit windows in one slice of windowsBetween, unless there are
+    // more planets than that: about what sorts within the cache
+    const size_t kSliceWindows = 32768;
+
+    // One past the last epoch a TransitWindow holds
+    const double kEpochLimit = static_cast<double>(INT32_MAX) + 1;
+}
+
+TransitEphemeris::TransitEphemeris(const DynamicArray<Exoplanet>& planets) {
+    EXO_PHASE("ephemeris.build");
+    for (size_t i = 0; i < planets.size(); ++i) {
+        const Exoplanet& planet = planets.data[i];
+        if (!std::isfinite(planet.koi_time0bk) || !(planet.koi_period > 0) ||
+            !std::isfinite(planet.koi_period) || !(planet.koi_duration >= 0) ||
+            !std::isfinite(planet.koi_duration)) {
+            continue;
+        }
+        epoch0.push_back(planet.koi_time0bk);
+        period.push_back(planet.koi_period);
+        halfWidth.push_back(planet.koi_duration / kHoursPerDay / 2);
+        rows.push_back(static_cast<uint32_t>(i));
+        if (halfWidth.back() > widestHalf) widestHalf = halfWidth.back();
+    }
+}
+
+void TransitEphemeris::epochRange(size_t begin, size_t end, double from, double to,
+                                  int64_t* first, int64_t* stop) const {
+    // A transit meets [from, to] when its midpoint lies within half a
+    // window of it. Epochs are clamped to what TransitWindow holds.
+    const double* t0 = epoch0.data;
+    const double* p = period.data;
+    const double* half = halfWidth.data;
+    for (size_t i = begin; i < end; ++i) {
+        double low = std::ceil((from - half[i] - t0[i]) / p[i]);
+        double high = std::floor((to + half[i] - t0[i]) / p[i]) + 1;
+        low = std::fmin(std::fmax(low, INT32_MIN), kEpochLimit);
+        high = std::fmin(std::fmax(high, INT32_MIN), kEpochLimit);
+        first[i - begin] = static_cast<int64_t>(low);
+        stop[i - begin] = static_cast<int64_t>(high > low ? high : low);
+    }
+}
+
+double TransitEphemeris::startOf(size_t i, int64_t epoch) const {
+    return (epoch0.data[i] + static_cast<double>(epoch) * period.data[i]) - halfWidth.data[i];
+}
+
+int64_t TransitEphemeris::firstStartingFrom(size_t i, double edge, int64_t first, int64_t stop) const {
+    double guess = std::ceil((edge + halfWidth.data[i] - epoch0.data[i]) / period.data[i]);
+    int64_t epoch = guess <= first ? first : guess >= stop ? stop : static_cast<int64_t>(guess);
+    // The division may round either way; settle on the computed starts
+    while (epoch > first && startOf(i, epoch - 1) >= edge) --epoch;
+    while (epoch < stop && startOf(i, epoch) < edge) ++epoch;
+    return epoch;
+}
+
+size_t TransitEphemeris::countBetween(double from, double to) const {
+    if (!(from <= to) || !std::isfinite(from) || !std::isfinite(to)) return 0;
+    return algo::parallel_reduce(rows.size(), kEphemerisGrain, size_t(0),
+        [&](size_t begin, size_t end) {
+            DynamicArray<int64_t> first(end - begin), stop(end - begin);
+            epochRange(begin, end, from, to, first.data, stop.data);
+            size_t count = 0;
+            for (size_t i = 0; i < end - begin; ++i) count += static_cast<size_t>(stop.data[i] - first.data[i]);
+            return count;
+        },
+        [](size_t a, size_t b) { return a + b; });
+}
+
+DynamicArray<TransitWindow> TransitEphemeris::windowsBetween(double from, double to) const {
+    EXO_PHASE("ephemeris.windows");
+    DynamicArray<TransitWindow> windows;
+    if (!(from <= to) || !std::isfinite(from) || !std::isfinite(to)) return windows;
+
+    size_t n = rows.size();
+    DynamicArray<int64_t> first(n), stop(n);
+    algo::parallel_for(n, kEphemerisGrain, [&](size_t begin, size_t end) {
+        epochRange(begin, end, from, to, first.data + begin, stop.data + begin);
+    });
+    size_t total = 0;
+    for (size_t i = 0; i < n; ++i) total += static_cast<size_t>(stop.data[i] - first.data[i]);
+    EXO_STATS_COUNT("ephemeris.windows", total);
+
+    // Windows are written slice by slice of start time. A slice holds at
+    // least as many windows as there are planets, so visiting every planet
+    // per slice costs no more than writing the windows, and is otherwise
+    // small enough to sort in cache; the slices then follow each other in
+    // start order. Slice edges are compared against the computed starts
+    // the windows get, so no window lands in the wrong slice.
+    size_t sliceWindows = n > kSliceWindows ? n : kSliceWindows;
+    size_t slices = total > sliceWindows ? total / sliceWindows : 1;
+    double base = from - 2 * widestHalf; // earliest start that can meet from
+    double width = (to - base) / static_cast<double>(slices);
+    auto edge = [&](size_t slice) { return base + static_cast<double>(slice) * width; };
+
+    // Walks slices [begin, end) in order, calling visit(i, low, high) with
+    // each planet's epochs in the slice and then done(slice). Each planet's
+    // next epoch carries over from one slice to the next.
+    auto walkSlices = [&](size_t begin, size_t end, auto&& visit, auto&& done) {
+        DynamicArray<int64_t> next(n);
+        for (size_t i = 0; i < n; ++i) {
+            next.data[i] = begin == 0 ? first.data[i]
+                                      : firstStartingFrom(i, edge(begin), first.data[i], stop.data[i]);
+        }
+        for (size_t slice = begin; slice < end; ++slice) {
+            double limit = edge(slice + 1);
+            bool last = slice + 1 == slices;
+            for (size_t i = 0; i < n; ++i) {
+                int64_t low = next.data[i], high = last ? stop.data[i] : low;
+                while (high < stop.data[i] && startOf(i, high) < limit) ++high;
+                visit(i, low, high);
+                next.data[i] = high;
+            }
+            done(slice);
+        }
+    };
+
+    DynamicArray<size_t> offsets(slices + 1);
+    offsets.data[0] = 0;
+    algo::parallel_for(slices, 1, [&](size_t begin, size_t end) {
+        size_t count = 0;
+        walkSlices(begin, end,
+                   [&count](size_t, int64_t low, int64_t high) { count += static_cast<size_t>(high - low); },
+                   [&](size_t slice) {
+                       offsets.data[slice + 1] = count;
+                       count = 0;
+                   });
+    });
+    for (size_t slice = 0; slice < slices; ++slice) offsets.data[slice + 1] += offsets.data[slice];
+
+    // Within a slice, starts spread evenly enough that a counting sort on
+    // where they fall in the slice leaves only neighbours out of order
+    windows = DynamicArray<TransitWindow>(total);
+    algo::parallel_for(slices, 1, [&](size_t begin, size_t end) {
+        DynamicArray<TransitWindow> scratch;
+        DynamicArray<size_t> buckets;
+        TransitWindow* staged = nullptr;
+        auto stage = [&](size_t i, int64_t low, int64_t high) {
+            double width = 2 * halfWidth.data[i];
+            for (int64_t epoch = low; epoch < high; ++epoch) {
+                double start = startOf(i, epoch);
+                *staged++ = TransitWindow{start, start + width, rows.data[i], static_cast<int32_t>(epoch)};
+            }
+        };
+        auto place = [&](size_t slice) {
+            size_t count = offsets.data[slice + 1] - offsets.data[slice];
+            double origin = edge(slice), span = edge(slice + 1) - origin;
+            double scale = span > 0 ? count / span : 0.0;
+            auto bucketOf = [&](double start) {
+                double b = (start - origin) * scale;
+                return b <= 0 ? size_t(0) : b >= count ? count - 1 : static_cast<size_t>(b);
+            };
+            for (size_t b = 0; b <= count; ++b) buckets.data[b] = 0;
+            for (size_t k = 0; k < count; ++k) ++buckets.data[bucketOf(scratch.data[k].start) + 1];
+            for (size_t b = 0; b < count; ++b) buckets.data[b + 1] += buckets.data[b];
+            TransitWindow* out = windows.data + offsets.data[slice];
+            for (size_t k = 0; k < count; ++k) out[buckets.data[bucketOf(scratch.data[k].start)]++] = scratch.data[k];
+            for (size_t k = 1; k < count; ++k) {
+                TransitWindow window = out[k];
+                size_t j = k;
+                for (; j > 0 && window.start < out[j - 1].start; --j) out[j] = out[j - 1];
+                out[j] = window;
+            }
+        };
+
+        size_t largest = 0;
+        for (size_t slice = begin; slice < end; ++slice) {
+            size_t count = offsets.data[slice + 1] - offsets.data[slice];
+            if (count > largest) largest = count;
+        }
+        scratch = DynamicArray<TransitWindow>(largest);
+        buckets = DynamicArray<size_t>(largest + 1);
+        staged = scratch.data;
+        walkSlices(begin, end, stage, [&](size_t slice) {
+            place(slice);
+            staged = scratch.data;
+        });
+    });
+    return windows;
+}
@@ -3,20 +3,435 @@
 #include "../include/algorithms/sorting.hpp"
 #include "../include/datastructs/HashTable.hpp"
 #include "../include/datastructs/MaxHeap.hpp"
+#include "../include/algorithms/kernels.hpp"
+#include "../include/algorithms/parallel.hpp"
+#include "../include/Trace.hpp"
 #include <numeric>
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 #include <iomanip>
 #include <fstream>
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <sys/stat.h>
+
+namespace {
+    // Mass-radius scalings used for the gravity and escape velocity estimates
+    const double kGravityExponent = 1.7;
+    const double kEscapeVelocityExponent = 1.35;
+    const double kEarthEscapeVelocity = 11.2; // km/s
+
+    // Rows per thread when computing derived columns
+    const size_t kDerivedGrain = 1 << 16;
+
+    const char* const kDefaultSimilarityFeatures[] = {"radius", "temperature", "insolation", "period"};
+
+    const double kDegToRad = M_PI / 180.0;
+
+    void unitVector(double ra, double dec, double* out) {
+        double cosDec = std::cos(dec * kDegToRad);
+        out[0] = cosDec * std::cos(ra * kDegToRad);
+        out[1] = cosDec * std::sin(ra * kDegToRad);
+        out[2] = std::sin(dec * kDegToRad);
+    }
+
+    bool raInRange(double ra, double raMin, double raMax) {
+        if (raMin <= raMax) return ra >= raMin && ra <= raMax;
+        return ra >= raMin || ra <= raMax; // wraps through 0
+    }
+
+    // Rows per task when moving planets into sorted order
+    const size_t kGatherGrain = 1 << 14;
+
+    // Rows per task when scanning the catalog for statistics
+    const size_t kScanGrain = 1 << 14;
+
+    // Rows per thread when probing a join
+    const size_t kJoinGrain = 1 << 14;
+
+    // A planet can match under both of its names; keep its first match only
+    void appendDistinct(DynamicArray<ExoplanetCatalog::NameMatch>& out, Exoplanet* planet,
+                        unsigned distance) {
+        for (const auto& match : out) {
+            if (match.planet == planet) return;
+        }
+        out.push_back(ExoplanetCatalog::NameMatch{planet, distance});
+    }
+
+    size_t joinPartition(int kepid, size_t partitions) {
+        uint64_t h = static_cast<uint64_t>(static_cast<uint32_t>(kepid)) * 0x9E3779B97F4A7C15ULL;
+        return static_cast<size_t>(h >> 32) % partitions;
+    }
+
+    // KOI name then Kepler name of each row, the order nameIndex inserts them
+    DynamicArray<std::pair<std::string, size_t>> namesByRow(const DynamicArray<Exoplanet>& planets) {
+        DynamicArray<std::pair<std::string, size_t>> names;
+        for (size_t i = 0; i < planets.size(); ++i) {
+            names.push_back(std::make_pair(planets[i].kepoi_name, i));
+            if (!planets[i].kepler_name.empty()) {
+                names.push_back(std::make_pair(planets[i].kepler_name, i));
+            }
+        }
+        return names;
+    }
+
+    // Folds a loaded file (size and modification time) and the row count
+    // after loading it into the running source tag
+    uint64_t extendSourceTag(uint64_t tag, const std::string& filename, size_t rows) {
+        struct stat st;
+        uint64_t parts[3] = {0, 0, rows};
+        if (stat(filename.c_str(), &st) == 0) {
+            parts[0] = static_cast<uint64_t>(st.st_size);
+            parts[1] = static_cast<uint64_t>(st.st_mtim.tv_sec) * 1000000000ULL +
+                       static_cast<uint64_t>(st.st_mtim.tv_nsec);
+        }
+        for (uint64_t part : parts) {
+            tag = (tag ^ part) * 0x9E3779B97F4A7C15ULL;
+            tag ^= tag >> 32;
+        }
+        return tag;
+    }
+
+    bool derivedColumnFor(const std::string& property, DerivedColumn& column) {
+        if (property == "gravity") column = DerivedColumn::Gravity;
+        else if (property == "escape_velocity") column = DerivedColumn::EscapeVelocity;
+        else if (property == "esi") column = DerivedColumn::Esi;
+        else if (property == "hz_distance") column = DerivedColumn::HzDistance;
+        else return false;
+        return true;
+    }
+
+    // Rows per task when hashing rows for a diff
+    const size_t kRowHashGrain = 1 << 14;
+
+    // Missing values hash and compare equal to each other
+    bool sameColumn(const Exoplanet& a, const Exoplanet& b, Column column) {
+        if (double Exoplanet::* field = columnInfo(column).field) {
+            return a.*field == b.*field || (std::isnan(a.*field) && std::isnan(b.*field));
+        }
+        if (auto field = textField(column)) return a.*field == b.*field;
+        if (auto field = intField(column)) return a.*field == b.*field;
+        return a.*flagField(column) == b.*flagField(column);
+    }
+
+    // Only doubles (NaN) and strings (empty) can be missing
+    bool isMissing(const Exoplanet& planet, Column column) {
+        if (double Exoplanet::* field = columnInfo(column).field) return std::isnan(planet.*field);
+        if (auto field = textField(column)) return (planet.*field).empty();
+        return false;
+    }
+
+    void copyColumn(Exoplanet& to, const Exoplanet& from, Column column) {
+        if (double Exoplanet::* field = columnInfo(column).field) to.*field = from.*field;
+        else if (auto field = textField(column)) to.*field = from.*field;
+        else if (auto field = intField(column)) to.*field = from.*field;
+        else to.*flagField(column) = from.*flagField(column);
+    }
+
+    ColumnMask changedColumns(const Exoplanet& a, const Exoplanet& b) {
+        ColumnMask changed = 0;
+        for (size_t c = 1; c < static_cast<size_t>(Column::Count); ++c) { // past rowid
+            Column column = static_cast<Column>(c);
+            if (!sameColumn(a, b, column)) changed |= columnBit(column);
+        }
+        return changed;
+    }
+
+    uint64_t hashBytes(const std::string& text) {
+        uint64_t h = 0xCBF29CE484222325ULL; // FNV-1a
+        for (unsigned char c : text) h = (h ^ c) * 0x100000001B3ULL;
+        return h;
+    }
+
+    // Folds every column but rowid; all NaNs hash alike, and 0 as -0
+    uint64_t rowHash(const Exoplanet& planet) {
+        uint64_t h = 0;
+        for (size_t c = 1; c < static_cast<size_t>(Column::Count); ++c) {
+            Column column = static_cast<Column>(c);
+            uint64_t word;
+            if (double Exoplanet::* field = columnInfo(column).field) {
+                double value = planet.*field;
+                if (std::isnan(value)) word = 0x7FF8000000000000ULL;
+                else if (value == 0.0) word = 0;
+                else std::memcpy(&word, &value, sizeof(word));
+            } else if (auto field = textField(column)) {
+                word = hashBytes(planet.*field);
+            } else if (auto field = intField(column)) {
+                word = static_cast<uint32_t>(planet.*field);
+            } else {
+                word = planet.*flagField(column);
+            }
+            h = (h ^ word) * 0x9E3779B97F4A7C15ULL;
+            h ^= h >> 29;
+        }
+        return h;
+    }
+
+    size_t namePartition(const std::string& name, size_t partitions) {
+        return static_cast<size_t>(hashBytes(name) >> 32) % partitions;
+    }
+
+    // Rows in ascending order of value, as sortedRows gives them
+    template <typename Values>
+    DynamicArray<size_t> sortRows(const Values& values, size_t* present) {
+        // Sort compact (key, row) pairs rather than whole planets. Missing
+        // values go last; ties keep file order.
+        size_t n = values.size();
+        DynamicArray<std::pair<double, size_t>> keys(n);
+        for (size_t i = 0; i < n; ++i) keys[i] = std::make_pair(values[i], i);
+        algo::parallel_quick_sort(keys.begin(), keys.end(),
+            [](const std::pair<double, size_t>& a, const std::pair<double, size_t>& b) {
+                bool aMissing = std::isnan(a.first), bMissing = std::isnan(b.first);
+                if (aMissing != bMissing) return bMissing;
+                if (!aMissing && a.first != b.first) return a.first < b.first;
+                return a.second < b.second;
+            });
+
+        DynamicArray<size_t> order(n);
+        size_t defined = 0;
+        for (size_t i = 0; i < n; ++i) {
+            order[i] = keys[i].second;
+            if (!std::isnan(keys[i].first)) ++defined;
+        }
+        if (present) *present = defined;
+        return order;
+    }
+
+    // Count, mean, median and extremes of the values present
+    template <typename Values>
+    ExoplanetCatalog::Stats statsOf(const Values& values) {
+        DynamicArray<double> present;
+        double sum = 0.0;
+        for (size_t i = 0; i < values.size(); ++i) {
+            if (std::isnan(values[i])) continue;
+            present.push_back(values[i]);
+            sum += values[i];
+        }
+
+        ExoplanetCatalog::Stats stats = {present.size(), NAN, NAN, NAN, NAN};
+        if (present.empty()) return stats;
+        auto less = [](double a, double b) { return a < b; };
+        auto middle = present.begin() + present.size() / 2;
+        algo::quick_select(present.begin(), middle, present.end(), less);
+        stats.median = *middle;
+        if (present.size() % 2 == 0) {
+            // Lower middle: the largest value below the upper one
+            double lower = present[0];
+            for (size_t i = 1; i < present.size() / 2; ++i) lower = std::max(lower, present[i]);
+            stats.median = (lower + stats.median) / 2.0;
+        }
+        stats.mean = sum / present.size();
+        stats.min = present[0];
+        stats.max = present[0];
+        for (size_t i = 1; i < present.size(); ++i) {
+            stats.min = std::min(stats.min, present[i]);
+            stats.max = std::max(stats.max, present[i]);
+        }
+        return stats;
+    }
+
+    // The n rows with the greatest (or least) values, best first; missing
+    // values never qualify
+    template <typename Values>
+    DynamicArray<size_t> topRows(const Values& values, size_t n, bool findMax) {
+        // Heaps of row numbers ordered by the property value
+        auto compare = [&values, findMax](size_t a, size_t b) {
+            return findMax ? (values[a] < values[b]) : (values[a] > values[b]);
+        };
+        auto worse = [&compare](size_t a, size_t b) { return compare(b, a); };
+
+        // Each chunk keeps its own best n (the heap top is the weakest of
+        // them); only those candidates go into the final selection
+        DynamicArray<size_t> none;
+        DynamicArray<size_t> candidates = algo::parallel_reduce(values.size(), kScanGrain, none,
+            [&](size_t begin, size_t end) {
+                MaxHeap<size_t, decltype(worse)> kept(worse);
+                for (size_t i = begin; i < end; ++i) {
+                    if (std::isnan(values[i])) continue;
+                    if (kept.size() < n) kept.push(i);
+                    else if (n > 0 && worse(i, kept.top())) kept.replace_top(i);
+                }
+                DynamicArray<size_t> rows;
+                while (!kept.empty()) {
+                    rows.push_back(kept.top());
+                    kept.pop();
+                }
+                return rows;
+            },
+            [](const DynamicArray<size_t>& a, const DynamicArray<size_t>& b) {
+                DynamicArray<size_t> merged = a;
+                for (size_t row : b) merged.push_back(row);
+                return merged;
+            });
+
+        MaxHeap<size_t, decltype(compare)> heap(std::move(candidates), compare);
+
+        DynamicArray<size_t> rows;
+        for (size_t i = 0; i < n && !heap.empty(); ++i) {
+            rows.push_back(heap.top());
+            heap.pop();
+        }
+        return rows;
+    }
+
+    // Compact-mode storage of the scanned source columns. Equilibrium
+    // temperatures are given to hundredths of a kelvin, far finer than
+    // their uncertainty, so quarter-kelvin steps (at most 0.125 K off) are
+    // enough; the others span too many decades for 16-bit steps.
+    struct CompactSpec {
+        const char* property;
+        Column column;
+        ColumnEncoding encoding;
+    };
+    const CompactSpec kCompactSpecs[] = {
+        {"radius",      Column::Prad,   {ColumnEncoding::Kind::Float32, 0.0}},
+        {"temperature", Column::Teq,    {ColumnEncoding::Kind::Scaled16, 0.25}},
+        {"period",      Column::Period, {ColumnEncoding::Kind::Float32, 0.0}},
+        {"insolation",  Column::Insol,  {ColumnEncoding::Kind::Float32, 0.0}},
+    };
+
+    // Result cache keys: the query kind, then its arguments, '|'-separated.
+    // Bounds are written exactly, in hexadecimal floating point.
+    std::string boundKey(double value) {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%a", value);
+        return text;
+    }
+}
+
+template <typename Compute>
+std::shared_ptr<const ExoplanetCatalog::CachedResult>
+ExoplanetCatalog::cachedResult(const std::string& key, Compute compute) const {
+    {
+        std::lock_guard<std::mutex> lock(resultLock);
+        if (resultsVersion != version) {
+            results.clear();
+            resultsVersion = version;
+        }
+        if (const auto* hit = results.get(key)) return *hit;
+    }
+    // Computed outside the lock: other queries go on meanwhile, and two
+    // threads missing on one key at once both compute it
+    auto result = std::make_shared<const CachedResult>(compute());
+    size_t cost = sizeof(CachedResult) + key.size() + result->rows.size() * sizeof(size_t);
+    for (const auto& group : result->groups) cost += sizeof(group) + group.first.size();
+    std::lock_guard<std::mutex> lock(resultLock);
+    if (resultsVersion == version) results.put(key, result, cost);
+    return result;
+}
 
 void ExoplanetCatalog::addPlanet(const Exoplanet& planet) {
+    requireAllColumns(); // new rows have no source offset
     planets.push_back(planet);
+    asLoaded = false;
+    ++version;
 }
 
-void ExoplanetCatalog::loadData(const std::string& filename) {
-    if (!FileIO::parseCSV(filename, *this)) {
+void ExoplanetCatalog::addPlanet(Exoplanet&& planet) {
+    requireAllColumns();
+    planets.push_back(std::move(planet));
+    asLoaded = false;
+    ++version;
+}
+
+// Row positions changed: index pointers and row-aligned caches are stale
+void ExoplanetCatalog::reordered() {
+    ++version;
+    asLoaded = false;
+    perfectHashCurrent = false; // its rows are load positions
+    if (indexed) buildIndices();
+}
+
+void ExoplanetCatalog::loadData(const std::string& filename, LoadMode mode, LoadProgress* progress) {
+    EXO_PHASE("catalog.load");
+    if (ArrowTable::isArrowFile(filename)) {
+        loadArrow(filename, mode, progress);
+        return;
+    }
+    bool wasAsLoaded = asLoaded; // the loaders append through addPlanet
+    // Lazy columns are decoded from the file in place, which a compressed
+    // file does not allow
+    if (mode == LoadMode::Lazy && FileIO::compressionOf(filename) != Compression::None) mode = LoadMode::Eager;
+    if (mode == LoadMode::Eager) {
+        if (!FileIO::parseCSV(filename, *this, progress, parsePolicy, &parseSummary)) {
+            throw std::runtime_error("Failed to load data from " + filename);
+        }
+        asLoaded = wasAsLoaded;
+        sourceTag = extendSourceTag(sourceTag, filename, planets.size());
+        perfectHashCurrent = false;
+        ++version;
+        return;
+    }
+
+    // Only one lazy source at a time: finish decoding the previous one
+    requireAllColumns();
+
+    lazyFirstRow = planets.size();
+    if (!source.open(filename) || !FileIO::indexCSV(source, kLazyKeyColumns, *this, rowOffsets, parsePolicy, &parseSummary)) {
+        source.close();
+        rowOffsets = DynamicArray<size_t>();
         throw std::runtime_error("Failed to load data from " + filename);
     }
+    if (progress) {
+        progress->totalBytes = source.size();
+        progress->readBytes = source.size();
+        progress->parsedBytes = source.size();
+    }
+    loadedColumns = kLazyKeyColumns;
+    asLoaded = wasAsLoaded;
+    sourceTag = extendSourceTag(sourceTag, filename, planets.size());
+    perfectHashCurrent = false;
+    ++version;
+}
+
+void ExoplanetCatalog::loadArrow(const std::string& filename, LoadMode mode, LoadProgress* progress) {
+    // Only one lazy source at a time: finish decoding the previous one
+    requireAllColumns();
+
+    if (!arrowSource.open(filename)) throw std::runtime_error("Failed to load data from " + filename);
+    if (progress) {
+        progress->totalBytes = arrowSource.fileSize();
+        progress->readBytes = arrowSource.fileSize();
+        progress->parsedBytes = arrowSource.fileSize();
+    }
+    // Rows arrive whole and valid, so they go in directly rather than
+    // through addPlanet
+    lazyFirstRow = planets.size();
+    if (mode == LoadMode::Lazy) {
+        arrowSource.appendTo(planets, kLazyKeyColumns);
+        loadedColumns = kLazyKeyColumns;
+    } else {
+        arrowSource.appendTo(planets, kAllColumns);
+        arrowSource.close();
+    }
+    parseSummary = ParseSummary();
+    parseSummary.accepted = planets.size() - lazyFirstRow;
+    sourceTag = extendSourceTag(sourceTag, filename, planets.size());
+    perfectHashCurrent = false;
+    ++version;
+}
+
+void ExoplanetCatalog::requireColumns(ColumnMask columns) const {
+    ColumnMask missing = columns & ~loadedColumns;
+    if (!missing) return;
+
+    EXO_PHASE("catalog.require_columns");
+    // Filling in cached fields does not change the catalog's logical state
+    auto& rows = const_cast<DynamicArray<Exoplanet>&>(planets);
+    if (arrowSource.isOpen()) arrowSource.decode(missing, rows, lazyFirstRow);
+    else FileIO::decodeColumns(source, rowOffsets, missing, rows, lazyFirstRow);
+    loadedColumns |= missing;
+
+    if (loadedColumns == kAllColumns) {
+        source.close();
+        arrowSource.close();
+        rowOffsets = DynamicArray<size_t>();
+    }
 }
 
 const DynamicArray<Exoplanet>& ExoplanetCatalog::getPlanets() const {
@@ -24,54 +439,917 @@ const DynamicArray<Exoplanet>& ExoplanetCatalog::getPlanets() const {
 }
 
 bool ExoplanetCatalog::saveResults(const std::string& filename) const {
+    EXO_PHASE("catalog.save_results");
+    requireAllColumns();
+    if (isArrowPath(filename)) return writeArrowFile(filename, planets);
     return FileIO::writeCSV(filename, planets);
 }
 
+bool ExoplanetCatalog::saveRows(const std::string& filename, const DynamicArray<size_t>& rows) const {
+    EXO_PHASE("catalog.save_rows");
+    requireAllColumns();
+    if (isArrowPath(filename)) return writeArrowFile(filename, planets, rows);
+    return FileIO::writeCSV(filename, planets, rows);
+}
+
 void ExoplanetCatalog::buildIndices() {
-    tempTree.clear();
-    nameIndex.clear(); // clear hash table before rebuilding
+    EXO_PHASE("catalog.build_indices");
 
-    for (auto& planet : planets) {
-        // Insert into temperature index (if needed)
-        if (!std::isnan(planet.koi_teq)) {
-            tempTree.insert(planet.koi_teq, &planet);
+    // The two indices share no state, so build them side by side, each
+    // itself in parallel. Both come out the same whatever the thread count.
+    TaskGroup group;
+    group.run([this] {
+        EXO_PHASE("index.temperature_tree");
+        // Temperature index: sort the keys, then bulk-load a balanced tree.
+        // Equal temperatures stay in row order, so the tree does not depend
+        // on how the sort split the work.
+        DynamicArray<std::pair<double, Exoplanet*>> temps;
+        for (auto& planet : planets) {
+            if (!std::isnan(planet.koi_teq)) {
+                temps.push_back(std::make_pair(planet.koi_teq, &planet));
+            }
         }
+        algo::parallel_quick_sort(temps.begin(), temps.end(),
+            [](const std::pair<double, Exoplanet*>& a, const std::pair<double, Exoplanet*>& b) {
+                return a.first < b.first || (a.first == b.first && a.second < b.second);
+            });
+        tempTree.assign_sorted(temps);
+    });
+    group.run([this] {
+        if (perfectHashCurrent) return; // names are served from the mapped index
+        EXO_PHASE("index.names");
+        nameIndex.clear(); // clear hash table before rebuilding
 
-        // Insert both KOI and Kepler names into the hash table
-        nameIndex.insert(planet.kepoi_name, &planet);
-        if (!planet.kepler_name.empty()) {
-            nameIndex.insert(planet.kepler_name, &planet);
-        }
-    }
+        // KOI then Kepler name of each row: key 2i is row i's KOI name,
+        // 2i + 1 its Kepler name if it has one
+        Exoplanet* rows = planets.data;
+        nameIndex.build(2 * planets.size(),
+            [rows](size_t i) -> const std::string* {
+                const Exoplanet& planet = rows[i / 2];
+                if (i % 2 == 0) return &planet.kepoi_name;
+                return planet.kepler_name.empty() ? nullptr : &planet.kepler_name;
+            },
+            [rows](size_t i) { return rows + i / 2; });
+    });
+    group.wait();
+    indexed = true;
 }
 
 Exoplanet* ExoplanetCatalog::findPlanetByName(const std::string& name) const {
-    if (nameIndex.contains(name)) {
-        return nameIndex[name]; // returns Exoplanet*
+    EXO_STATS_COUNT("query.name_lookups", 1);
+    if (perfectHashCurrent) {
+        uint32_t row = namePerfectHash.find(name);
+        if (row >= planets.size()) return nullptr;
+        // The fingerprint turns away nearly every miss; this catches the rest
+        Exoplanet* planet = planets.data + row;
+        return planet->kepoi_name == name || planet->kepler_name == name ? planet : nullptr;
     }
-    return nullptr;
+    Exoplanet* const* planet = nameIndex.find(name);
+    return planet ? *planet : nullptr;
+}
+
+bool ExoplanetCatalog::saveNameIndex(const std::string& filename) const {
+    EXO_PHASE("catalog.save_name_index");
+    if (!asLoaded) {
+        std::cerr << "Cannot save a name index: rows have changed since loading" << std::endl;
+        return false;
+    }
+    if (planets.size() >= PerfectHashIndex::kNotFound) {
+        std::cerr << "Cannot save a name index: too many rows" << std::endl;
+        return false;
+    }
+    auto names = namesByRow(planets);
+    DynamicArray<std::pair<std::string, uint32_t>> keys(names.size());
+    for (size_t i = 0; i < names.size(); ++i) {
+        keys[i] = std::make_pair(names[i].first, static_cast<uint32_t>(names[i].second));
+    }
+    PerfectHashIndex index;
+    index.build(keys, sourceTag);
+    return index.save(filename);
+}
+
+bool ExoplanetCatalog::useNameIndex(const std::string& filename) {
+    EXO_PHASE("catalog.open_name_index");
+    struct stat st;
+    if (!asLoaded || stat(filename.c_str(), &st) != 0) return false;
+    if (!namePerfectHash.open(filename, sourceTag)) {
+        std::cerr << "Ignoring name index " << filename << ": it does not match the loaded catalog" << std::endl;
+        return false;
+    }
+    perfectHashCurrent = true;
+    nameIndex.clear();
+    return true;
+}
+
+void ExoplanetCatalog::buildNameTrie() const {
+    if (nameTrieVersion == version) return;
+    EXO_PHASE("index.name_trie");
+    nameTrie.build(namesByRow(planets));
+    nameTrieVersion = version;
+}
+
+DynamicArray<ExoplanetCatalog::NameMatch> ExoplanetCatalog::findPlanetsByPrefix(
+        const std::string& prefix, size_t limit) const {
+    EXO_STATS_COUNT("query.name_prefix", 1);
+    buildNameTrie();
+    DynamicArray<NameMatch> results;
+    size_t lo, hi;
+    if (!nameTrie.prefixRange(prefix, lo, hi)) return results;
+    for (size_t i = lo; i < hi && results.size() < limit; ++i) {
+        appendDistinct(results, planets.data + nameTrie.value(i), 0);
+    }
+    return results;
+}
+
+DynamicArray<ExoplanetCatalog::NameMatch> ExoplanetCatalog::findPlanetsByFuzzyName(
+        const std::string& name, unsigned maxDistance, size_t limit) const {
+    EXO_STATS_COUNT("query.name_fuzzy", 1);
+    buildNameTrie();
+    // Ask for a few extra keys: a planet's second name may also match
+    auto keys = nameTrie.fuzzySearch(name, maxDistance, 2 * limit);
+    DynamicArray<NameMatch> results;
+    for (const auto& match : keys) {
+        if (results.size() == limit) break;
+        appendDistinct(results, planets.data + nameTrie.value(match.key), match.distance);
+    }
+    return results;
 }
 
 
 void ExoplanetCatalog::sortByPeriod() {
-    algo::quick_sort(planets.begin(), planets.end(), 
-        [](const Exoplanet& a, const Exoplanet& b) {
-            return a.koi_period < b.koi_period;
-        });
+    sortByProperty("period");
 }
 
 void ExoplanetCatalog::sortByRadius() {
-    algo::quick_sort(planets.begin(), planets.end(),
-        [](const Exoplanet& a, const Exoplanet& b) {
-            return a.koi_prad < b.koi_prad;
-        });
+    sortByProperty("radius");
 }
 
 void ExoplanetCatalog::sortByTemperature() {
-    algo::quick_sort(planets.begin(), planets.end(),
-        [](const Exoplanet& a, const Exoplanet& b) {
-            return a.koi_teq < b.koi_teq;
+    sortByProperty("temperature");
+}
+
+void ExoplanetCatalog::sortByProperty(const std::string& property) {
+    EXO_PHASE("catalog.sort");
+    requireAllColumns(); // reordering detaches rows from their source offsets
+    DynamicArray<size_t> order = sortedRows(property);
+
+    // Move each planet once
+    size_t n = planets.size();
+    DynamicArray<Exoplanet> sorted(n);
+    algo::parallel_for(n, kGatherGrain, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            sorted[i] = std::move(planets[order[i]]);
+        }
+    });
+    planets = std::move(sorted);
+    reordered();
+}
+
+DynamicArray<size_t> ExoplanetCatalog::sortedRows(const std::string& property, size_t* present) const {
+    EXO_PHASE("catalog.sorted_rows");
+    if (const CompactColumn* column = compactColumn(property)) return sortRows(*column, present);
+    return sortRows(propertyValues(property), present);
+}
+
+void ExoplanetCatalog::setCompactMode(bool enabled) {
+    if (enabled == compactMode) return;
+    compactMode = enabled;
+    if (!enabled) {
+        for (auto& column : compactColumns) column = CompactColumn();
+        compactVersion = UINT64_MAX;
+    }
+    std::lock_guard<std::mutex> lock(resultLock);
+    resultsVersion = UINT64_MAX; // results so far came from the other storage
+}
+
+size_t ExoplanetCatalog::compactBytes() const {
+    size_t bytes = 0;
+    for (const auto& column : compactColumns) bytes += column.bytes();
+    return bytes;
+}
+
+const CompactColumn* ExoplanetCatalog::compactColumn(const std::string& property) const {
+    if (!compactMode) return nullptr;
+    for (size_t c = 0; c < kCompactColumnCount; ++c) {
+        if (property != kCompactSpecs[c].property) continue;
+        if (compactVersion != version) buildCompactColumns();
+        return &compactColumns[c];
+    }
+    return nullptr;
+}
+
+void ExoplanetCatalog::buildCompactColumns() const {
+    EXO_PHASE("catalog.compact_columns");
+    static_assert(sizeof(kCompactSpecs) / sizeof(kCompactSpecs[0]) == kCompactColumnCount,
+                  "compact column table out of sync");
+    ColumnMask needed = 0;
+    for (const auto& spec : kCompactSpecs) needed |= columnBit(spec.column);
+    requireColumns(needed);
+    for (size_t c = 0; c < kCompactColumnCount; ++c) {
+        double Exoplanet::* field = columnInfo(kCompactSpecs[c].column).field;
+        compactColumns[c].encode(planets.size(), kCompactSpecs[c].encoding,
+                                 [this, field](size_t i) { return planets[i].*field; });
+    }
+    compactVersion = version;
+}
+
+const DynamicArray<double>& ExoplanetCatalog::getDerivedColumn(DerivedColumn column) const {
+    if (derivedVersion != version) computeDerivedColumns();
+    return derived[static_cast<size_t>(column)];
+}
+
+void ExoplanetCatalog::computeDerivedColumns() const {
+    EXO_PHASE("catalog.derived_columns");
+    requireColumns(columnBit(Column::Prad) | columnBit(Column::Insol));
+
+    size_t n = planets.size();
+    DynamicArray<double> radius(n), insolation(n);
+    for (size_t i = 0; i < n; ++i) {
+        radius[i] = planets[i].koi_prad;
+        insolation[i] = planets[i].koi_insol;
+    }
+
+    for (auto& column : derived) column = DynamicArray<double>(n);
+    double* gravity = derived[static_cast<size_t>(DerivedColumn::Gravity)].data;
+    double* escape = derived[static_cast<size_t>(DerivedColumn::EscapeVelocity)].data;
+    double* esi = derived[static_cast<size_t>(DerivedColumn::Esi)].data;
+    double* hz = derived[static_cast<size_t>(DerivedColumn::HzDistance)].data;
+
+    algo::parallel_for(n, kDerivedGrain, [&](size_t begin, size_t end) {
+        size_t count = end - begin;
+        algo::scaled_pow(radius.data + begin, kGravityExponent, 1.0, gravity + begin, count);
+        algo::scaled_pow(radius.data + begin, kEscapeVelocityExponent, kEarthEscapeVelocity,
+                         escape + begin, count);
+        algo::earth_similarity(radius.data + begin, insolation.data + begin, esi + begin, count);
+        algo::scaled_pow(insolation.data + begin, -0.5, 1.0, hz + begin, count);
+    });
+
+    derivedVersion = version;
+}
+
+bool ExoplanetCatalog::isProperty(const std::string& property) {
+    DerivedColumn column;
+    return derivedColumnFor(property, column) || property == "radius" || property == "temperature" ||
+           property == "period" || property == "insolation";
+}
+
+DynamicArray<double> ExoplanetCatalog::propertyValues(const std::string& property) const {
+    DerivedColumn column;
+    if (derivedColumnFor(property, column)) {
+        return getDerivedColumn(column);
+    }
+
+    double Exoplanet::* field = nullptr;
+    if (property == "radius") field = &Exoplanet::koi_prad;
+    else if (property == "temperature") field = &Exoplanet::koi_teq;
+    else if (property == "period") field = &Exoplanet::koi_period;
+    else if (property == "insolation") {
+        requireColumns(columnBit(Column::Insol));
+        field = &Exoplanet::koi_insol;
+    }
+    else throw std::invalid_argument("Unknown property: " + property);
+
+    DynamicArray<double> values(planets.size());
+    for (size_t i = 0; i < planets.size(); ++i) {
+        values[i] = planets[i].*field;
+    }
+    return values;
+}
+
+double ExoplanetCatalog::propertyValue(const std::string& property, size_t row) const {
+    DerivedColumn column;
+    if (derivedColumnFor(property, column)) return getDerivedColumn(column)[row];
+    if (property == "radius") return planets[row].koi_prad;
+    if (property == "temperature") return planets[row].koi_teq;
+    if (property == "period") return planets[row].koi_period;
+    if (property == "insolation") {
+        requireColumns(columnBit(Column::Insol));
+        return planets[row].koi_insol;
+    }
+    throw std::invalid_argument("Unknown property: " + property);
+}
+
+DynamicArray<Exoplanet> ExoplanetCatalog::filterByRange(const std::string& property,
+                                                        double min, double max) const {
+    RowList rows = rowsInRange(property, min, max);
+    DynamicArray<Exoplanet> matches;
+    for (size_t row : *rows) matches.push_back(planets[row]);
+    return matches;
+}
+
+ExoplanetCatalog::RowList ExoplanetCatalog::rowsInRange(const std::string& property,
+                                                        double min, double max) const {
+    std::string key = "range|" + property + "|" + boundKey(min) + "|" + boundKey(max);
+    auto cached = cachedResult(key, [&] {
+        EXO_PHASE("query.filter_range");
+        CachedResult result;
+        if (const CompactColumn* column = compactColumn(property)) {
+            result.rows = column->rowsInRange(min, max);
+            return result;
+        }
+        DynamicArray<double> values = propertyValues(property);
+        for (size_t i = 0; i < values.size(); ++i) {
+            if (values[i] >= min && values[i] <= max) { // NaN never matches
+                result.rows.push_back(i);
+            }
+        }
+        return result;
+    });
+    return RowList(cached, &cached->rows);
+}
+
+ExoplanetCatalog::Stats ExoplanetCatalog::analyzeProperty(const std::string& property) const {
+    return cachedResult("stats|" + property, [&] {
+        CachedResult result;
+        result.stats = computeStats(property);
+        return result;
+    })->stats;
+}
+
+ExoplanetCatalog::Stats ExoplanetCatalog::computeStats(const std::string& property) const {
+    EXO_PHASE("query.property_stats");
+    if (const CompactColumn* column = compactColumn(property)) {
+        Stats stats = statsOf(*column);
+        for (double* value : {&stats.mean, &stats.median, &stats.min, &stats.max}) *value = column->rounded(*value);
+        return stats;
+    }
+    return statsOf(propertyValues(property));
+}
+
+void ExoplanetCatalog::setSimilarityFeatures(const DynamicArray<std::string>& features) {
+    for (const auto& feature : features) {
+        propertyValues(feature); // throws on unknown names
+    }
+    similarityFeatures = features;
+    similarityVersion = UINT64_MAX;
+}
+
+void ExoplanetCatalog::buildSimilarityIndex() const {
+    if (similarityVersion != version) buildSimilarityPoints();
+}
+
+void ExoplanetCatalog::buildSimilarityPoints() const {
+    EXO_PHASE("catalog.similarity_index");
+    DynamicArray<std::string> features = similarityFeatures;
+    if (features.empty()) {
+        for (const char* name : kDefaultSimilarityFeatures) features.push_back(name);
+    }
+
+    // Features span orders of magnitude, so compare log10 values scaled to
+    // zero mean and unit variance
+    size_t n = planets.size();
+    size_t dims = features.size();
+    similarityPoints = DynamicArray<double>(n * dims);
+    for (size_t d = 0; d < dims; ++d) {
+        DynamicArray<double> values = propertyValues(features[d]);
+        double sum = 0.0, sumSquares = 0.0;
+        size_t count = 0;
+        for (size_t i = 0; i < n; ++i) {
+            double v = values[i] > 0.0 ? std::log10(values[i]) : NAN;
+            similarityPoints[i * dims + d] = v;
+            if (!std::isnan(v)) {
+                sum += v;
+                sumSquares += v * v;
+                ++count;
+            }
+        }
+        double mean = count ? sum / count : 0.0;
+        double variance = count ? sumSquares / count - mean * mean : 0.0;
+        double sd = variance > 0.0 ? std::sqrt(variance) : 1.0;
+        for (size_t i = 0; i < n; ++i) {
+            similarityPoints[i * dims + d] = (similarityPoints[i * dims + d] - mean) / sd;
+        }
+    }
+
+    DynamicArray<double> points;
+    DynamicArray<size_t> rows;
+    for (size_t i = 0; i < n; ++i) {
+        bool complete = true;
+        for (size_t d = 0; d < dims; ++d) {
+            if (std::isnan(similarityPoints[i * dims + d])) complete = false;
+        }
+        if (!complete) continue;
+        for (size_t d = 0; d < dims; ++d) points.push_back(similarityPoints[i * dims + d]);
+        rows.push_back(i);
+    }
+    similarityTree.build(dims, points, rows);
+    similarityVersion = version;
+}
+
+size_t ExoplanetCatalog::rowOf(const Exoplanet& planet) const {
+    if (planets.empty() || &planet < planets.data || &planet >= planets.data + planets.size()) {
+        throw std::invalid_argument("Planet is not part of this catalog");
+    }
+    return static_cast<size_t>(&planet - planets.data);
+}
+
+DynamicArray<ExoplanetCatalog::Neighbor> ExoplanetCatalog::findSimilarPlanets(
+        const Exoplanet& planet, size_t k, const DynamicArray<double>& weights) const {
+    buildSimilarityIndex();
+    size_t row = rowOf(planet);
+    size_t dims = similarityTree.dimensions();
+    if (!weights.empty() && weights.size() != dims) {
+        throw std::invalid_argument("Expected one weight per similarity feature");
+    }
+
+    DynamicArray<Neighbor> similar;
+    const double* query = similarityPoints.data + row * dims;
+    for (size_t d = 0; d < dims; ++d) {
+        if (std::isnan(query[d])) return similar; // planet lacks a feature
+    }
+
+    // Ask for one extra: the planet is its own nearest neighbour
+    DynamicArray<Neighbor> found = similarityTree.nearest(query, k + 1,
+                                                          weights.empty() ? nullptr : weights.data);
+    for (size_t i = 0; i < found.size() && similar.size() < k; ++i) {
+        if (found[i].value != row) similar.push_back(found[i]);
+    }
+    return similar;
+}
+
+DynamicArray<ExoplanetCatalog::Neighbor> ExoplanetCatalog::findPlanetsWithin(
+        const Exoplanet& planet, double radius, const DynamicArray<double>& weights) const {
+    buildSimilarityIndex();
+    size_t row = rowOf(planet);
+    size_t dims = similarityTree.dimensions();
+    if (!weights.empty() && weights.size() != dims) {
+        throw std::invalid_argument("Expected one weight per similarity feature");
+    }
+
+    DynamicArray<Neighbor> nearby;
+    const double* query = similarityPoints.data + row * dims;
+    for (size_t d = 0; d < dims; ++d) {
+        if (std::isnan(query[d])) return nearby;
+    }
+
+    DynamicArray<Neighbor> found = similarityTree.within(query, radius,
+                                                         weights.empty() ? nullptr : weights.data);
+    for (size_t i = 0; i < found.size(); ++i) {
+        if (found[i].value != row) nearby.push_back(found[i]);
+    }
+    return nearby;
+}
+
+// Reference linear scan over the same feature space, for validating and
+// benchmarking the k-d tree
+DynamicArray<ExoplanetCatalog::Neighbor> ExoplanetCatalog::findSimilarPlanetsBruteForce(
+        const Exoplanet& planet, size_t k, const DynamicArray<double>& weights) const {
+    buildSimilarityIndex();
+    size_t row = rowOf(planet);
+    size_t dims = similarityTree.dimensions();
+    if (!weights.empty() && weights.size() != dims) {
+        throw std::invalid_argument("Expected one weight per similarity feature");
+    }
+
+    DynamicArray<Neighbor> similar;
+    const double* query = similarityPoints.data + row * dims;
+    for (size_t d = 0; d < dims; ++d) {
+        if (std::isnan(query[d])) return similar;
+    }
+
+    MaxHeap<std::pair<double, size_t>> best;
+    for (size_t i = 0; i < planets.size(); ++i) {
+        if (i == row) continue;
+        const double* p = similarityPoints.data + i * dims;
+        double d2 = 0.0;
+        for (size_t d = 0; d < dims; ++d) {
+            double diff = p[d] - query[d];
+            d2 += (weights.empty() ? 1.0 : weights[d]) * diff * diff;
+        }
+        if (std::isnan(d2)) continue;
+        if (best.size() < k) best.emplace(d2, i);
+        else if (k > 0 && d2 < best.top().first) best.replace_top(std::make_pair(d2, i));
+    }
+
+    DynamicArray<Neighbor> reversed;
+    while (!best.empty()) {
+        reversed.push_back(Neighbor{best.top().second, std::sqrt(best.top().first)});
+        best.pop();
+    }
+    for (size_t i = reversed.size(); i > 0; --i) similar.push_back(reversed[i - 1]);
+    return similar;
+}
+
+void ExoplanetCatalog::buildSkyIndex() const {
+    if (skyVersion == version) return;
+    EXO_PHASE("catalog.sky_index");
+    requireColumns(columnBit(Column::Ra) | columnBit(Column::Dec));
+
+    DynamicArray<double> points;
+    DynamicArray<size_t> rows;
+    for (size_t i = 0; i < planets.size(); ++i) {
+        const auto& planet = planets[i];
+        if (std::isnan(planet.ra) || std::isnan(planet.dec)) continue;
+        double v[3];
+        unitVector(planet.ra, planet.dec, v);
+        for (double c : v) points.push_back(c);
+        rows.push_back(i);
+    }
+    skyTree.build(3, points, rows);
+
+    const DynamicArray<Exoplanet>& all = planets;
+    algo::quick_sort(rows.begin(), rows.end(),
+        [&all](size_t a, size_t b) { return all[a].dec < all[b].dec; });
+    decOrder = rows;
+    decSorted = DynamicArray<double>(rows.size());
+    for (size_t i = 0; i < rows.size(); ++i) decSorted[i] = planets[rows[i]].dec;
+
+    skyVersion = version;
+}
+
+DynamicArray<size_t> ExoplanetCatalog::coneSearch(double ra, double dec, double radiusDeg) const {
+    buildSkyIndex();
+
+    // Angular distance is monotonic in chord length between unit vectors
+    double center[3];
+    unitVector(ra, dec, center);
+    double chord = 2.0 * std::sin(0.5 * std::min(radiusDeg, 180.0) * kDegToRad);
+
+    auto found = skyTree.within(center, chord);
+    DynamicArray<size_t> rows;
+    for (const auto& neighbor : found) rows.push_back(neighbor.value);
+    return rows;
+}
+
+DynamicArray<size_t> ExoplanetCatalog::boxSearch(double raMin, double raMax,
+                                                 double decMin, double decMax) const {
+    buildSkyIndex();
+
+    // First row with dec >= decMin, then walk the band
+    size_t lo = 0, hi = decSorted.size();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (decSorted[mid] < decMin) lo = mid + 1;
+        else hi = mid;
+    }
+
+    DynamicArray<size_t> rows;
+    for (size_t i = lo; i < decSorted.size() && decSorted[i] <= decMax; ++i) {
+        if (raInRange(planets[decOrder[i]].ra, raMin, raMax)) rows.push_back(decOrder[i]);
+    }
+    return rows;
+}
+
+// Reference scans for validating the sky index
+DynamicArray<size_t> ExoplanetCatalog::coneSearchBruteForce(double ra, double dec, double radiusDeg) const {
+    requireColumns(columnBit(Column::Ra) | columnBit(Column::Dec));
+
+    DynamicArray<size_t> rows;
+    double dec1 = dec * kDegToRad;
+    for (size_t i = 0; i < planets.size(); ++i) {
+        // Haversine angular separation
+        double dec2 = planets[i].dec * kDegToRad;
+        double sinDDec = std::sin(0.5 * (dec2 - dec1));
+        double sinDRa = std::sin(0.5 * (planets[i].ra - ra) * kDegToRad);
+        double h = sinDDec * sinDDec + std::cos(dec1) * std::cos(dec2) * sinDRa * sinDRa;
+        double separation = 2.0 * std::asin(std::sqrt(std::min(1.0, h))) / kDegToRad;
+        if (separation <= radiusDeg) rows.push_back(i); // NaN never matches
+    }
+    return rows;
+}
+
+DynamicArray<size_t> ExoplanetCatalog::boxSearchBruteForce(double raMin, double raMax,
+                                                           double decMin, double decMax) const {
+    requireColumns(columnBit(Column::Ra) | columnBit(Column::Dec));
+
+    DynamicArray<size_t> rows;
+    for (size_t i = 0; i < planets.size(); ++i) {
+        const auto& planet = planets[i];
+        if (planet.dec >= decMin && planet.dec <= decMax && raInRange(planet.ra, raMin, raMax)) {
+            rows.push_back(i);
+        }
+    }
+    return rows;
+}
+
+const TransitEphemeris& ExoplanetCatalog::transitEphemeris() const {
+    if (ephemerisVersion != version) {
+        requireColumns(columnBit(Column::Period) | columnBit(Column::Time0bk) | columnBit(Column::Duration));
+        ephemeris = TransitEphemeris(planets);
+        ephemerisVersion = version;
+    }
+    return ephemeris;
+}
+
+TransitIndex ExoplanetCatalog::transitsBetween(double from, double to) const {
+    return TransitIndex(transitEphemeris().windowsBetween(from, to));
+}
+
+void ExoplanetCatalog::buildSystemIndex() const {
+    if (systemVersion == version) return;
+    EXO_PHASE("catalog.system_index");
+
+    systemIndex.clear();
+    systemIndex.reserve(planets.size());
+    for (size_t i = 0; i < planets.size(); ++i) {
+        DynamicArray<size_t>* rows = systemIndex.find(planets[i].kepid);
+        if (rows) {
+            rows->push_back(i);
+        } else {
+            DynamicArray<size_t> first;
+            first.push_back(i);
+            systemIndex.insert(planets[i].kepid, first);
+        }
+    }
+    systemVersion = version;
+}
+
+DynamicArray<size_t> ExoplanetCatalog::getSystemRows(int kepid) const {
+    buildSystemIndex();
+    const DynamicArray<size_t>* rows = systemIndex.find(kepid);
+    return rows ? *rows : DynamicArray<size_t>();
+}
+
+DynamicArray<ExoplanetCatalog::SystemSummary> ExoplanetCatalog::analyzeSystems(size_t minPlanets) const {
+    requireColumns(columnBit(Column::Depth));
+    buildSystemIndex();
+
+    DynamicArray<const DynamicArray<size_t>*> groups;
+    DynamicArray<int> kepids;
+    for (size_t b = 0; b < systemIndex.bucketCount(); ++b) {
+        for (auto* entry = systemIndex.getBucket(b); entry; entry = entry->next) {
+            if (entry->value.size() >= minPlanets) {
+                groups.push_back(&entry->value);
+                kepids.push_back(entry->key);
+            }
+        }
+    }
+
+    DynamicArray<SystemSummary> systems(groups.size());
+    algo::parallel_for(groups.size(), 1024, [&](size_t begin, size_t end) {
+        for (size_t g = begin; g < end; ++g) {
+            DynamicArray<size_t> rows = *groups[g];
+            const DynamicArray<Exoplanet>& all = planets;
+            algo::quick_sort(rows.begin(), rows.end(), [&all](size_t a, size_t b) {
+                if (std::isnan(all[b].koi_period)) return !std::isnan(all[a].koi_period);
+                return all[a].koi_period < all[b].koi_period;
+            });
+
+            SystemSummary& summary = systems[g];
+            summary.kepid = kepids[g];
+            summary.multiplicity = rows.size();
+            summary.totalDepth = 0.0;
+            for (size_t i = 0; i < rows.size(); ++i) {
+                const auto& planet = planets[rows[i]];
+                if (!std::isnan(planet.koi_depth)) summary.totalDepth += planet.koi_depth;
+                if (i > 0) {
+                    double ratio = planet.koi_period / planets[rows[i - 1]].koi_period;
+                    if (!std::isnan(ratio)) summary.periodRatios.push_back(ratio);
+                }
+            }
+        }
+    });
+
+    // Richest systems first
+    algo::quick_sort(systems.begin(), systems.end(), [](const SystemSummary& a, const SystemSummary& b) {
+        if (a.multiplicity != b.multiplicity) return a.multiplicity > b.multiplicity;
+        return a.kepid < b.kepid;
+    });
+    return systems;
+}
+
+void ExoplanetCatalog::printSystemAnalysis() const {
+    auto systems = analyzeSystems();
+
+    size_t histogram[8] = {};
+    for (const auto& system : systems) {
+        histogram[system.multiplicity < 7 ? system.multiplicity : 7]++;
+    }
+
+    std::cout << "\nPlanetary Systems: " << systems.size() << " host stars\n";
+    std::cout << "-------------------------\n";
+    for (size_t m = 1; m < 8; ++m) {
+        if (histogram[m] == 0) continue;
+        std::cout << std::setw(10) << (m < 7 ? std::to_string(m) : std::string("7+"))
+                  << " planets: " << histogram[m] << " systems\n";
+    }
+
+    std::cout << "\nMost populated systems:\n"
+              << std::setw(12) << "kepid" << std::setw(10) << "planets"
+              << std::setw(18) << "total depth" << "  period ratios\n";
+    for (size_t i = 0; i < systems.size() && i < 20 && systems[i].multiplicity > 1; ++i) {
+        const auto& system = systems[i];
+        std::cout << std::setw(12) << system.kepid
+                  << std::setw(10) << system.multiplicity
+                  << std::setw(14) << system.totalDepth << " ppm ";
+        for (size_t r = 0; r < system.periodRatios.size(); ++r) {
+            std::cout << " " << system.periodRatios[r];
+        }
+        std::cout << "\n";
+    }
+}
+
+size_t ExoplanetCatalog::joinStellarData(const std::string& filename) {
+    EXO_PHASE("catalog.join_stellar");
+    const Column attachable[] = {Column::Steff, Column::Slogg, Column::Srad};
+    DynamicArray<std::string> wanted;
+    for (Column column : attachable) wanted.push_back(columnInfo(column).name);
+
+    StellarTable table;
+    if (!FileIO::parseStellarCSV(filename, wanted, table)) {
+        throw std::runtime_error("Failed to load stellar data from " + filename);
+    }
+
+    size_t width = table.columns.size();
+    DynamicArray<double Exoplanet::*> fields;
+    ColumnMask columns = 0;
+    for (const auto& name : table.columns) {
+        for (Column column : attachable) {
+            if (name == columnInfo(column).name) {
+                fields.push_back(columnInfo(column).field);
+                columns |= columnBit(column);
+            }
+        }
+    }
+    // Decode lazy columns now so they cannot later overwrite joined values
+    requireColumns(columns);
+
+    // Radix-partitioned hash join: rows are split by a hash of kepid, and
+    // each partition's table is built by one worker without locking
+    size_t partitions = algo::worker_count();
+    DynamicArray<DynamicArray<size_t>> partitionRows(partitions);
+    for (size_t r = 0; r < table.kepids.size(); ++r) {
+        partitionRows[joinPartition(table.kepids[r], partitions)].push_back(r);
+    }
+
+    using PartitionTable = HashTable<int, size_t, ArenaAllocator>;
+    std::unique_ptr<PartitionTable[]> tables(new PartitionTable[partitions]);
+    algo::parallel_for(partitions, 1, [&](size_t begin, size_t end) {
+        for (size_t p = begin; p < end; ++p) {
+            tables[p].reserve(partitionRows[p].size());
+            for (size_t r : partitionRows[p]) tables[p].insert(table.kepids[r], r);
+        }
+    });
+
+    // Probe: every planet writes only its own row
+    std::atomic<size_t> matched(0);
+    algo::parallel_for(planets.size(), kJoinGrain, [&](size_t begin, size_t end) {
+        size_t local = 0;
+        for (size_t i = begin; i < end; ++i) {
+            Exoplanet& planet = planets[i];
+            const size_t* row = tables[joinPartition(planet.kepid, partitions)].find(planet.kepid);
+            if (!row) continue;
+            for (size_t c = 0; c < width; ++c) {
+                double value = table.values[*row * width + c];
+                if (!std::isnan(value)) planet.*fields[c] = value;
+            }
+            ++local;
+        }
+        matched += local;
+    });
+
+    ++version;
+    return matched;
+}
+
+const DynamicArray<uint64_t>& ExoplanetCatalog::getRowHashes() const {
+    requireAllColumns();
+    if (rowHashVersion != version) {
+        EXO_PHASE("catalog.row_hashes");
+        rowHashes = DynamicArray<uint64_t>(planets.size());
+        algo::parallel_for(planets.size(), kRowHashGrain, [this](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) rowHashes[i] = rowHash(planets[i]);
         });
+        rowHashVersion = version;
+    }
+    return rowHashes;
+}
+
+ExoplanetCatalog::CatalogDiff ExoplanetCatalog::diff(const ExoplanetCatalog& newer) const {
+    EXO_PHASE("catalog.diff");
+    const DynamicArray<uint64_t>& oldHashes = getRowHashes();
+    const DynamicArray<uint64_t>& newHashes = newer.getRowHashes();
+    const DynamicArray<Exoplanet>& after = newer.planets;
+
+    // Partitioned by a hash of the name, as in joinStellarData, so each
+    // partition pairs up its names on one worker without locking
+    size_t partitions = algo::worker_count();
+    DynamicArray<DynamicArray<size_t>> oldRows(partitions), newRows(partitions);
+    for (size_t r = 0; r < planets.size(); ++r) {
+        oldRows[namePartition(planets[r].kepoi_name, partitions)].push_back(r);
+    }
+    for (size_t r = 0; r < after.size(); ++r) {
+        newRows[namePartition(after[r].kepoi_name, partitions)].push_back(r);
+    }
+
+    DynamicArray<CatalogDiff> parts(partitions);
+    algo::parallel_for(partitions, 1, [&](size_t begin, size_t end) {
+        for (size_t p = begin; p < end; ++p) {
+            // Name -> its last row, on each side
+            HashTable<std::string, size_t, ArenaAllocator> before, latest;
+            before.reserve(oldRows[p].size());
+            latest.reserve(newRows[p].size());
+            for (size_t r : oldRows[p]) before.insert(planets[r].kepoi_name, r);
+            for (size_t r : newRows[p]) latest.insert(after[r].kepoi_name, r);
+
+            CatalogDiff& part = parts[p];
+            for (size_t r : newRows[p]) {
+                const std::string& name = after[r].kepoi_name;
+                if (*latest.find(name) != r) continue;
+                const size_t* old = before.find(name);
+                if (!old) {
+                    part.added.push_back(r);
+                    continue;
+                }
+                // Equal hashes settle most rows without touching the fields
+                ColumnMask changed = oldHashes[*old] == newHashes[r] ? 0 : changedColumns(planets[*old], after[r]);
+                if (changed) part.changed.push_back({*old, r, changed});
+                else ++part.unchanged;
+            }
+            for (size_t r : oldRows[p]) {
+                const std::string& name = planets[r].kepoi_name;
+                if (*before.find(name) == r && !latest.contains(name)) part.removed.push_back(r);
+            }
+        }
+    });
+
+    CatalogDiff result;
+    for (const auto& part : parts) {
+        for (size_t r : part.added) result.added.push_back(r);
+        for (size_t r : part.removed) result.removed.push_back(r);
+        for (const auto& change : part.changed) result.changed.push_back(change);
+        result.unchanged += part.unchanged;
+    }
+    algo::quick_sort(result.added.begin(), result.added.end());
+    algo::quick_sort(result.removed.begin(), result.removed.end());
+    algo::quick_sort(result.changed.begin(), result.changed.end(),
+                     [](const RowChange& a, const RowChange& b) { return a.newRow < b.newRow; });
+    EXO_STATS_COUNT("catalog.diff_changed_rows", result.changed.size());
+    return result;
+}
+
+ExoplanetCatalog::MergeSummary ExoplanetCatalog::merge(const ExoplanetCatalog& incoming,
+                                                       MergePrecedence precedence, bool dropMissing) {
+    return mergeRows(incoming, nullptr, precedence, dropMissing);
+}
+
+ExoplanetCatalog::MergeSummary ExoplanetCatalog::merge(ExoplanetCatalog&& incoming,
+                                                       MergePrecedence precedence, bool dropMissing) {
+    MergeSummary summary = mergeRows(incoming, &incoming.planets, precedence, dropMissing);
+    incoming.planets = DynamicArray<Exoplanet>();
+    incoming.reordered();
+    return summary;
+}
+
+ExoplanetCatalog::MergeSummary ExoplanetCatalog::mergeRows(const ExoplanetCatalog& incoming,
+                                                           DynamicArray<Exoplanet>* taken,
+                                                           MergePrecedence precedence, bool dropMissing) {
+    EXO_PHASE("catalog.merge");
+    CatalogDiff delta = diff(incoming);
+    const DynamicArray<Exoplanet>& theirs = incoming.planets;
+
+    // Appended rows are numbered past every rowid held before the merge,
+    // dropped rows included, so no id is reused
+    int lastRowid = 0;
+    for (const auto& planet : planets) {
+        if (planet.rowid > lastRowid) lastRowid = planet.rowid;
+    }
+
+    MergeSummary summary = {delta.added.size(), 0, 0, delta.unchanged};
+    for (const auto& change : delta.changed) {
+        Exoplanet& ours = planets[change.oldRow];
+        const Exoplanet& other = theirs[change.newRow];
+        bool updated = false;
+        if (precedence == MergePrecedence::Incoming) {
+            int rowid = ours.rowid;
+            if (taken) ours = std::move((*taken)[change.newRow]);
+            else ours = other;
+            ours.rowid = rowid;
+            updated = true;
+        } else if (precedence == MergePrecedence::FillMissing) {
+            for (size_t c = 1; c < static_cast<size_t>(Column::Count); ++c) {
+                Column column = static_cast<Column>(c);
+                if ((change.changed & columnBit(column)) && isMissing(ours, column) &&
+                    !isMissing(other, column)) {
+                    copyColumn(ours, other, column);
+                    updated = true;
+                }
+            }
+        }
+        if (updated) ++summary.updated;
+        else ++summary.unchanged;
+    }
+
+    if (dropMissing && !delta.removed.empty()) {
+        // Every row of a removed name goes, not just the last
+        HashTable<std::string, bool, ArenaAllocator> gone;
+        gone.reserve(delta.removed.size());
+        for (size_t r : delta.removed) gone.insert(planets[r].kepoi_name, true);
+        DynamicArray<Exoplanet> kept;
+        for (size_t r = 0; r < planets.size(); ++r) {
+            if (gone.contains(planets[r].kepoi_name)) ++summary.removed;
+            else kept.push_back(std::move(planets[r]));
+        }
+        planets = std::move(kept);
+    }
+    for (size_t r : delta.added) {
+        if (taken) planets.push_back(std::move((*taken)[r]));
+        else planets.push_back(theirs[r]);
+        planets.back().rowid = ++lastRowid;
+    }
+
+    if (summary.added || summary.updated || summary.removed) reordered();
+    return summary;
 }
 
 double calculateMin(const DynamicArray<double>& data) {
@@ -119,58 +1397,132 @@ double calculateMedian(DynamicArray<double>& data) {
 }
 
 HashTable<std::string, int> ExoplanetCatalog::analyzePlanetTypes() const {
+    EXO_PHASE("query.type_distribution");
+    static const char* const radiusClasses[] = {
+        "Sub-Earth", "Earth-like", "Super-Earth", "Mini-Neptune", "Gas Giant"};
+    static const char* const tempClasses[] = {
+        " (Frozen)", " (Temperate)", " (Warm)", " (Hot)", " (Scorching)"};
+    using Counts = std::array<int, 25>; // radius class * 5 + temperature class
+
+    // Count per chunk in parallel, then merge
+    Counts zero = {};
+    Counts counts = algo::parallel_reduce(planets.size(), kScanGrain, zero,
+        [this](size_t begin, size_t end) {
+            Counts local = {};
+            for (size_t i = begin; i < end; ++i) {
+                const auto& planet = planets[i];
+                if (std::isnan(planet.koi_prad) || std::isnan(planet.koi_teq)) continue;
+
+                double radius = planet.koi_prad;
+                double temp = planet.koi_teq;
+
+                // Radius classification
+                int r;
+                if (radius < 1.0) r = 0;
+                else if (radius < 1.5) r = 1;
+                else if (radius < 2.0) r = 2;
+                else if (radius < 6.0) r = 3;
+                else r = 4;
+
+                // Temperature classification
+                int t;
+                if (temp < 200) t = 0;
+                else if (temp < 300) t = 1;
+                else if (temp < 500) t = 2;
+                else if (temp < 1000) t = 3;
+                else t = 4;
+
+                local[r * 5 + t]++;
+            }
+            return local;
+        },
+        [](const Counts& a, const Counts& b) {
+            Counts sum;
+            for (size_t i = 0; i < sum.size(); ++i) sum[i] = a[i] + b[i];
+            return sum;
+        });
+
     HashTable<std::string, int> typeCounts(17); // Prime number for better distribution
-    
-    for (const auto& planet : planets) {
-        if (std::isnan(planet.koi_prad) || std::isnan(planet.koi_teq)) continue;
-        
-        std::string type;
-        double radius = planet.koi_prad;
-        double temp = planet.koi_teq;
-        
-        // Radius classification
-        if (radius < 1.0) type = "Sub-Earth";
-        else if (radius < 1.5) type = "Earth-like";
-        else if (radius < 2.0) type = "Super-Earth";
-        else if (radius < 6.0) type = "Mini-Neptune";
-        else type = "Gas Giant";
-        
-        // Temperature classification
-        if (temp < 200) type += " (Frozen)";
-        else if (temp < 300) type += " (Temperate)";
-        else if (temp < 500) type += " (Warm)";
-        else if (temp < 1000) type += " (Hot)";
-        else type += " (Scorching)";
-        
-        // Count using HashTable
-        if (typeCounts.contains(type)) {
-            typeCounts[type]++;
-        } else {
-            typeCounts.insert(type, 1);
+    for (size_t i = 0; i < counts.size(); ++i) {
+        if (counts[i] > 0) {
+            typeCounts.insert(std::string(radiusClasses[i / 5]) + tempClasses[i % 5], counts[i]);
         }
     }
-    
     return typeCounts;
 }
 
+void ExoplanetCatalog::warmCaches() const {
+    EXO_PHASE("catalog.warm_caches");
+    requireAllColumns();
+    getDerivedColumn(DerivedColumn::Gravity);
+    if (compactMode) compactColumn("radius");
+    buildNameTrie();
+    buildSystemIndex();
+    buildSkyIndex();
+    buildSimilarityIndex();
+    transitEphemeris();
+}
+
+void ExoplanetCatalog::setResultCacheLimit(size_t bytes) {
+    std::lock_guard<std::mutex> lock(resultLock);
+    results.setCapacity(bytes);
+}
+
+ExoplanetCatalog::ResultCacheStats ExoplanetCatalog::resultCacheStats() const {
+    std::lock_guard<std::mutex> lock(resultLock);
+    return ResultCacheStats{results.hits(), results.misses(), results.evictions(),
+                            results.size(), results.cost(), results.capacity()};
+}
+
+ExoplanetCatalog::GroupList ExoplanetCatalog::countBy(const std::string& key) const {
+    auto cached = cachedResult("group|" + key, [&] {
+        CachedResult result;
+        result.groups = countGroups(key);
+        return result;
+    });
+    return GroupList(cached, &cached->groups);
+}
+
+DynamicArray<std::pair<std::string, int>> ExoplanetCatalog::countGroups(const std::string& key) const {
+    EXO_PHASE("query.count_by");
+    HashTable<std::string, int> counts = key == "type" ? analyzePlanetTypes() : HashTable<std::string, int>(17);
+    if (key == "disposition") {
+        for (const auto& planet : planets) {
+            int* count = counts.find(planet.koi_disposition);
+            if (count) ++*count;
+            else counts.insert(planet.koi_disposition, 1);
+        }
+    } else if (key == "multiplicity") {
+        buildSystemIndex();
+        for (const auto& planet : planets) {
+            std::string size = std::to_string(systemIndex.find(planet.kepid)->size());
+            int* count = counts.find(size);
+            if (count) ++*count;
+            else counts.insert(size, 1);
+        }
+    } else if (key != "type") {
+        throw std::invalid_argument("Unknown grouping: " + key);
+    }
+
+    DynamicArray<std::pair<std::string, int>> groups;
+    for (size_t b = 0; b < counts.bucketCount(); ++b) {
+        for (auto* entry = counts.getBucket(b); entry; entry = entry->next) {
+            groups.push_back(std::make_pair(entry->key, entry->value));
+        }
+    }
+    algo::quick_sort(groups.begin(), groups.end(),
+                     [](const std::pair<std::string, int>& a, const std::pair<std::string, int>& b) {
+                         return a.first < b.first;
+                     });
+    return groups;
+}
+
 void ExoplanetCatalog::printPlanetTypeAnalysis() const {
-    auto typeCounts = analyzePlanetTypes();
+    DynamicArray<std::pair<std::string, int>> sortedTypes = *countBy("type");
     
     std::cout << "\nPlanet Type Distribution:\n";
     std::cout << "-------------------------\n";
     
-    // Create a DynamicArray to store and sort the types
-    DynamicArray<std::pair<std::string, int>> sortedTypes;
-    
-    // Collect all types
-    for (size_t i = 0; i < typeCounts.bucketCount(); ++i) {
-        auto* entry = typeCounts.getBucket(i);
-        while (entry) {
-            sortedTypes.push_back(std::make_pair(entry->key, entry->value));
-            entry = entry->next;
-        }
-    }
-    
     // Sort by count (descending) using your quick_sort
     algo::quick_sort(sortedTypes.begin(), sortedTypes.end(),
         [](const auto& a, const auto& b) { return b.second < a.second; });
@@ -185,16 +1537,26 @@ void ExoplanetCatalog::printPlanetTypeAnalysis() const {
 
 DynamicArray<Exoplanet> ExoplanetCatalog::findHabitablePlanets() const {
     DynamicArray<Exoplanet> habitable;
+    RowList rows = habitableRows();
+    for (size_t row : *rows) habitable.push_back(planets[row]);
+    return habitable;
+}
 
-    for (const auto& planet : planets) {
-        if (planet.koi_disposition == "CONFIRMED" &&
-            planet.koi_prad >= 0.8 && planet.koi_prad <= 1.5 &&
-            planet.koi_teq >= 200 && planet.koi_teq <= 300) {
-            habitable.push_back(planet);
+ExoplanetCatalog::RowList ExoplanetCatalog::habitableRows() const {
+    auto cached = cachedResult("habitable", [this] {
+        EXO_PHASE("query.habitable");
+        CachedResult result;
+        for (size_t i = 0; i < planets.size(); ++i) {
+            const auto& planet = planets[i];
+            if (planet.koi_disposition == "CONFIRMED" &&
+                planet.koi_prad >= 0.8 && planet.koi_prad <= 1.5 &&
+                planet.koi_teq >= 200 && planet.koi_teq <= 300) {
+                result.rows.push_back(i);
+            }
         }
-    }
-
-    return habitable;
+        return result;
+    });
+    return RowList(cached, &cached->rows);
 }
 
 void ExoplanetCatalog::printHabitablePlanets() const {
@@ -224,50 +1586,26 @@ bool PlanetComparator::operator()(const Exoplanet& a, const Exoplanet& b) const
     return false;
 }
 
-void ExoplanetCatalog::findTopExtremes(size_t n, const std::string& property, bool findMax) {
-    // Define comparator as lambda
-    auto compare = [property, findMax](const Exoplanet& a, const Exoplanet& b) {
-        double a_val = 0, b_val = 0;
-        
-        if (property == "radius") {
-            a_val = a.koi_prad;
-            b_val = b.koi_prad;
-        }
-        else if (property == "temperature") {
-            a_val = a.koi_teq;
-            b_val = b.koi_teq;
-        }
-        else if (property == "period") {
-            a_val = a.koi_period;
-            b_val = b.koi_period;
-        }
-        else if (property == "insolation") {
-            a_val = a.koi_insol;
-            b_val = b.koi_insol;
-        }
-        
-        return findMax ? (a_val < b_val) : (a_val > b_val);
-    };
+ExoplanetCatalog::RowList ExoplanetCatalog::topExtremes(size_t n, const std::string& property,
+                                                        bool findMax) const {
+    std::string key = "top|" + property + "|" + std::to_string(n) + (findMax ? "|max" : "|min");
+    auto cached = cachedResult(key, [&] {
+        CachedResult result;
+        result.rows = selectExtremes(n, property, findMax);
+        return result;
+    });
+    return RowList(cached, &cached->rows);
+}
 
-    // Create heap with the comparator
-    MaxHeap<Exoplanet, decltype(compare)> heap(compare);
-    
-    // Filter and add to heap
-    for (size_t i = 0; i < planets.size(); ++i) {
-        const auto& planet = planets[i];
-        if (property == "radius" && !std::isnan(planet.koi_prad)) {
-            heap.push(planet);
-        }
-        else if (property == "temperature" && !std::isnan(planet.koi_teq)) {
-            heap.push(planet);
-        }
-        else if (property == "period" && !std::isnan(planet.koi_period)) {
-            heap.push(planet);
-        }
-        else if (property == "insolation" && !std::isnan(planet.koi_insol)) {
-            heap.push(planet);
-        }
-    }
+DynamicArray<size_t> ExoplanetCatalog::selectExtremes(size_t n, const std::string& property,
+                                                      bool findMax) const {
+    EXO_PHASE("query.top_extremes");
+    if (const CompactColumn* column = compactColumn(property)) return topRows(*column, n, findMax);
+    return topRows(propertyValues(property), n, findMax);
+}
+
+void ExoplanetCatalog::findTopExtremes(size_t n, const std::string& property, bool findMax) {
+    RowList rows = topExtremes(n, property, findMax);
 
     // Display results
     std::cout << "\nTop " << n << " " << (findMax ? "maximum" : "minimum") 
@@ -276,18 +1614,11 @@ void ExoplanetCatalog::findTopExtremes(size_t n, const std::string& property, bo
               << std::setw(15) << property 
               << std::setw(15) << "Temp (K)" << "\n";
     
-    for (size_t i = 0; i < n && !heap.empty(); ++i) {
-        const auto& planet = heap.top();
+    for (size_t i = 0; i < rows->size(); ++i) {
+        const auto& planet = planets[(*rows)[i]];
         std::cout << std::setw(25) << planet.kepoi_name
-                  << std::setw(15);
-        
-        if (property == "radius") std::cout << planet.koi_prad;
-        else if (property == "temperature") std::cout << planet.koi_teq;
-        else if (property == "period") std::cout << planet.koi_period;
-        else if (property == "insolation") std::cout << planet.koi_insol;
-        
-        std::cout << std::setw(15) << planet.koi_teq << "\n";
-        heap.pop();
+                  << std::setw(15) << propertyValue(property, (*rows)[i])
+                  << std::setw(15) << planet.koi_teq << "\n";
     }
 }
 
@@ -297,7 +1628,7 @@ void ExoplanetCatalog::printGravityAndWeightForPlanet(const Exoplanet& planet) c
         return;
     }
 
-    double gravity = std::pow(planet.koi_prad, 1.7); // relative to Earth
+    double gravity = std::pow(planet.koi_prad, kGravityExponent); // relative to Earth
     double userWeight;
     std::cout << "Enter your Earth weight (kg): ";
     std::cin >> userWeight;
@@ -317,7 +1648,7 @@ void ExoplanetCatalog::printEscapeVelocityForPlanet(const Exoplanet& planet) con
         return;
     }
 
-    double escapeVelocity = 11.2 * std::pow(planet.koi_prad, 1.35);
+    double escapeVelocity = kEarthEscapeVelocity * std::pow(planet.koi_prad, kEscapeVelocityExponent);
 
     std::cout << "\n=== Escape Velocity Info ===\n"
               << "Planet: " << planet.kepoi_name << "\n"
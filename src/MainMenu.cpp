@@ -1,44 +1,169 @@
 #include "MainMenu.hpp"
+#include "../include/QueryServer.hpp"
 #include <iostream>
 #include <limits>
 #include <algorithm>
 #include <cmath>
 #include <iomanip>
 #include <filesystem>
+#include <sstream>
+#include <chrono>
 
 namespace fs = std::filesystem;
 
-MainMenu::MainMenu() {
+MainMenu::MainMenu(const MenuOptions& options)
+    : dataFile(options.dataFile), dataReady(dataLoaded.get_future().share()),
+      namesReady(namesIndexed.get_future().share()), allReady(allIndexed.get_future().share()) {
+    catalog.setResultCacheLimit(options.resultCacheBytes);
+    catalog.setCompactMode(options.compactMode);
+    catalog.setParsePolicy(options.parsePolicy);
+    loader = std::thread([this, options] { load(options); });
+}
+
+MainMenu::~MainMenu() {
+    if (loader.joinable()) loader.join();
+}
+
+void MainMenu::load(const MenuOptions& options) {
+    std::promise<void>* stages[] = {&dataLoaded, &namesIndexed, &allIndexed};
+    size_t done = 0;
     try {
-        catalog.loadData(dataFile);
+        catalog.loadData(dataFile, options.lazyLoad ? ExoplanetCatalog::LoadMode::Lazy
+                                                    : ExoplanetCatalog::LoadMode::Eager, &progress);
+        for (const auto& file : options.mergeFiles) {
+            // Same limits, but the quarantine file belongs to the main load
+            ExoplanetCatalog release;
+            ParsePolicy policy = options.parsePolicy;
+            policy.quarantineFile.clear();
+            release.setParsePolicy(policy);
+            release.loadData(file);
+            ExoplanetCatalog::MergeSummary merged =
+                catalog.merge(std::move(release), options.mergePrecedence, options.dropMissing);
+            notice("Merged " + file + ": " + std::to_string(merged.added) + " added, " +
+                   std::to_string(merged.updated) + " updated, " + std::to_string(merged.removed) +
+                   " removed, " + std::to_string(merged.unchanged) + " unchanged");
+        }
+        if (!options.stellarFile.empty()) {
+            size_t matched = catalog.joinStellarData(options.stellarFile);
+            notice("Joined " + options.stellarFile + " onto " + std::to_string(matched) + " planets");
+        }
+        notice("Successfully loaded " + dataFile);
+        stages[done++]->set_value();
+
+        // A mapped name index answers lookups before the other indices exist
+        std::string nameIndex = ExoplanetCatalog::nameIndexPath(dataFile);
+        if (catalog.useNameIndex(nameIndex)) {
+            notice("Using name index " + nameIndex);
+            stages[done++]->set_value();
+        }
         catalog.buildIndices();
-        std::cout << "Successfully loaded " << dataFile << "\n";
+        while (done < 3) stages[done++]->set_value();
+    } catch (...) {
+        while (done < 3) stages[done++]->set_exception(std::current_exception());
+    }
+}
+
+void MainMenu::notice(const std::string& message) {
+    std::lock_guard<std::mutex> guard(noticeLock);
+    notices += message + "\n";
+}
+
+void MainMenu::showNotices() {
+    std::lock_guard<std::mutex> guard(noticeLock);
+    std::cout << notices;
+    notices.clear();
+}
+
+std::string MainMenu::loadStatus() const {
+    auto isReady = [](const std::shared_future<void>& f) {
+        return f.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    };
+    if (isReady(allReady)) return "";
+    if (isReady(dataReady)) return "Building indices...";
+    uint64_t total = progress.totalBytes;
+    if (total == 0) return "Opening " + dataFile + "...";
+    std::ostringstream status;
+    status << "Loading " << dataFile << ": " << 100 * progress.readBytes / total << "% read, "
+           << 100 * progress.parsedBytes / total << "% parsed";
+    return status.str();
+}
+
+bool MainMenu::waitFor(const std::shared_future<void>& ready, const char* what) {
+    if (ready.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        std::cout << "Waiting for " << what << "..." << std::endl;
+        std::string shown;
+        while (ready.wait_for(std::chrono::milliseconds(250)) != std::future_status::ready) {
+            std::string status = loadStatus();
+            if (status != shown) std::cout << "  " << status << std::endl;
+            shown = status;
+        }
+    }
+    try {
+        ready.get();
+        return true;
     } catch (const std::exception& e) {
+        if (loader.joinable()) loader.join(); // it finished when it passed the error on
         std::cerr << "Fatal Error: " << e.what() << "\n";
-        exit(EXIT_FAILURE);
+        return false;
     }
 }
 
-void MainMenu::displayMainMenu() {
-    std::cout << "\n==== Exoplanet Catalog ====\n"
+bool MainMenu::serve(const std::string& socketPath) {
+    if (!waitFor(allReady, "the catalog")) return false;
+    showNotices();
+    catalog.warmCaches();
+    return QueryServer(catalog).run(socketPath);
+}
+
+bool MainMenu::runBatch(const QueryBatch& batch) {
+    if (!waitFor(allReady, "the catalog")) return false;
+    showNotices();
+    catalog.warmCaches();
+    return batch.run(catalog);
+}
+
+bool MainMenu::displayMainMenu() {
+    showNotices();
+    // A failed load is reported as soon as it is known
+    for (const auto* stage : {&dataReady, &allReady}) {
+        if (stage->wait_for(std::chrono::seconds(0)) == std::future_status::ready && !waitFor(*stage, "")) {
+            return false;
+        }
+    }
+
+    std::string status = loadStatus();
+    std::cout << "\n==== Exoplanet Catalog ====\n";
+    if (!status.empty()) std::cout << "(" << status << ")\n";
+    std::cout
               << "1. Sort and Export Data\n"
               << "2. Find Extreme Planets\n"
               << "3. Display All Planets\n"
               << "4. Search Planet\n"
               << "5. Show Habitable Planets\n"
               << "6. Show Planet Type Distribution\n"
-              << "7. Exit\n"
+              << "7. Search by Sky Position\n"
+              << "8. Show Multi-Planet Systems\n"
+              << "9. Exit\n"
               << "=========================\n"
               << "Enter choice: ";
+    return true;
 }
 
-void MainMenu::run() {
+bool MainMenu::run() {
     int choice;
     do {
-        displayMainMenu();
+        if (!displayMainMenu()) return false;
         std::cin >> choice;
         std::cin.ignore();
 
+        // Sorting reorders the catalog, so it waits for every index; name
+        // search waits for the name index; the rest only need the rows
+        bool ready = true;
+        if (choice == 1) ready = waitFor(allReady, "indices");
+        else if (choice == 4) ready = waitFor(namesReady, "the name index");
+        else if (choice >= 2 && choice <= 8) ready = waitFor(dataReady, "the catalog");
+        if (!ready) return false;
+
         switch(choice) {
             case 1: sortSubMenu(); break;
             case 2: extremeFinderSubMenu(); break;
@@ -46,10 +171,13 @@ void MainMenu::run() {
             case 4: searchPlanet(); break;
             case 5: displayHabitablePlanets(); break;
             case 6: catalog.printPlanetTypeAnalysis(); break;
-            case 7: break; // Exit
+            case 7: skySearchSubMenu(); break;
+            case 8: catalog.printSystemAnalysis(); break;
+            case 9: break; // Exit
             default: std::cout << "Invalid choice\n";
         }
-    } while (choice != 7);
+    } while (choice != 9);
+    return true;
 }
 
 void MainMenu::sortSubMenu() {
@@ -59,7 +187,8 @@ void MainMenu::sortSubMenu() {
                   << "1. By Period (saves to CSV)\n"
                   << "2. By Radius (saves to CSV)\n"
                   << "3. By Temperature (saves to CSV)\n"
-                  << "4. Back\n"
+                  << "4. By Earth Similarity Index (saves to CSV)\n"
+                  << "5. Back\n"
                   << "======================\n"
                   << "Enter choice: ";
 
@@ -81,8 +210,13 @@ void MainMenu::sortSubMenu() {
                 catalog.saveResults("sorted_by_temp.csv");
                 std::cout << "Saved to sorted_by_temp.csv\n";
                 break;
+            case 4:
+                catalog.sortByProperty("esi");
+                catalog.saveResults("sorted_by_esi.csv");
+                std::cout << "Saved to sorted_by_esi.csv\n";
+                break;
         }
-    } while (choice != 4);
+    } while (choice != 5);
 }
 
 void MainMenu::searchPlanet() {
@@ -91,39 +225,169 @@ void MainMenu::searchPlanet() {
     std::getline(std::cin, name);
 
     Exoplanet* planet = catalog.findPlanetByName(name);
+    if (!planet) planet = choosePlanet(name);
+    if (!planet) return;
 
-    if (planet) {
-        std::cout << "\n=== Planet Found ===\n"
-                  << "KOI Name: " << planet->kepoi_name << "\n"
-                  << "Kepler Name: " << (planet->kepler_name.empty() ? "N/A" : planet->kepler_name) << "\n"
-                  << "Period: " << planet->koi_period << " days\n"
-                  << "Radius: " << planet->koi_prad << " Earth radii\n"
-                  << "Temp: " << planet->koi_teq << " K\n"
-                  << "Status: " << planet->koi_disposition << "\n";
-
-        int choice;
-        do {
-            std::cout << "\n1. Check your weight on this planet\n"
-                      << "2. Check escape velocity\n"
-                      << "3. Back to main menu\n"
-                      << "Enter choice: ";
-            std::cin >> choice;
-            std::cin.ignore();
-
-            if (choice == 1) {
-                catalog.printGravityAndWeightForPlanet(*planet);
-            } else if (choice == 2) {
-                catalog.printEscapeVelocityForPlanet(*planet);
-            } else if (choice != 3) {
-                std::cout << "Invalid choice\n";
-            }
-        } while (choice != 3);
-    } else {
-        std::cout << "Planet not found. Try exact KOI name (e.g., K00752.02)\n";
+    std::cout << "\n=== Planet Found ===\n"
+              << "KOI Name: " << planet->kepoi_name << "\n"
+              << "Kepler Name: " << (planet->kepler_name.empty() ? "N/A" : planet->kepler_name) << "\n"
+              << "Period: " << planet->koi_period << " days\n"
+              << "Radius: " << planet->koi_prad << " Earth radii\n"
+              << "Temp: " << planet->koi_teq << " K\n"
+              << "Status: " << planet->koi_disposition << "\n";
+
+    int choice;
+    do {
+        std::cout << "\n1. Check your weight on this planet\n"
+                  << "2. Check escape velocity\n"
+                  << "3. Find similar planets\n"
+                  << "4. Back to main menu\n"
+                  << "Enter choice: ";
+        std::cin >> choice;
+        std::cin.ignore();
+
+        if (choice == 1) {
+            catalog.printGravityAndWeightForPlanet(*planet);
+        } else if (choice == 2) {
+            catalog.printEscapeVelocityForPlanet(*planet);
+        } else if (choice == 3) {
+            findSimilarPlanets(*planet);
+        } else if (choice != 4) {
+            std::cout << "Invalid choice\n";
+        }
+    } while (choice != 4);
+}
+
+// No exact match: offer names starting with the input, or failing that,
+// names within a couple of typos of it
+Exoplanet* MainMenu::choosePlanet(const std::string& name) {
+    const size_t kMaxCandidates = 10;
+    DynamicArray<ExoplanetCatalog::NameMatch> candidates;
+    if (!name.empty()) {
+        candidates = catalog.findPlanetsByPrefix(name, kMaxCandidates);
+        if (candidates.empty()) {
+            unsigned maxDistance = name.size() <= 4 ? 1 : 2;
+            candidates = catalog.findPlanetsByFuzzyName(name, maxDistance, kMaxCandidates);
+        }
+    }
+    if (candidates.empty()) {
+        std::cout << "Planet not found. Try a KOI name (e.g., K00752.02) or Kepler name (e.g., Kepler-22 b)\n";
+        return nullptr;
+    }
+
+    std::cout << "\nNo exact match. " << (candidates[0].distance == 0 ? "Names starting with" : "Did you mean")
+              << " \"" << name << "\":\n";
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        const Exoplanet& planet = *candidates[i].planet;
+        std::cout << std::setw(3) << i + 1 << ". " << std::setw(15) << planet.kepoi_name
+                  << std::setw(20) << (planet.kepler_name.empty() ? "-" : planet.kepler_name) << "\n";
+    }
+
+    std::string input;
+    std::cout << "Select a planet (blank to cancel): ";
+    std::getline(std::cin, input);
+    size_t choice = 0;
+    try {
+        choice = input.empty() ? 0 : std::stoul(input);
+    } catch (...) {
+        choice = 0;
+    }
+    if (choice == 0 || choice > candidates.size()) return nullptr;
+    return candidates[choice - 1].planet;
+}
+
+void MainMenu::findSimilarPlanets(const Exoplanet& planet) {
+    size_t k = 10;
+    std::string input;
+    std::cout << "How many similar planets (default 10)? ";
+    std::getline(std::cin, input);
+    if (!input.empty()) {
+        try {
+            k = std::stoul(input);
+        } catch (...) {
+            std::cout << "Invalid input, using default 10\n";
+        }
     }
+
+    // One weight per feature: radius, temperature, insolation, period
+    DynamicArray<double> weights;
+    std::cout << "Weights for radius, temperature, insolation, period (blank for equal): ";
+    std::getline(std::cin, input);
+    if (!input.empty()) {
+        std::stringstream ss(input);
+        double w;
+        while (ss >> w) weights.push_back(w);
+        if (weights.size() != 4) {
+            std::cout << "Expected 4 weights, using equal weights\n";
+            weights = DynamicArray<double>();
+        }
+    }
+
+    auto similar = catalog.findSimilarPlanets(planet, k, weights);
+    if (similar.empty()) {
+        std::cout << "Not enough data on this planet to compare it with others.\n";
+        return;
+    }
+
+    const auto& planets = catalog.getPlanets();
+    std::streamsize precision = std::cout.precision(4);
+    std::cout << "\n=== Planets similar to " << planet.kepoi_name << " ===\n";
+    for (const auto& neighbor : similar) {
+        const auto& other = planets[neighbor.value];
+        std::cout << std::setw(15) << other.kepoi_name
+                  << std::setw(20) << (other.kepler_name.empty() ? "-" : other.kepler_name)
+                  << "  d=" << neighbor.distance
+                  << "  R=" << other.koi_prad << "R⊕, "
+                  << "T=" << other.koi_teq << "K, "
+                  << "P=" << other.koi_period << "d\n";
+    }
+    std::cout.precision(precision);
 }
 
+void MainMenu::skySearchSubMenu() {
+    int choice;
+    do {
+        std::cout << "\n=== Search by Sky Position ===\n"
+                  << "1. Cone Search (ra, dec, radius)\n"
+                  << "2. Box Search (ra range, dec range)\n"
+                  << "3. Back\n"
+                  << "======================\n"
+                  << "Enter choice: ";
+        std::cin >> choice;
+
+        DynamicArray<size_t> rows;
+        auto start = std::chrono::steady_clock::now();
+        if (choice == 1) {
+            double ra, dec, radius;
+            std::cout << "Enter ra, dec and radius in degrees: ";
+            std::cin >> ra >> dec >> radius;
+            catalog.buildSkyIndex(); // keep the one-time build out of the timing
+            start = std::chrono::steady_clock::now();
+            rows = catalog.coneSearch(ra, dec, radius);
+        } else if (choice == 2) {
+            double raMin, raMax, decMin, decMax;
+            std::cout << "Enter ra min, ra max, dec min and dec max in degrees: ";
+            std::cin >> raMin >> raMax >> decMin >> decMax;
+            catalog.buildSkyIndex();
+            start = std::chrono::steady_clock::now();
+            rows = catalog.boxSearch(raMin, raMax, decMin, decMax);
+        } else {
+            if (choice != 3) std::cout << "Invalid choice\n";
+            continue;
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
 
+        const auto& planets = catalog.getPlanets();
+        std::cout << "\n" << rows.size() << " planets found in " << ms << " ms\n";
+        for (size_t row : rows) {
+            const auto& planet = planets[row];
+            std::cout << std::setw(15) << planet.kepoi_name
+                      << std::setw(20) << (planet.kepler_name.empty() ? "-" : planet.kepler_name)
+                      << "  ra=" << planet.ra << "  dec=" << planet.dec << "\n";
+        }
+    } while (choice != 3);
+    std::cin.ignore();
+}
 
 void MainMenu::displayAllPlanets() {
     const auto& planets = catalog.getPlanets();
@@ -180,7 +444,10 @@ void MainMenu::extremeFinderSubMenu() {
                   << "6. Shortest Orbital Periods\n"
                   << "7. Highest Insolation\n"
                   << "8. Lowest Insolation\n"
-                  << "9. Back\n"
+                  << "9. Highest Surface Gravity\n"
+                  << "10. Highest Escape Velocity\n"
+                  << "11. Most Earth-like (ESI)\n"
+                  << "12. Back\n"
                   << "======================\n"
                   << "Enter choice: ";
         std::cin >> choice;
@@ -198,7 +465,10 @@ void MainMenu::extremeFinderSubMenu() {
             case 6: property = "period"; findMax = false; break;
             case 7: property = "insolation"; findMax = true; break;
             case 8: property = "insolation"; findMax = false; break;
-            case 9: return;
+            case 9: property = "gravity"; findMax = true; break;
+            case 10: property = "escape_velocity"; findMax = true; break;
+            case 11: property = "esi"; findMax = true; break;
+            case 12: return;
             default: 
                 std::cout << "Invalid choice\n";
                 continue;
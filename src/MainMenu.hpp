@@ -1,17 +1,56 @@
 #pragma once
 #include "../include/ExoplanetCatalog.hpp"
+#include "../include/QueryBatch.hpp"
+#include <future>
+#include <mutex>
 #include <string>
+#include <thread>
+
+struct MenuOptions {
+    std::string dataFile = "cumulative_cleaned1.csv"; // catalog loaded at startup
+    bool lazyLoad = false;   // defer decoding of rarely used columns
+    std::string stellarFile; // host-star table joined on kepid after loading
+    // Releases merged into the catalog after loading, in order
+    DynamicArray<std::string> mergeFiles;
+    ExoplanetCatalog::MergePrecedence mergePrecedence = ExoplanetCatalog::MergePrecedence::Incoming;
+    bool dropMissing = false; // drop planets a merged release lacks
+    size_t resultCacheBytes = ExoplanetCatalog::kDefaultResultCacheBytes;
+    bool compactMode = false; // scan compact copies of the hot columns
+    ParsePolicy parsePolicy;  // rejected rows: quarantine file and limits
+};
 
 class MainMenu {
 private:
     ExoplanetCatalog catalog;
-    const std::string dataFile = "cumulative_cleaned1.csv"; // Preloaded data file
-    
-    void displayMainMenu();
+    std::string dataFile; // Preloaded data file
+
+    // Startup runs on `loader` while the menu is up. Each stage fulfils its
+    // promise when done, or passes on the error that stopped the load.
+    LoadProgress progress;
+    std::promise<void> dataLoaded, namesIndexed, allIndexed;
+    std::shared_future<void> dataReady;  // rows in place: read-only queries
+    std::shared_future<void> namesReady; // name lookups
+    std::shared_future<void> allReady;   // every index; the catalog may change
+    std::thread loader;
+    std::mutex noticeLock;
+    std::string notices; // loader messages, shown with the next menu
+
+    void load(const MenuOptions& options);
+    void notice(const std::string& message);
+    void showNotices();
+    std::string loadStatus() const;
+    // Blocks until `ready`, reporting progress. If loading failed, reports
+    // the error, joins the loader and returns false.
+    bool waitFor(const std::shared_future<void>& ready, const char* what);
+
+    bool displayMainMenu(); // false if loading failed
     void sortSubMenu();
     void analyzeSubMenu();
     void visualizeSubMenu();
     void searchPlanet();
+    Exoplanet* choosePlanet(const std::string& name);
+    void findSimilarPlanets(const Exoplanet& planet);
+    void skySearchSubMenu();
     void displayAllPlanets();
     void findTopExtremes(); 
     void saveSortedData(const std::string& sortType);
@@ -20,6 +59,9 @@ private:
     void extremeFinderSubMenu();
     
     public:
-    MainMenu(); // Constructor to load data automatically
-    void run();
+    explicit MainMenu(const MenuOptions& options = MenuOptions()); // Starts loading data in the background
+    ~MainMenu();
+    bool run(); // false if loading failed
+    bool serve(const std::string& socketPath); // answer QueryServer requests instead of the menu
+    bool runBatch(const QueryBatch& batch);    // or write a batch of outputs
 };
\ No newline at end of file
@@ -0,0 +1,58 @@
+#include "../include/MappedFile.hpp"
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool MappedFile::open(const std::string& filename, bool populate) {
+    close();
+
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Error opening file: " << filename << std::endl;
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        std::cerr << "Error reading file size: " << filename << std::endl;
+        ::close(fd);
+        return false;
+    }
+
+    // Prefault the pages: every loader reads the file front to back, and
+    // taking one page fault at a time can cost more than the parse itself.
+    // Callers that read ahead with prefetch() on another thread skip it.
+    void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE | (populate ? MAP_POPULATE : 0), fd, 0);
+    ::close(fd); // the mapping keeps its own reference
+    if (addr == MAP_FAILED) {
+        std::cerr << "Error mapping file: " << filename << std::endl;
+        return false;
+    }
+
+    _data = static_cast<const char*>(addr);
+    _size = static_cast<size_t>(st.st_size);
+    return true;
+}
+
+void MappedFile::prefetch(size_t offset, size_t length) const {
+    if (offset >= _size) return;
+    if (length > _size - offset) length = _size - offset;
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t start = offset & ~(page - 1); // madvise wants an aligned address
+    madvise(const_cast<char*>(_data) + start, offset + length - start, MADV_WILLNEED);
+
+    const volatile char* p = _data;
+    char sink = 0;
+    for (size_t i = start; i < offset + length; i += page) sink ^= p[i];
+    (void)sink;
+}
+
+void MappedFile::close() {
+    if (_data) {
+        munmap(const_cast<char*>(_data), _size);
+        _data = nullptr;
+        _size = 0;
+    }
+}
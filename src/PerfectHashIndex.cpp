@@ -0,0 +1,266 @@
+#include "../include/PerfectHashIndex.hpp"
+#include "../include/Stats.hpp"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+struct PerfectHashIndex::Header {
+    char magic[8];
+    uint64_t sourceTag;   // identifies the data the rows refer to
+    uint64_t keyCount;    // = slots
+    uint64_t bucketCount;
+    uint64_t hashSeed;
+};
+
+namespace {
+    const char kMagic[8] = {'E', 'X', 'O', 'M', 'P', 'H', '1', '\n'};
+
+    // Average keys per bucket: smaller buckets place faster, larger ones
+    // need fewer seeds
+    const size_t kKeysPerBucket = 3;
+
+    // Seeds tried per bucket before starting over with a new hash seed
+    const uint32_t kMaxSeed = 1u << 24;
+
+    // A seed with this bit set is the slot of a single-key bucket
+    const uint32_t kDirect = 1u << 31;
+
+    uint64_t mix(uint64_t h) {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    uint64_t hashKey(const char* p, size_t n, uint64_t seed) {
+        uint64_t h = seed ^ (n * 0x9E3779B97F4A7C15ULL);
+        while (n >= 8) {
+            uint64_t word;
+            std::memcpy(&word, p, 8);
+            h = (h ^ word) * 0x9E3779B97F4A7C15ULL;
+            h ^= h >> 29;
+            p += 8;
+            n -= 8;
+        }
+        uint64_t tail = 0;
+        std::memcpy(&tail, p, n);
+        return mix(h ^ tail);
+    }
+
+    // Multiply-shift range reduction of 32 hash bits onto [0, range)
+    uint64_t reduce(uint64_t bits32, uint64_t range) {
+        return (bits32 * range) >> 32;
+    }
+
+    uint64_t bucketOf(uint64_t h, uint64_t buckets) { return reduce(h >> 32, buckets); }
+    uint32_t fingerprintOf(uint64_t h) { return static_cast<uint32_t>(h); }
+    uint64_t slotOf(uint64_t h, uint32_t seed, uint64_t slots) {
+        return reduce(mix(h ^ (seed * 0xD6E8FEB86659FD93ULL)) >> 32, slots);
+    }
+
+    size_t seedBytes(uint64_t buckets) { return (buckets * sizeof(uint32_t) + 7) & ~size_t(7); }
+}
+
+void PerfectHashIndex::build(const DynamicArray<std::pair<std::string, uint32_t>>& keys, uint64_t sourceTag) {
+    EXO_STATS_PHASE("perfect_hash.build");
+    close();
+    size_t count = keys.size();
+    uint64_t bucketCount = count / kKeysPerBucket + 1;
+
+    DynamicArray<uint64_t> hashes(count);
+    DynamicArray<uint32_t> bucketStart(bucketCount + 1); // keys of bucket b: [start[b], start[b + 1])
+    DynamicArray<uint32_t> members(count);               // key indices grouped by bucket
+    DynamicArray<uint8_t> live(count);
+    DynamicArray<uint32_t> seedTable(bucketCount);
+    DynamicArray<uint8_t> taken;
+    uint64_t hashSeed = 0;
+    size_t liveCount = 0;
+
+    for (uint64_t attempt = 1; ; ++attempt) {
+        EXO_STATS_COUNT("perfect_hash.attempts", 1);
+        hashSeed = mix(attempt);
+
+        // Group keys by bucket (counting sort)
+        for (uint64_t b = 0; b <= bucketCount; ++b) bucketStart[b] = 0;
+        for (size_t i = 0; i < count; ++i) {
+            hashes[i] = hashKey(keys[i].first.data(), keys[i].first.size(), hashSeed);
+            ++bucketStart[bucketOf(hashes[i], bucketCount) + 1];
+        }
+        for (uint64_t b = 0; b < bucketCount; ++b) bucketStart[b + 1] += bucketStart[b];
+        {
+            DynamicArray<uint32_t> fill(bucketCount);
+            for (uint64_t b = 0; b < bucketCount; ++b) fill[b] = bucketStart[b];
+            for (size_t i = 0; i < count; ++i) {
+                members[fill[bucketOf(hashes[i], bucketCount)]++] = static_cast<uint32_t>(i);
+            }
+        }
+
+        // Equal keys share a bucket: keep the last. Distinct keys with equal
+        // hashes cannot be told apart, so they force a new hash seed.
+        bool collision = false;
+        liveCount = 0;
+        size_t largest = 0;
+        for (uint64_t b = 0; b < bucketCount && !collision; ++b) {
+            for (uint32_t i = bucketStart[b]; i < bucketStart[b + 1]; ++i) {
+                uint32_t key = members[i];
+                live[key] = 1;
+                for (uint32_t j = i + 1; j < bucketStart[b + 1]; ++j) {
+                    uint32_t other = members[j];
+                    if (hashes[key] != hashes[other]) continue;
+                    if (keys[key].first != keys[other].first) {
+                        collision = true;
+                    } else if (key < other) {
+                        live[key] = 0;
+                        break;
+                    }
+                }
+                liveCount += live[key];
+            }
+            size_t size = bucketStart[b + 1] - bucketStart[b];
+            if (size > largest) largest = size;
+        }
+        if (collision) continue;
+
+        // Buckets by live size, largest first, while the table is emptiest
+        DynamicArray<uint32_t> sizeStart(largest + 2);
+        DynamicArray<uint32_t> liveSize(bucketCount);
+        for (size_t s = 0; s < largest + 2; ++s) sizeStart[s] = 0;
+        for (uint64_t b = 0; b < bucketCount; ++b) {
+            uint32_t size = 0;
+            for (uint32_t i = bucketStart[b]; i < bucketStart[b + 1]; ++i) size += live[members[i]];
+            liveSize[b] = size;
+            ++sizeStart[largest - size + 1];
+        }
+        for (size_t s = 0; s <= largest; ++s) sizeStart[s + 1] += sizeStart[s];
+        DynamicArray<uint32_t> order(bucketCount);
+        for (uint64_t b = 0; b < bucketCount; ++b) {
+            order[sizeStart[largest - liveSize[b]]++] = static_cast<uint32_t>(b);
+        }
+
+        taken = DynamicArray<uint8_t>(liveCount);
+        for (size_t s = 0; s < liveCount; ++s) taken[s] = 0;
+        DynamicArray<uint64_t> trial(largest + 1);
+        size_t nextFree = 0;
+        bool placed = true;
+
+        for (uint64_t o = 0; o < bucketCount && placed; ++o) {
+            uint32_t b = order[o];
+            uint32_t size = liveSize[b];
+            if (size == 0) {
+                seedTable[b] = 0;
+            } else if (size == 1) {
+                while (taken[nextFree]) ++nextFree;
+                taken[nextFree] = 1;
+                seedTable[b] = kDirect | static_cast<uint32_t>(nextFree);
+            } else {
+                // Smallest seed that sends every key of the bucket to its own free slot
+                placed = false;
+                for (uint32_t seed = 0; seed < kMaxSeed && !placed; ++seed) {
+                    size_t n = 0;
+                    bool fits = true;
+                    for (uint32_t i = bucketStart[b]; i < bucketStart[b + 1] && fits; ++i) {
+                        if (!live[members[i]]) continue;
+                        uint64_t slot = slotOf(hashes[members[i]], seed, liveCount);
+                        if (taken[slot]) fits = false;
+                        for (size_t t = 0; t < n && fits; ++t) fits = trial[t] != slot;
+                        trial[n++] = slot;
+                    }
+                    if (!fits) continue;
+                    for (size_t t = 0; t < n; ++t) taken[trial[t]] = 1;
+                    seedTable[b] = seed;
+                    placed = true;
+                }
+            }
+        }
+        if (placed) break;
+    }
+
+    // Lay out the image: header, seeds, slots
+    size_t bytes = sizeof(Header) + seedBytes(bucketCount) + liveCount * sizeof(Slot);
+    image = DynamicArray<uint64_t>(bytes / 8);
+    char* base = reinterpret_cast<char*>(image.data);
+    std::memset(base, 0, bytes);
+    Header* h = reinterpret_cast<Header*>(base);
+    std::memcpy(h->magic, kMagic, sizeof(kMagic));
+    h->sourceTag = sourceTag;
+    h->keyCount = liveCount;
+    h->bucketCount = bucketCount;
+    h->hashSeed = hashSeed;
+
+    uint32_t* seedOut = reinterpret_cast<uint32_t*>(base + sizeof(Header));
+    Slot* slotOut = reinterpret_cast<Slot*>(base + sizeof(Header) + seedBytes(bucketCount));
+    for (uint64_t b = 0; b < bucketCount; ++b) {
+        uint32_t seed = seedTable[b];
+        seedOut[b] = seed;
+        for (uint32_t i = bucketStart[b]; i < bucketStart[b + 1]; ++i) {
+            uint32_t key = members[i];
+            if (!live[key]) continue;
+            uint64_t slot = (seed & kDirect) ? (seed & ~kDirect) : slotOf(hashes[key], seed, liveCount);
+            slotOut[slot] = Slot{fingerprintOf(hashes[key]), keys[key].second};
+        }
+    }
+    attach(base, bytes, sourceTag);
+}
+
+bool PerfectHashIndex::attach(const char* data, size_t bytes, uint64_t sourceTag) {
+    if (bytes < sizeof(Header)) return false;
+    const Header* h = reinterpret_cast<const Header*>(data);
+    if (std::memcmp(h->magic, kMagic, sizeof(kMagic)) != 0 || h->sourceTag != sourceTag) return false;
+    if (h->bucketCount == 0 || h->bucketCount > UINT32_MAX || h->keyCount >= kDirect) return false;
+    if (bytes != sizeof(Header) + seedBytes(h->bucketCount) + h->keyCount * sizeof(Slot)) return false;
+
+    const uint32_t* s = reinterpret_cast<const uint32_t*>(data + sizeof(Header));
+    for (uint64_t b = 0; b < h->bucketCount; ++b) {
+        if ((s[b] & kDirect) && (s[b] & ~kDirect) >= h->keyCount) return false;
+    }
+
+    header = h;
+    seeds = s;
+    slots = reinterpret_cast<const Slot*>(data + sizeof(Header) + seedBytes(h->bucketCount));
+    return true;
+}
+
+bool PerfectHashIndex::save(const std::string& filename) const {
+    if (!header) return false;
+    std::ofstream out(filename, std::ios::binary);
+    if (!out) {
+        std::cerr << "Error creating file: " << filename << std::endl;
+        return false;
+    }
+    size_t bytes = sizeof(Header) + seedBytes(header->bucketCount) + header->keyCount * sizeof(Slot);
+    out.write(reinterpret_cast<const char*>(header), static_cast<std::streamsize>(bytes));
+    return static_cast<bool>(out);
+}
+
+bool PerfectHashIndex::open(const std::string& filename, uint64_t sourceTag) {
+    close();
+    if (!file.open(filename)) return false;
+    if (!attach(file.data(), file.size(), sourceTag)) {
+        file.close();
+        return false;
+    }
+    return true;
+}
+
+void PerfectHashIndex::close() {
+    header = nullptr;
+    seeds = nullptr;
+    slots = nullptr;
+    image = DynamicArray<uint64_t>();
+    file.close();
+}
+
+size_t PerfectHashIndex::size() const {
+    return header ? header->keyCount : 0;
+}
+
+uint32_t PerfectHashIndex::find(const std::string& key) const {
+    if (!header || header->keyCount == 0) return kNotFound;
+    uint64_t h = hashKey(key.data(), key.size(), header->hashSeed);
+    uint32_t seed = seeds[bucketOf(h, header->bucketCount)];
+    uint64_t slot = (seed & kDirect) ? (seed & ~kDirect) : slotOf(h, seed, header->keyCount);
+    const Slot& entry = slots[slot];
+    return entry.fingerprint == fingerprintOf(h) ? entry.row : kNotFound;
+}
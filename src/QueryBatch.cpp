@@ -0,0 +1,312 @@
+#include "../include/QueryBatch.hpp"
+#include "../include/ThreadPool.hpp"
+#include "../include/Trace.hpp"
+#include "QueryText.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+    using query::kMaxTransitWindows;
+    using query::parseCount;
+    using query::parseNumber;
+    using query::splitWords;
+
+    bool isGrouping(const std::string& key) {
+        return key == "type" || key == "disposition" || key == "multiplicity";
+    }
+
+    // A sorted permutation shared by every job on its property
+    struct SharedSort {
+        std::string property;
+        DynamicArray<size_t> rows;
+        size_t present = 0; // rows with a value; they come first
+        std::string error;
+    };
+
+    // Top rows of a property with no sort to take them from, at the largest
+    // n any job asks for
+    struct SharedSelection {
+        std::string property;
+        bool findMax;
+        size_t n;
+        ExoplanetCatalog::RowList rows; // best first
+        std::string error;
+    };
+
+    // First n of the present rows for the minimum, last n reversed for the maximum
+    DynamicArray<size_t> topFromSort(const SharedSort& sort, size_t n, bool findMax) {
+        DynamicArray<size_t> rows;
+        size_t count = n < sort.present ? n : sort.present;
+        for (size_t i = 0; i < count; ++i) {
+            rows.push_back(findMax ? sort.rows[sort.present - 1 - i] : sort.rows[i]);
+        }
+        return rows;
+    }
+
+    void writeNumber(std::ostream& out, double value) {
+        if (!std::isnan(value)) out << value; // missing stays empty, as in the source CSV
+    }
+}
+
+bool QueryBatch::load(const std::string& manifest) {
+    std::ifstream file(manifest);
+    if (!file.is_open()) {
+        std::cerr << "Error opening file: " << manifest << std::endl;
+        return false;
+    }
+    input.clear();
+    jobs = DynamicArray<Job>();
+
+    std::string line;
+    size_t lineNumber = 0;
+    bool ok = true;
+    while (std::getline(file, line)) {
+        ++lineNumber;
+        DynamicArray<std::string> words = splitWords(line);
+        if (words.empty() || words[0][0] == '#') continue;
+
+        auto fail = [&](const std::string& message) {
+            std::cerr << manifest << ":" << lineNumber << ": " << message << std::endl;
+            ok = false;
+        };
+        const std::string& verb = words[0];
+        if (verb == "input") {
+            if (words.size() != 2) fail("usage: input <catalog.csv>");
+            else input = words[1];
+            continue;
+        }
+
+        Job job = {Kind::Sort, "", 0, true, 0.0, 0.0, words.back()};
+        bool valid = true;
+        if (verb == "sort") {
+            valid = words.size() == 3;
+            if (valid) job.key = words[1];
+        } else if (verb == "top") {
+            job.kind = Kind::Top;
+            valid = words.size() == 5 && parseCount(words[2], job.n) &&
+                    (words[3] == "min" || words[3] == "max");
+            if (valid) {
+                job.key = words[1];
+                job.findMax = words[3] == "max";
+            }
+        } else if (verb == "filter") {
+            job.kind = Kind::Filter;
+            valid = words.size() == 5 && parseNumber(words[2], job.min) && parseNumber(words[3], job.max);
+            if (valid) job.key = words[1];
+        } else if (verb == "habitable") {
+            job.kind = Kind::Habitable;
+            valid = words.size() == 2;
+        } else if (verb == "group") {
+            job.kind = Kind::Group;
+            valid = words.size() == 3 && isGrouping(words[1]);
+            if (valid) job.key = words[1];
+        } else if (verb == "transits") {
+            job.kind = Kind::Transits;
+            valid = words.size() == 4 && parseNumber(words[1], job.min) && parseNumber(words[2], job.max) &&
+                    job.min <= job.max;
+        } else if (verb == "stats") {
+            job.kind = Kind::Stats;
+            valid = words.size() == 3;
+            if (valid) job.key = words[1];
+        } else {
+            fail("unknown job '" + verb + "'");
+            continue;
+        }
+
+        if (!valid) {
+            fail("malformed '" + verb + "' job");
+        } else if (job.kind != Kind::Habitable && job.kind != Kind::Group && job.kind != Kind::Transits &&
+                   !ExoplanetCatalog::isProperty(job.key)) {
+            fail("unknown property '" + job.key + "'");
+        } else {
+            for (const auto& other : jobs) {
+                if (other.output == job.output) valid = false;
+            }
+            if (valid) jobs.push_back(job);
+            else fail(job.output + " is written by an earlier job");
+        }
+    }
+    return ok;
+}
+
+bool QueryBatch::run(const ExoplanetCatalog& catalog) const {
+    EXO_PHASE("batch.run");
+    auto start = std::chrono::steady_clock::now();
+
+    // Plan: one sort per property that an export sorts by, and one
+    // selection per (property, direction) of the top lists no sort covers
+    DynamicArray<SharedSort> sorts;
+    DynamicArray<SharedSelection> selections;
+    DynamicArray<size_t> source(jobs.size()); // job -> its sort or selection
+    for (size_t j = 0; j < jobs.size(); ++j) {
+        const Job& job = jobs[j];
+        if (job.kind != Kind::Sort) continue;
+        size_t s = 0;
+        while (s < sorts.size() && sorts[s].property != job.key) ++s;
+        if (s == sorts.size()) {
+            sorts.push_back(SharedSort());
+            sorts.back().property = job.key;
+        }
+        source[j] = s;
+    }
+    for (size_t j = 0; j < jobs.size(); ++j) {
+        const Job& job = jobs[j];
+        if (job.kind != Kind::Top) continue;
+        size_t s = 0;
+        while (s < sorts.size() && sorts[s].property != job.key) ++s;
+        if (s < sorts.size()) {
+            source[j] = s;
+            continue;
+        }
+        s = 0;
+        while (s < selections.size() &&
+               (selections[s].property != job.key || selections[s].findMax != job.findMax)) ++s;
+        if (s == selections.size()) {
+            selections.push_back(SharedSelection());
+            selections.back().property = job.key;
+            selections.back().findMax = job.findMax;
+            selections.back().n = 0;
+        }
+        if (job.n > selections[s].n) selections[s].n = job.n;
+        source[j] = sorts.size() + s; // past the sorts: a selection
+    }
+
+    {
+        EXO_PHASE("batch.shared");
+        TaskGroup group;
+        for (auto& sort : sorts) {
+            group.run([&catalog, &sort] {
+                try {
+                    sort.rows = catalog.sortedRows(sort.property, &sort.present);
+                } catch (const std::exception& e) {
+                    sort.error = e.what();
+                }
+            });
+        }
+        for (auto& selection : selections) {
+            group.run([&catalog, &selection] {
+                try {
+                    selection.rows = catalog.topExtremes(selection.n, selection.property, selection.findMax);
+                } catch (const std::exception& e) {
+                    selection.error = e.what();
+                }
+            });
+        }
+        group.wait();
+    }
+
+    // Outputs: independent files, written side by side
+    DynamicArray<size_t> written(jobs.size());
+    DynamicArray<std::string> errors(jobs.size());
+    {
+        EXO_PHASE("batch.outputs");
+        TaskGroup group;
+        for (size_t j = 0; j < jobs.size(); ++j) {
+            group.run([&, j] {
+                const Job& job = jobs[j];
+                written[j] = 0;
+                try {
+                    // Rows to export: a shared list where the job takes one
+                    // whole, else the job's own
+                    DynamicArray<size_t> own;
+                    ExoplanetCatalog::RowList cached;
+                    const DynamicArray<size_t>* rows = &own;
+                    switch (job.kind) {
+                    case Kind::Sort:
+                        if (!sorts[source[j]].error.empty()) throw std::runtime_error(sorts[source[j]].error);
+                        rows = &sorts[source[j]].rows;
+                        break;
+                    case Kind::Top:
+                        if (source[j] < sorts.size()) {
+                            own = topFromSort(sorts[source[j]], job.n, job.findMax);
+                        } else {
+                            const SharedSelection& selection = selections[source[j] - sorts.size()];
+                            if (!selection.error.empty()) throw std::runtime_error(selection.error);
+                            for (size_t i = 0; i < selection.rows->size() && i < job.n; ++i) {
+                                own.push_back((*selection.rows)[i]);
+                            }
+                        }
+                        break;
+                    case Kind::Filter:
+                        cached = catalog.rowsInRange(job.key, job.min, job.max);
+                        rows = cached.get();
+                        break;
+                    case Kind::Habitable:
+                        cached = catalog.habitableRows();
+                        rows = cached.get();
+                        break;
+                    case Kind::Transits: {
+                        size_t count = catalog.transitEphemeris().countBetween(job.min, job.max);
+                        if (count > kMaxTransitWindows) {
+                            throw std::runtime_error("range holds " + std::to_string(count) +
+                                                     " transits, over the limit of " +
+                                                     std::to_string(kMaxTransitWindows));
+                        }
+                        std::ofstream out(job.output);
+                        if (!out) throw std::runtime_error("cannot create file");
+                        out << std::setprecision(10);
+                        out << "kepoi_name,kepler_name,epoch,start_bkjd,mid_bkjd,end_bkjd\n";
+                        TransitIndex transits = catalog.transitsBetween(job.min, job.max);
+                        const DynamicArray<Exoplanet>& planets = catalog.getPlanets();
+                        for (const TransitWindow& window : transits.intervals()) {
+                            const Exoplanet& planet = planets[window.row];
+                            out << planet.kepoi_name << "," << planet.kepler_name << "," << window.epoch << ","
+                                << window.start << "," << window.mid() << "," << window.end << "\n";
+                        }
+                        if (!out) throw std::runtime_error("write failed");
+                        written[j] = transits.size();
+                        return;
+                    }
+                    case Kind::Group:
+                    case Kind::Stats: {
+                        std::ofstream out(job.output);
+                        if (!out) throw std::runtime_error("cannot create file");
+                        out << std::setprecision(10);
+                        if (job.kind == Kind::Group) {
+                            out << job.key << ",planets\n";
+                            ExoplanetCatalog::GroupList groups = catalog.countBy(job.key);
+                            for (const auto& g : *groups) out << g.first << "," << g.second << "\n";
+                            written[j] = groups->size();
+                        } else {
+                            ExoplanetCatalog::Stats stats = catalog.analyzeProperty(job.key);
+                            out << "property,count,mean,median,min,max\n" << job.key << "," << stats.count;
+                            for (double value : {stats.mean, stats.median, stats.min, stats.max}) {
+                                out << ",";
+                                writeNumber(out, value);
+                            }
+                            out << "\n";
+                            written[j] = 1;
+                        }
+                        if (!out) throw std::runtime_error("write failed");
+                        return;
+                    }
+                    }
+                    if (!catalog.saveRows(job.output, *rows)) throw std::runtime_error("write failed");
+                    written[j] = rows->size();
+                } catch (const std::exception& e) {
+                    errors[j] = e.what();
+                }
+            });
+        }
+        group.wait();
+    }
+
+    bool ok = true;
+    for (size_t j = 0; j < jobs.size(); ++j) {
+        if (errors[j].empty()) {
+            std::cout << "Wrote " << jobs[j].output << " (" << written[j] << " rows)\n";
+        } else {
+            std::cerr << "Failed to write " << jobs[j].output << ": " << errors[j] << std::endl;
+            ok = false;
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << jobs.size() << " outputs (" << sorts.size() << " sorts, " << selections.size()
+              << " top-k selections shared) in " << seconds << " s" << std::endl;
+    return ok;
+}
@@ -0,0 +1,571 @@
+#include "../include/QueryServer.hpp"
+#include "../include/ThreadPool.hpp"
+#include "../include/Trace.hpp"
+#include "QueryText.hpp"
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+    // Input buffered per connection before reading pauses, and replies
+    // queued before further requests wait for the client to catch up
+    const size_t kMaxBufferedInput = 64 * 1024;
+    const size_t kMaxPendingOutput = 1 << 20;
+
+    const size_t kDefaultSearchLimit = 10;
+
+    using query::kMaxTransitWindows;
+    using query::parseCount;
+    using query::parseNumber;
+    using query::splitWords;
+
+    // epoll data of the fixed descriptors; connections count up from kFirstConnection
+    const uint64_t kListener = 0;
+    const uint64_t kDoneEvent = 1;
+    const uint64_t kStopEvent = 2;
+    const uint64_t kFirstConnection = 3;
+
+    // SIGINT and SIGTERM write here to wake the event loop
+    int stopFd = -1;
+
+    void requestStop(int) {
+        uint64_t one = 1;
+        ssize_t written = write(stopFd, &one, sizeof(one));
+        (void)written; // nothing to be done in a handler
+    }
+
+    // Text after the first `skip` words, leading blanks removed
+    std::string restOfLine(const std::string& line, size_t skip) {
+        size_t pos = 0;
+        for (size_t i = 0; i <= skip; ++i) {
+            pos = line.find_first_not_of(" \t", pos);
+            if (pos == std::string::npos) return "";
+            if (i < skip) pos = line.find_first_of(" \t", pos);
+        }
+        return line.substr(pos);
+    }
+
+    void appendNumber(std::string& out, double value) {
+        if (std::isnan(value)) {
+            out += '-';
+            return;
+        }
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.10g", value);
+        out += text;
+    }
+
+    void appendPlanet(std::string& out, const Exoplanet& planet) {
+        out += planet.kepoi_name;
+        out += '\t';
+        out += planet.kepler_name.empty() ? "-" : planet.kepler_name;
+        out += '\t';
+        out += planet.koi_disposition;
+        const double values[] = {planet.koi_period, planet.koi_prad, planet.koi_teq,
+                                 planet.koi_insol, planet.ra, planet.dec};
+        for (double value : values) {
+            out += '\t';
+            appendNumber(out, value);
+        }
+        out += '\n';
+    }
+
+    // kepoi_name and epoch of a transit
+    void appendTransit(std::string& out, const Exoplanet& planet, const TransitWindow& window) {
+        out += planet.kepoi_name;
+        out += '\t';
+        out += std::to_string(window.epoch);
+    }
+
+    // Accumulates the lines of an OK reply
+    struct Reply {
+        std::string body;
+        size_t lines = 0;
+
+        std::string& line() {
+            ++lines;
+            return body;
+        }
+        std::string text() const { return "OK " + std::to_string(lines) + "\n" + body; }
+    };
+
+    std::string error(const std::string& message) { return "ERR " + message + "\n"; }
+
+    struct Connection {
+        int fd;
+        std::string input;     // received, not yet handled
+        std::string output;    // replies not yet sent
+        bool busy = false;     // a request is with a worker
+        bool peerDone = false; // nothing more will be read
+        uint32_t interest = 0; // events registered with epoll
+    };
+
+    struct Completion {
+        uint64_t connection;
+        std::string reply;
+    };
+
+    // Replies coming back from the workers
+    struct CompletionQueue {
+        std::mutex lock;
+        std::condition_variable idle;
+        std::deque<Completion> done;
+        size_t running = 0;
+        int eventFd = -1;
+
+        void push(uint64_t connection, std::string reply) {
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                done.push_back(Completion{connection, std::move(reply)});
+                --running;
+            }
+            idle.notify_all();
+            uint64_t one = 1;
+            ssize_t written = write(eventFd, &one, sizeof(one));
+            (void)written; // the counter only saturates, it cannot lose the wakeup
+        }
+    };
+
+    class EventLoop {
+    public:
+        EventLoop(const QueryServer& server, int epollFd, CompletionQueue& completions)
+            : server(server), epollFd(epollFd), completions(completions),
+              nextId(kFirstConnection), stopping(false) {}
+
+        ~EventLoop() {
+            for (auto& entry : connections) close(entry.second.fd);
+        }
+
+        bool stopped() const { return stopping; }
+        void stop() { stopping = true; }
+
+        void accept(int listener) {
+            while (true) {
+                int fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (fd < 0) {
+                    if (errno == EINTR) continue;
+                    if (errno != EAGAIN && errno != EWOULDBLOCK) std::perror("accept");
+                    return;
+                }
+                EXO_STATS_COUNT("server.connections", 1);
+                uint64_t id = nextId++;
+                Connection& conn = connections[id];
+                conn.fd = fd;
+                epoll_event event = {};
+                event.data.u64 = id;
+                if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+                    std::perror("epoll_ctl");
+                    drop(id);
+                    continue;
+                }
+                update(id);
+            }
+        }
+
+        void ready(uint64_t id, uint32_t events) {
+            auto it = connections.find(id);
+            if (it == connections.end()) return;
+            Connection& conn = it->second;
+            if (events & (EPOLLHUP | EPOLLERR)) { // gone both ways: no one to answer
+                drop(id);
+                return;
+            }
+            if (events & EPOLLIN) receive(conn);
+            if (events & EPOLLOUT) {
+                if (!send(conn)) {
+                    drop(id);
+                    return;
+                }
+            }
+            serve(id);
+        }
+
+        void collect() {
+            uint64_t count;
+            ssize_t got = read(completions.eventFd, &count, sizeof(count));
+            (void)got; // EAGAIN just means another wakeup already drained it
+            std::deque<Completion> done;
+            {
+                std::lock_guard<std::mutex> guard(completions.lock);
+                done.swap(completions.done);
+            }
+            for (auto& completion : done) {
+                auto it = connections.find(completion.connection);
+                if (it == connections.end()) continue; // the client left meanwhile
+                it->second.busy = false;
+                it->second.output += completion.reply;
+                serve(completion.connection);
+            }
+        }
+
+        // Best effort: whatever the sockets take without blocking
+        void flushAll() {
+            for (auto& entry : connections) send(entry.second);
+        }
+
+    private:
+        const QueryServer& server;
+        int epollFd;
+        CompletionQueue& completions;
+        std::unordered_map<uint64_t, Connection> connections;
+        uint64_t nextId;
+        bool stopping;
+
+        void receive(Connection& conn) {
+            char buffer[16 * 1024];
+            while (!conn.peerDone && conn.input.size() < kMaxBufferedInput) {
+                ssize_t got = recv(conn.fd, buffer, sizeof(buffer), 0);
+                if (got > 0) {
+                    conn.input.append(buffer, static_cast<size_t>(got));
+                } else if (got < 0 && errno == EINTR) {
+                    continue;
+                } else if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    return;
+                } else {
+                    conn.peerDone = true; // closed, or failed: answer what came before
+                }
+            }
+        }
+
+        // False if the connection has failed
+        bool send(Connection& conn) {
+            size_t sent = 0;
+            while (sent < conn.output.size()) {
+                ssize_t n = ::send(conn.fd, conn.output.data() + sent, conn.output.size() - sent, MSG_NOSIGNAL);
+                if (n > 0) {
+                    sent += static_cast<size_t>(n);
+                } else if (n < 0 && errno == EINTR) {
+                    continue;
+                } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    break;
+                } else {
+                    return false;
+                }
+            }
+            conn.output.erase(0, sent);
+            return true;
+        }
+
+        // Starts the next complete requests of a connection, sends what is
+        // ready, then closes it or updates its epoll interest
+        void serve(uint64_t id) {
+            Connection& conn = connections[id];
+            while (!conn.busy && !stopping && conn.output.size() < kMaxPendingOutput) {
+                size_t end = conn.input.find('\n');
+                if (end == std::string::npos) {
+                    if (conn.input.size() > QueryServer::kMaxRequestLength) {
+                        conn.output += error("request too long");
+                        conn.input.clear();
+                        conn.peerDone = true;
+                    }
+                    break;
+                }
+                std::string request = conn.input.substr(0, end);
+                conn.input.erase(0, end + 1);
+                if (!request.empty() && request.back() == '\r') request.pop_back();
+                if (request.find_first_not_of(" \t") == std::string::npos) continue;
+                dispatch(id, conn, request);
+            }
+            if (!send(conn)) {
+                drop(id);
+                return;
+            }
+            bool pending = conn.busy || !conn.output.empty() ||
+                           (!stopping && conn.input.find('\n') != std::string::npos);
+            if (conn.peerDone && !pending) {
+                drop(id);
+                return;
+            }
+            update(id);
+        }
+
+        void dispatch(uint64_t id, Connection& conn, const std::string& request) {
+            EXO_STATS_COUNT("server.requests", 1);
+            DynamicArray<std::string> words = splitWords(request);
+            std::string command = words[0];
+            for (char& c : command) c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+            if (command == "SHUTDOWN") {
+                conn.output += "OK 0\n";
+                stopping = true;
+                return;
+            }
+
+            ThreadPool& pool = ThreadPool::instance();
+            if (pool.workerCount() <= 1) { // no one to hand it to
+                conn.output += server.handle(request);
+                return;
+            }
+            conn.busy = true;
+            {
+                std::lock_guard<std::mutex> guard(completions.lock);
+                ++completions.running;
+            }
+            const QueryServer* target = &server;
+            CompletionQueue* queue = &completions;
+            pool.submit([target, queue, id, request] { queue->push(id, target->handle(request)); });
+        }
+
+        void update(uint64_t id) {
+            Connection& conn = connections[id];
+            uint32_t interest = 0;
+            if (!conn.peerDone && conn.input.size() < kMaxBufferedInput) interest |= EPOLLIN;
+            if (!conn.output.empty()) interest |= EPOLLOUT;
+            if (interest == conn.interest) return;
+            epoll_event event = {};
+            event.events = interest;
+            event.data.u64 = id;
+            epoll_ctl(epollFd, EPOLL_CTL_MOD, conn.fd, &event);
+            conn.interest = interest;
+        }
+
+        void drop(uint64_t id) {
+            auto it = connections.find(id);
+            if (it == connections.end()) return;
+            close(it->second.fd); // also removes it from the epoll set
+            connections.erase(it);
+        }
+    };
+
+    // Listening socket at `path`; -1 after reporting why not
+    int listenAt(const std::string& path) {
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+            std::cerr << "Invalid socket path: " << path << std::endl;
+            return -1;
+        }
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+        // A socket file left by a server that did not shut down cleanly
+        struct stat st;
+        if (lstat(path.c_str(), &st) == 0) {
+            if (!S_ISSOCK(st.st_mode)) {
+                std::cerr << "Not replacing " << path << ": it is not a socket" << std::endl;
+                return -1;
+            }
+            unlink(path.c_str());
+        }
+
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            std::perror("socket");
+            return -1;
+        }
+        if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+            listen(fd, SOMAXCONN) != 0) {
+            std::cerr << "Error listening on " << path << ": " << std::strerror(errno) << std::endl;
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    bool watch(int epollFd, int fd, uint64_t id) {
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.u64 = id;
+        return epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) == 0;
+    }
+}
+
+bool QueryServer::run(const std::string& socketPath) {
+    int listener = listenAt(socketPath);
+    if (listener < 0) return false;
+    std::cout << "Serving " << catalog.getPlanets().size() << " planets on " << socketPath << std::endl;
+
+    CompletionQueue completions;
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    completions.eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    stopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    bool ok = epollFd >= 0 && completions.eventFd >= 0 && stopFd >= 0 &&
+              watch(epollFd, listener, kListener) && watch(epollFd, completions.eventFd, kDoneEvent) &&
+              watch(epollFd, stopFd, kStopEvent);
+    if (!ok) std::perror("epoll");
+
+    struct sigaction onStop = {}, oldInt, oldTerm;
+    onStop.sa_handler = requestStop;
+    sigemptyset(&onStop.sa_mask);
+    sigaction(SIGINT, &onStop, &oldInt);
+    sigaction(SIGTERM, &onStop, &oldTerm);
+
+    {
+        EventLoop loop(*this, epollFd, completions);
+        epoll_event events[64];
+        while (ok && !loop.stopped()) {
+            int count = epoll_wait(epollFd, events, 64, -1);
+            if (count < 0) {
+                if (errno == EINTR) continue;
+                std::perror("epoll_wait");
+                ok = false;
+                break;
+            }
+            for (int i = 0; i < count; ++i) {
+                uint64_t id = events[i].data.u64;
+                if (id == kListener) loop.accept(listener);
+                else if (id == kDoneEvent) loop.collect();
+                else if (id == kStopEvent) loop.stop();
+                else loop.ready(id, events[i].events);
+            }
+        }
+
+        // Workers still hold references to this server and the queue
+        {
+            std::unique_lock<std::mutex> guard(completions.lock);
+            completions.idle.wait(guard, [&completions] { return completions.running == 0; });
+        }
+        loop.collect();
+        loop.flushAll();
+    }
+
+    sigaction(SIGINT, &oldInt, nullptr);
+    sigaction(SIGTERM, &oldTerm, nullptr);
+    close(listener);
+    unlink(socketPath.c_str());
+    if (stopFd >= 0) close(stopFd);
+    stopFd = -1;
+    if (completions.eventFd >= 0) close(completions.eventFd);
+    if (epollFd >= 0) close(epollFd);
+    return ok;
+}
+
+std::string QueryServer::handle(const std::string& request) const {
+    EXO_PHASE("server.request");
+    DynamicArray<std::string> words = splitWords(request);
+    if (words.empty()) return error("empty request");
+    std::string command = words[0];
+    for (char& c : command) c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+    const DynamicArray<Exoplanet>& planets = catalog.getPlanets();
+    Reply reply;
+
+    try {
+        if (command == "PING") {
+            return reply.text();
+        } else if (command == "NAME") {
+            std::string name = restOfLine(request, 1);
+            if (name.empty()) return error("usage: NAME <name>");
+            const Exoplanet* planet = catalog.findPlanetByName(name);
+            if (!planet) {
+                // Distance 0 in the trie is an exact match ignoring case
+                auto matches = catalog.findPlanetsByFuzzyName(name, 0, 1);
+                if (!matches.empty()) planet = matches[0].planet;
+            }
+            if (planet) appendPlanet(reply.line(), *planet);
+        } else if (command == "SEARCH") {
+            size_t limit = kDefaultSearchLimit;
+            std::string text = restOfLine(request, 2);
+            if (words.size() < 3 || !parseCount(words[1], limit) || text.empty()) {
+                return error("usage: SEARCH <limit> <text>");
+            }
+            auto matches = catalog.findPlanetsByPrefix(text, limit);
+            if (matches.empty()) matches = catalog.findPlanetsByFuzzyName(text, text.size() <= 4 ? 1 : 2, limit);
+            for (const auto& match : matches) {
+                std::string& out = reply.line();
+                out += std::to_string(match.distance);
+                out += '\t';
+                appendPlanet(out, *match.planet);
+            }
+        } else if (command == "FILTER") {
+            double min, max;
+            size_t limit = planets.size();
+            if (words.size() < 4 || words.size() > 5 || !parseNumber(words[2], min) ||
+                !parseNumber(words[3], max) || (words.size() == 5 && !parseCount(words[4], limit))) {
+                return error("usage: FILTER <property> <min> <max> [limit]");
+            }
+            ExoplanetCatalog::RowList rows = catalog.rowsInRange(words[1], min, max);
+            for (size_t i = 0; i < rows->size() && i < limit; ++i) appendPlanet(reply.line(), planets[(*rows)[i]]);
+        } else if (command == "TOP") {
+            size_t n;
+            bool findMax = true;
+            if (words.size() < 3 || words.size() > 4 || !parseCount(words[2], n) ||
+                (words.size() == 4 && words[3] != "min" && words[3] != "max")) {
+                return error("usage: TOP <property> <n> [min|max]");
+            }
+            if (words.size() == 4) findMax = words[3] == "max";
+            ExoplanetCatalog::RowList rows = catalog.topExtremes(n, words[1], findMax);
+            for (size_t row : *rows) appendPlanet(reply.line(), planets[row]);
+        } else if (command == "STATS") {
+            if (words.size() != 2) return error("usage: STATS <property>");
+            ExoplanetCatalog::Stats stats = catalog.analyzeProperty(words[1]);
+            reply.line() += "count\t" + std::to_string(stats.count) + "\n";
+            const char* names[] = {"mean", "median", "min", "max"};
+            const double values[] = {stats.mean, stats.median, stats.min, stats.max};
+            for (size_t i = 0; i < 4; ++i) {
+                std::string& out = reply.line();
+                out += names[i];
+                out += '\t';
+                appendNumber(out, values[i]);
+                out += '\n';
+            }
+        } else if (command == "GROUP") {
+            if (words.size() != 2) return error("usage: GROUP type|disposition|multiplicity");
+            ExoplanetCatalog::GroupList groups = catalog.countBy(words[1]);
+            for (const auto& group : *groups) {
+                reply.line() += group.first + "\t" + std::to_string(group.second) + "\n";
+            }
+        } else if (command == "TRANSITS" || command == "OVERLAPS") {
+            double from, to;
+            size_t limit = SIZE_MAX;
+            if (words.size() < 3 || words.size() > 4 || !parseNumber(words[1], from) ||
+                !parseNumber(words[2], to) || (words.size() == 4 && !parseCount(words[3], limit))) {
+                return error("usage: " + command + " <from> <to> [limit]");
+            }
+            size_t count = catalog.transitEphemeris().countBetween(from, to);
+            if (count > kMaxTransitWindows) {
+                return error("range holds " + std::to_string(count) + " transits, over the limit of " +
+                             std::to_string(kMaxTransitWindows));
+            }
+            TransitIndex transits = catalog.transitsBetween(from, to);
+            if (command == "TRANSITS") {
+                for (size_t i = 0; i < transits.size() && i < limit; ++i) {
+                    const TransitWindow& window = transits[i];
+                    std::string& out = reply.line();
+                    appendTransit(out, planets[window.row], window);
+                    for (double value : {window.start, window.mid(), window.end}) {
+                        out += '\t';
+                        appendNumber(out, value);
+                    }
+                    out += '\n';
+                }
+            } else {
+                transits.forEachOverlappingPair([&](size_t i, size_t j) {
+                    const TransitWindow& a = transits[i];
+                    const TransitWindow& b = transits[j];
+                    if (a.row == b.row) return true;
+                    if (reply.lines >= limit) return false;
+                    std::string& out = reply.line();
+                    appendTransit(out, planets[a.row], a);
+                    out += '\t';
+                    appendTransit(out, planets[b.row], b);
+                    for (double value : {b.start, a.end < b.end ? a.end : b.end}) {
+                        out += '\t';
+                        appendNumber(out, value);
+                    }
+                    out += '\n';
+                    return true;
+                });
+            }
+        } else {
+            return error("unknown command " + words[0]);
+        }
+    } catch (const std::exception& e) {
+        return error(e.what());
+    }
+    return reply.text();
+}
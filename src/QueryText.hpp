@@ -0,0 +1,35 @@
+#pragma once
+#include "../include/datastructs/DynamicArray.hpp"
+#include <cstddef>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+
+// Word parsing shared by the batch manifest and the query server, so a
+// job and a request spelled the same way are read the same way
+namespace query {
+    // Transit windows one batch job, TRANSITS or OVERLAPS request may enumerate
+    const size_t kMaxTransitWindows = 1 << 22;
+
+    inline DynamicArray<std::string> splitWords(const std::string& line) {
+        DynamicArray<std::string> words;
+        std::istringstream in(line);
+        std::string word;
+        while (in >> word) words.push_back(word);
+        return words;
+    }
+
+    inline bool parseNumber(const std::string& word, double& value) {
+        char* end;
+        value = std::strtod(word.c_str(), &end);
+        return !word.empty() && *end == '\0';
+    }
+
+    inline bool parseCount(const std::string& word, size_t& value) {
+        char* end;
+        unsigned long long n = std::strtoull(word.c_str(), &end, 10);
+        if (word.empty() || word[0] == '-' || *end != '\0') return false;
+        value = static_cast<size_t>(n);
+        return true;
+    }
+}
@@ -0,0 +1,131 @@
+#include "../include/Stats.hpp"
+#include <iomanip>
+#include <map>
+#include <string>
+
+namespace stats {
+
+namespace {
+    std::atomic<Metric*> registry{nullptr};
+
+    struct Totals {
+        Metric::Kind kind;
+        uint64_t count = 0, sum = 0, max = 0;
+    };
+
+    // Sites that share a name are reported as one metric
+    std::map<std::string, Totals> collect() {
+        std::map<std::string, Totals> totals;
+        for (const Metric* m = registry.load(std::memory_order_acquire); m; m = m->next()) {
+            Totals& t = totals[m->name()];
+            t.kind = m->kind();
+            t.count += m->count();
+            t.sum += m->sum();
+            if (m->max() > t.max) t.max = m->max();
+        }
+        return totals;
+    }
+}
+
+Metric::Metric(const char* name, Kind kind) : _name(name), _kind(kind) {
+    _next = registry.load(std::memory_order_relaxed);
+    while (!registry.compare_exchange_weak(_next, this, std::memory_order_release,
+                                           std::memory_order_relaxed)) {
+    }
+}
+
+Metric::Shard& Metric::shardOf(Metric& metric) {
+    static std::atomic<size_t> threads{0};
+    thread_local size_t index = threads.fetch_add(1, std::memory_order_relaxed) % kShards;
+    return metric.shards[index];
+}
+
+uint64_t Metric::count() const {
+    uint64_t total = 0;
+    for (const Shard& s : shards) total += s.count.load(std::memory_order_relaxed);
+    return total;
+}
+
+uint64_t Metric::sum() const {
+    uint64_t total = 0;
+    for (const Shard& s : shards) total += s.sum.load(std::memory_order_relaxed);
+    return total;
+}
+
+uint64_t Metric::max() const {
+    uint64_t best = 0;
+    for (const Shard& s : shards) {
+        uint64_t value = s.max.load(std::memory_order_relaxed);
+        if (value > best) best = value;
+    }
+    return best;
+}
+
+void report(std::ostream& out) {
+    if (!kEnabled) {
+        out << "Statistics are compiled out; rebuild with make clean && make STATS=1\n";
+        return;
+    }
+    std::map<std::string, Totals> totals = collect();
+    std::ios flags(nullptr);
+    flags.copyfmt(out);
+    out << std::fixed << std::setprecision(3);
+
+    out << "\nPhases" << std::setw(38) << "calls" << std::setw(14) << "total ms"
+        << std::setw(14) << "mean ms" << "\n";
+    for (const auto& entry : totals) {
+        const Totals& t = entry.second;
+        if (t.kind != Metric::Kind::Phase) continue;
+        out << "  " << std::left << std::setw(36) << entry.first << std::right
+            << std::setw(10) << t.count << std::setw(14) << t.sum / 1e6
+            << std::setw(14) << (t.count ? t.sum / 1e6 / t.count : 0.0) << "\n";
+    }
+
+    out << "\nCounters\n";
+    for (const auto& entry : totals) {
+        if (entry.second.kind != Metric::Kind::Counter) continue;
+        out << "  " << std::left << std::setw(36) << entry.first << std::right
+            << std::setw(16) << entry.second.sum << "\n";
+    }
+
+    out << "\nSamples" << std::setw(37) << "count" << std::setw(14) << "mean"
+        << std::setw(14) << "max" << "\n";
+    for (const auto& entry : totals) {
+        const Totals& t = entry.second;
+        if (t.kind != Metric::Kind::Sample) continue;
+        out << "  " << std::left << std::setw(36) << entry.first << std::right
+            << std::setw(10) << t.count
+            << std::setw(14) << (t.count ? static_cast<double>(t.sum) / t.count : 0.0)
+            << std::setw(14) << t.max << "\n";
+    }
+    out.copyfmt(flags);
+}
+
+void writeJson(std::ostream& out) {
+    std::map<std::string, Totals> totals = collect();
+    const char* sections[] = {"counters", "samples", "phases"};
+    const Metric::Kind kinds[] = {Metric::Kind::Counter, Metric::Kind::Sample, Metric::Kind::Phase};
+
+    out << "{\n  \"enabled\": " << (kEnabled ? "true" : "false");
+    for (int s = 0; s < 3; ++s) {
+        out << ",\n  \"" << sections[s] << "\": {";
+        bool first = true;
+        for (const auto& entry : totals) {
+            const Totals& t = entry.second;
+            if (t.kind != kinds[s]) continue;
+            out << (first ? "\n    \"" : ",\n    \"") << entry.first << "\": ";
+            first = false;
+            if (t.kind == Metric::Kind::Counter) {
+                out << t.sum;
+            } else if (t.kind == Metric::Kind::Sample) {
+                out << "{\"count\": " << t.count << ", \"sum\": " << t.sum << ", \"max\": " << t.max << "}";
+            } else {
+                out << "{\"calls\": " << t.count << ", \"total_ns\": " << t.sum << ", \"max_ns\": " << t.max << "}";
+            }
+        }
+        out << (first ? "}" : "\n  }");
+    }
+    out << "\n}\n";
+}
+
+} // namespace stats
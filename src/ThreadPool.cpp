@@ -0,0 +1,163 @@
+#include "../include/ThreadPool.hpp"
+#include "../include/Trace.hpp"
+#include <cstdlib>
+#include <fstream>
+#include <sched.h>
+
+namespace {
+    // Index of the calling thread's own queue; 0 for threads outside the pool
+    thread_local size_t currentQueue = 0;
+
+    std::mutex instanceLock;
+    std::unique_ptr<ThreadPool> globalPool;
+    size_t configuredThreads = 0;
+
+    // CPU limit from the cgroup quota, 0 if there is none
+    size_t cgroupCpuLimit() {
+        double quota = 0, period = 0;
+
+        std::ifstream v2("/sys/fs/cgroup/cpu.max");
+        std::string max;
+        if (v2 >> max >> period) {
+            if (max == "max") return 0;
+            quota = std::atof(max.c_str());
+        } else {
+            std::ifstream q("/sys/fs/cgroup/cpu/cpu.cfs_quota_us");
+            std::ifstream p("/sys/fs/cgroup/cpu/cpu.cfs_period_us");
+            if (!(q >> quota) || !(p >> period) || quota <= 0) return 0;
+        }
+        if (quota <= 0 || period <= 0) return 0;
+
+        size_t cpus = static_cast<size_t>(quota / period);
+        if (cpus * period < quota) ++cpus; // a partial CPU still gets a thread
+        return cpus;
+    }
+}
+
+size_t ThreadPool::defaultWorkerCount() {
+    if (const char* env = std::getenv("EXO_THREADS")) {
+        long n = std::atol(env);
+        if (n > 0) return static_cast<size_t>(n);
+    }
+
+    size_t cpus = std::thread::hardware_concurrency();
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        cpus = static_cast<size_t>(CPU_COUNT(&set));
+    }
+
+    size_t limit = cgroupCpuLimit();
+    if (limit && limit < cpus) cpus = limit;
+    return cpus ? cpus : 1;
+}
+
+ThreadPool& ThreadPool::instance() {
+    std::lock_guard<std::mutex> guard(instanceLock);
+    if (!globalPool) {
+        size_t threads = configuredThreads ? configuredThreads : defaultWorkerCount();
+        globalPool.reset(new ThreadPool(threads));
+    }
+    return *globalPool;
+}
+
+void ThreadPool::configure(size_t threads) {
+    std::lock_guard<std::mutex> guard(instanceLock);
+    configuredThreads = threads;
+    globalPool.reset(); // the next instance() call starts the new pool
+}
+
+ThreadPool::ThreadPool(size_t threadCount) : stopping(false), queued(0) {
+    if (threadCount == 0) threadCount = 1;
+    for (size_t i = 0; i < threadCount; ++i) {
+        queues.emplace_back(new Queue());
+    }
+    // The thread that waits on a TaskGroup is the last worker
+    for (size_t i = 1; i < threadCount; ++i) {
+        threads.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> guard(sleepLock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& t : threads) t.join();
+}
+
+void ThreadPool::submit(Task task) {
+    Queue& queue = *queues[currentQueue < queues.size() ? currentQueue : 0];
+    {
+        std::lock_guard<std::mutex> guard(queue.lock);
+        queue.tasks.push_back(std::move(task));
+    }
+    ++queued;
+    {
+        std::lock_guard<std::mutex> guard(sleepLock);
+    }
+    wake.notify_one();
+}
+
+bool ThreadPool::takeTask(Task& task) {
+    // Newest task from our own deque: its data is likely still in cache
+    if (currentQueue != 0) {
+        Queue& own = *queues[currentQueue];
+        std::lock_guard<std::mutex> guard(own.lock);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            --queued;
+            return true;
+        }
+    }
+
+    // Otherwise steal the oldest task, which tends to be the largest split
+    for (size_t i = 0; i < queues.size(); ++i) {
+        size_t victim = (currentQueue + i) % queues.size();
+        if (victim == currentQueue && currentQueue != 0) continue;
+        Queue& queue = *queues[victim];
+        std::lock_guard<std::mutex> guard(queue.lock);
+        if (!queue.tasks.empty()) {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            --queued;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ThreadPool::runPendingTask() {
+    Task task;
+    if (!takeTask(task)) return false;
+    EXO_TRACE_SCOPE("pool.task");
+    task();
+    return true;
+}
+
+void ThreadPool::workerLoop(size_t queueIndex) {
+    currentQueue = queueIndex;
+    trace::setThreadName("worker " + std::to_string(queueIndex));
+    while (true) {
+        if (runPendingTask()) continue;
+
+        std::unique_lock<std::mutex> lock(sleepLock);
+        wake.wait(lock, [this] { return stopping || queued > 0; });
+        if (stopping) return;
+    }
+}
+
+void TaskGroup::wait() {
+    // Time spent here, minus the tasks run inline, is a join stall
+    EXO_TRACE_SCOPE("pool.wait");
+    while (pending > 0) {
+        if (!pool.runPendingTask()) std::this_thread::yield();
+    }
+    std::lock_guard<std::mutex> guard(errorLock);
+    if (error) {
+        std::exception_ptr e = error;
+        error = nullptr;
+        std::rethrow_exception(e);
+    }
+}
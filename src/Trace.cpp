@@ -0,0 +1,188 @@
+#include "../include/Trace.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace trace {
+
+namespace {
+    struct Event {
+        const char* name;
+        uint64_t beginNs;
+        uint64_t endNs;
+    };
+
+    // One ring slot, read by stop() while its owner may be rewriting it.
+    // seq is the index of the event held plus one, 0 while being written;
+    // a reader keeps what it copied only if seq reads the same before and
+    // after, so a slot caught mid-write is skipped rather than torn.
+    struct Slot {
+        std::atomic<uint64_t> seq{0};
+        std::atomic<const char*> name{nullptr};
+        std::atomic<uint64_t> beginNs{0};
+        std::atomic<uint64_t> endNs{0};
+    };
+
+    // Single-writer ring: only the owning thread stores events and bumps
+    // head; the flush reads head with acquire and the slots behind it
+    struct Ring {
+        std::unique_ptr<Slot[]> slots;
+        size_t capacity;
+        std::atomic<uint64_t> head{0}; // events ever written
+        uint64_t flushed = 0;          // events already written out; under ringsLock
+        std::string threadName;
+        size_t tid;
+
+        Ring(size_t capacity, size_t tid) : slots(new Slot[capacity]), capacity(capacity), tid(tid) {}
+
+        // Copies event i if the slot still holds it, whole
+        bool read(uint64_t i, Event& event) const {
+            const Slot& slot = slots[i % capacity];
+            uint64_t seq = slot.seq.load(std::memory_order_acquire);
+            event.name = slot.name.load(std::memory_order_relaxed);
+            event.beginNs = slot.beginNs.load(std::memory_order_relaxed);
+            event.endNs = slot.endNs.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return seq == i + 1 && slot.seq.load(std::memory_order_relaxed) == seq;
+        }
+    };
+
+    std::atomic<bool> recording{false};
+    std::chrono::steady_clock::time_point epoch;
+
+    // Rings outlive their threads so the flush still sees finished workers
+    std::mutex ringsLock;
+    std::vector<std::unique_ptr<Ring>> rings;
+    std::string outputFile;
+    size_t ringCapacity = 1 << 16;
+    bool exitHookInstalled = false;
+
+    thread_local Ring* threadRing = nullptr;
+    thread_local std::string threadLabel; // kept until the thread's ring exists
+
+    Ring& ownRing() {
+        if (!threadRing) {
+            std::lock_guard<std::mutex> guard(ringsLock);
+            rings.emplace_back(new Ring(ringCapacity, rings.size() + 1));
+            threadRing = rings.back().get();
+            threadRing->threadName = threadLabel;
+        }
+        return *threadRing;
+    }
+
+    void writeName(std::ostream& out, const std::string& name) {
+        out << '"';
+        for (char c : name) {
+            if (c == '"' || c == '\\') out << '\\';
+            out << c;
+        }
+        out << '"';
+    }
+
+    void flushAtExit() { stop(); }
+}
+
+bool start(const std::string& filename, size_t eventsPerThread) {
+    {
+        std::lock_guard<std::mutex> guard(ringsLock);
+        outputFile = filename;
+        ringCapacity = eventsPerThread ? eventsPerThread : 1;
+        epoch = std::chrono::steady_clock::now();
+        if (!exitHookInstalled) {
+            std::atexit(flushAtExit);
+            exitHookInstalled = true;
+        }
+    }
+    setThreadName("main");
+    recording.store(true, std::memory_order_release);
+    return true;
+}
+
+bool enabled() {
+    return recording.load(std::memory_order_relaxed);
+}
+
+uint64_t now() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - epoch).count());
+}
+
+void setThreadName(const std::string& name) {
+    threadLabel = name;
+    if (threadRing) {
+        std::lock_guard<std::mutex> guard(ringsLock);
+        threadRing->threadName = name;
+    }
+}
+
+void record(const char* name, uint64_t beginNs, uint64_t endNs) {
+    Ring& ring = ownRing();
+    uint64_t head = ring.head.load(std::memory_order_relaxed);
+    Slot& slot = ring.slots[head % ring.capacity];
+    slot.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.beginNs.store(beginNs, std::memory_order_relaxed);
+    slot.endNs.store(endNs, std::memory_order_relaxed);
+    slot.seq.store(head + 1, std::memory_order_release);
+    ring.head.store(head + 1, std::memory_order_release);
+}
+
+bool stop() {
+    if (!recording.exchange(false)) return true;
+
+    std::lock_guard<std::mutex> guard(ringsLock);
+    std::ofstream out(outputFile);
+    if (!out) {
+        std::cerr << "Error creating file: " << outputFile << std::endl;
+        return false;
+    }
+
+    // Timestamps in microseconds, as the format expects
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    bool first = true;
+    size_t dropped = 0;
+    for (const auto& ring : rings) {
+        if (!ring->threadName.empty()) {
+            out << (first ? "" : ",\n")
+                << "{\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": 1, \"tid\": " << ring->tid
+                << ", \"args\": {\"name\": ";
+            writeName(out, ring->threadName);
+            out << "}}";
+            first = false;
+        }
+        // Scopes opened before recording stopped may still be writing: a
+        // slot they overwrite meanwhile is counted as dropped
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        uint64_t oldest = head > ring->capacity ? head - ring->capacity : 0;
+        if (oldest < ring->flushed) oldest = ring->flushed;
+        dropped += oldest - ring->flushed;
+        for (uint64_t i = oldest; i < head; ++i) {
+            Event e;
+            if (!ring->read(i, e)) {
+                ++dropped;
+                continue;
+            }
+            out << (first ? "" : ",\n") << "{\"ph\": \"X\", \"cat\": \"exo\", \"name\": ";
+            writeName(out, e.name);
+            out << ", \"pid\": 1, \"tid\": " << ring->tid
+                << ", \"ts\": " << e.beginNs / 1000 << "." << (e.beginNs % 1000) / 100
+                << ", \"dur\": " << (e.endNs - e.beginNs) / 1000 << "." << ((e.endNs - e.beginNs) % 1000) / 100
+                << "}";
+            first = false;
+        }
+        ring->flushed = head;
+    }
+    out << "\n]}\n";
+    if (dropped) {
+        std::cerr << "Trace: " << dropped << " events dropped (ring buffers full, or overwritten while stopping)\n";
+    }
+    return static_cast<bool>(out);
+}
+
+} // namespace trace
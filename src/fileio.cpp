@@ -1,101 +1,735 @@
 #include "../include/Exoplanet.hpp"
 #include "../include/ExoplanetCatalog.hpp"
 #include "../include/fileio.hpp"
+#include "../include/algorithms/parallel.hpp"
+#include "../include/Trace.hpp"
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <vector>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <cctype>
 #include <cmath>
+#include <cstring>
+#include <charconv>
 #include <string>
+#include <utility>
 
-bool FileIO::parseCSV(const std::string& filename, ExoplanetCatalog& catalog) {
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        std::cerr << "Error opening file: " << filename << std::endl;
+namespace {
+
+// Smallest slice of the input worth parsing on its own thread
+const size_t kMinParseChunk = 1 << 20;
+
+// Bytes the read stage pages in between progress updates
+const size_t kReadBlock = 4 << 20;
+
+// Field number in the source CSV -> column decoded from it, or -1.
+struct CsvColumnMap {
+    int columnAt[64];
+    size_t maxIndex = 0;
+
+    CsvColumnMap() {
+        for (int& c : columnAt) c = -1;
+        for (size_t i = 0; i < static_cast<size_t>(Column::Count); ++i) {
+            size_t index = columnInfo(static_cast<Column>(i)).csvIndex;
+            columnAt[index] = static_cast<int>(i);
+            if (index > maxIndex) maxIndex = index;
+        }
+    }
+};
+
+const CsvColumnMap& csvColumnMap() {
+    static const CsvColumnMap map;
+    return map;
+}
+
+double parseDoubleOrNaN(const char* begin, const char* end) {
+    double value;
+    if (begin == end) return std::nan("");
+    auto result = std::from_chars(begin, end, value);
+    return result.ec == std::errc() ? value : std::nan("");
+}
+
+bool parseInt(const char* begin, const char* end, int& value) {
+    auto result = std::from_chars(begin, end, value);
+    return result.ec == std::errc();
+}
+
+// Rows formatted per task when writing a CSV
+const size_t kWriteChunkRows = 8192;
+
+// Number formatting for export: the same text operator<< gives by
+// default (%g, six significant digits), without the stream overhead
+void appendNumber(std::string& out, double value) {
+    char text[32];
+    auto result = std::to_chars(text, text + sizeof(text), value, std::chars_format::general, 6);
+    out.append(text, result.ptr);
+}
+
+void appendNumber(std::string& out, int value) {
+    char text[16];
+    auto result = std::to_chars(text, text + sizeof(text), value);
+    out.append(text, result.ptr);
+}
+
+void appendCsvRow(std::string& out, const Exoplanet& planet) {
+    appendNumber(out, planet.rowid);
+    out += ',';
+    appendNumber(out, planet.kepid);
+    out += ',';
+    out += planet.kepoi_name;
+    out += ',';
+    out += planet.kepler_name;
+    out += ',';
+    out += planet.koi_disposition;
+    out += ',';
+    out += planet.koi_pdisposition;
+    out += ',';
+    appendNumber(out, planet.koi_score);
+    for (bool flag : {planet.koi_fpflag_nt, planet.koi_fpflag_ss, planet.koi_fpflag_co, planet.koi_fpflag_ec}) {
+        out += ',';
+        out += flag ? '1' : '0';
+    }
+    for (double value : {planet.koi_period, planet.koi_impact, planet.koi_duration, planet.koi_depth,
+                         planet.koi_prad, planet.koi_teq, planet.koi_insol}) {
+        out += ',';
+        appendNumber(out, value);
+    }
+    out += '\n';
+}
+
+// Strict field parsers: the whole field must be the value
+FieldError parseIntField(const char* begin, const char* end, int& value) {
+    auto result = std::from_chars(begin, end, value);
+    if (result.ec == std::errc::result_out_of_range) return FieldError::OutOfRange;
+    return result.ec == std::errc() && result.ptr == end ? FieldError::None : FieldError::NotInteger;
+}
+
+FieldError parseNumberField(const char* begin, const char* end, double& value) {
+    if (begin == end) {
+        value = std::nan("");
+        return FieldError::None;
+    }
+    auto result = std::from_chars(begin, end, value);
+    if (result.ec == std::errc() && result.ptr == end) return FieldError::None;
+    value = std::nan("");
+    return result.ec == std::errc::result_out_of_range ? FieldError::OutOfRange : FieldError::NotNumber;
+}
+
+// parseNumberField's verdict without converting: the same grammar as
+// from_chars (optional '-', digits with an optional point and exponent,
+// or inf, infinity, nan, nan(...)). Only a value whose decimal magnitude
+// is near the limits of a double is converted, to tell overflow apart.
+FieldError scanNumberField(const char* begin, const char* end) {
+    const char* p = begin;
+    if (p == end) return FieldError::None;
+    if (*p == '-') ++p;
+
+    auto word = [&p, end](const char* text) {
+        size_t n = std::strlen(text);
+        if (static_cast<size_t>(end - p) < n) return false;
+        for (size_t i = 0; i < n; ++i) {
+            if ((p[i] | 0x20) != text[i]) return false;
+        }
+        p += n;
+        return true;
+    };
+    bool spelled = p != end && (*p | 0x20) >= 'a' && (*p | 0x20) <= 'z';
+    if (spelled && word("inf")) {
+        if (p != end) word("inity");
+        return p == end ? FieldError::None : FieldError::NotNumber;
+    }
+    if (spelled && word("nan")) {
+        if (p == end) return FieldError::None;
+        if (*p++ != '(' || end[-1] != ')') return FieldError::NotNumber;
+        for (; p < end - 1; ++p) {
+            if (!std::isalnum(static_cast<unsigned char>(*p)) && *p != '_') return FieldError::NotNumber;
+        }
+        return FieldError::None;
+    }
+
+    // Decimal position of the first significant digit, relative to the point
+    long magnitude = 0;
+    bool digits = false, significant = false;
+    for (; p != end && *p >= '0' && *p <= '9'; ++p) {
+        digits = true;
+        significant = significant || *p != '0';
+        if (significant) ++magnitude;
+    }
+    if (p != end && *p == '.') {
+        for (++p; p != end && *p >= '0' && *p <= '9'; ++p) {
+            digits = true;
+            if (!significant) {
+                significant = *p != '0';
+                --magnitude;
+            }
+        }
+    }
+    if (!digits) return FieldError::NotNumber;
+    if (p != end && (*p == 'e' || *p == 'E')) {
+        // An exponent without digits is not part of the number
+        const char* q = p + 1;
+        bool negative = q != end && *q == '-';
+        if (q != end && (*q == '-' || *q == '+')) ++q;
+        long exponent = 0;
+        const char* exponentDigits = q;
+        for (; q != end && *q >= '0' && *q <= '9'; ++q) {
+            if (exponent < 100000) exponent = exponent * 10 + (*q - '0');
+        }
+        if (q != exponentDigits) {
+            magnitude += negative ? -exponent : exponent;
+            p = q;
+        }
+    }
+    // from_chars reports a number out of range ahead of text after it
+    if (significant && !(magnitude > -300 && magnitude < 300)) {
+        double value;
+        return parseNumberField(begin, end, value);
+    }
+    return p == end ? FieldError::None : FieldError::NotNumber;
+}
+
+// Flags: empty is unset
+FieldError parseFlagField(const char* begin, const char* end, bool& flag) {
+    int value = 0;
+    FieldError error = begin == end ? FieldError::None : parseIntField(begin, end, value);
+    flag = value != 0;
+    return error;
+}
+
+// Decodes one raw field into the planet. A numeric field that does not
+// parse is left missing, and reported.
+FieldError decodeField(Column column, const char* begin, const char* end, Exoplanet& planet) {
+    if (end > begin && end[-1] == '\r') --end;
+
+    const ColumnInfo& info = columnInfo(column);
+    if (info.field) return parseNumberField(begin, end, planet.*info.field);
+
+    switch (column) {
+        case Column::RowId: return parseIntField(begin, end, planet.rowid);
+        case Column::KepId: return parseIntField(begin, end, planet.kepid);
+        case Column::KepoiName: planet.kepoi_name.assign(begin, end); break;
+        case Column::KeplerName: planet.kepler_name.assign(begin, end); break;
+        case Column::Disposition: planet.koi_disposition.assign(begin, end); break;
+        case Column::PDisposition: planet.koi_pdisposition.assign(begin, end); break;
+        case Column::FpFlagNt: return parseFlagField(begin, end, planet.koi_fpflag_nt);
+        case Column::FpFlagSs: return parseFlagField(begin, end, planet.koi_fpflag_ss);
+        case Column::FpFlagCo: return parseFlagField(begin, end, planet.koi_fpflag_co);
+        case Column::FpFlagEc: return parseFlagField(begin, end, planet.koi_fpflag_ec);
+        default: break;
+    }
+    return FieldError::None;
+}
+
+// decodeField for a column that is not wanted yet: whether the field
+// would decode, without keeping the value
+FieldError checkField(Column column, const char* begin, const char* end) {
+    if (end > begin && end[-1] == '\r') --end;
+    if (textField(column)) return FieldError::None;
+    if (columnInfo(column).field) return scanNumberField(begin, end);
+    if (flagField(column)) {
+        bool flag;
+        return parseFlagField(begin, end, flag);
+    }
+    int value;
+    return parseIntField(begin, end, value);
+}
+
+// Fields up to koi_insol must be present; the stellar fields after it are
+// absent from older exports
+const size_t kLastRequiredField = 30;
+
+// Outcome of decoding a line: the first field that failed, if any
+struct LineStatus {
+    FieldError error = FieldError::None;
+    Column column = Column::Count;
+};
+
+// Walks the fields of one line, decoding those selected by `columns` and
+// checking those in `checked` (a superset) without keeping them, and
+// reports the first checked field that failed or is missing. Fields after
+// a failure are still decoded.
+LineStatus decodeLine(const char* line, const char* lineEnd, ColumnMask columns, Exoplanet& planet,
+                      ColumnMask checked = 0) {
+    const CsvColumnMap& map = csvColumnMap();
+    ColumnMask seen = 0;
+    LineStatus status;
+    const char* field = line;
+    checked |= columns;
+
+    for (size_t index = 0; index <= map.maxIndex; ++index) {
+        const char* comma = static_cast<const char*>(std::memchr(field, ',', lineEnd - field));
+        const char* fieldEnd = comma ? comma : lineEnd;
+
+        int column = map.columnAt[index];
+        if (column >= 0 && (checked & columnBit(static_cast<Column>(column)))) {
+            Column at = static_cast<Column>(column);
+            FieldError error = columns & columnBit(at) ? decodeField(at, field, fieldEnd, planet)
+                                                       : checkField(at, field, fieldEnd);
+            if (error != FieldError::None && status.error == FieldError::None) {
+                status.error = error;
+                status.column = at;
+            }
+            seen |= columnBit(at);
+            if (seen == checked) break;
+        }
+
+        if (!comma) break;
+        field = comma + 1;
+    }
+
+    if (status.error == FieldError::None && seen != checked) {
+        for (size_t c = 0; c < static_cast<size_t>(Column::Count); ++c) {
+            Column column = static_cast<Column>(c);
+            if ((checked & ~seen & columnBit(column)) && columnInfo(column).csvIndex <= kLastRequiredField) {
+                status.error = FieldError::Missing;
+                status.column = column;
+                break;
+            }
+        }
+    }
+    return status;
+}
+
+// A row the loaders turned away, pointing into the source text
+struct RejectedRow {
+    size_t line; // 1-based line number in the file
+    LineStatus status;
+    const char* text;
+    const char* textEnd;
+};
+
+// Writes rejected rows to the quarantine file through one buffer
+class QuarantineWriter {
+public:
+    static const size_t kFlushBytes = 1 << 16;
+
+    bool open(const std::string& filename) {
+        out.open(filename);
+        if (!out) {
+            std::cerr << "Error creating file: " << filename << std::endl;
+            return false;
+        }
+        buffer = "line,column,reason,row\n";
+        return true;
+    }
+
+    void add(const RejectedRow& row) {
+        appendNumber(buffer, static_cast<int>(row.line));
+        buffer += ',';
+        buffer += columnInfo(row.status.column).name;
+        buffer += ',';
+        buffer += fieldErrorName(row.status.error);
+        buffer += ',';
+        const char* end = row.textEnd;
+        if (end > row.text && end[-1] == '\r') --end;
+        buffer.append(row.text, end);
+        buffer += '\n';
+        if (buffer.size() >= kFlushBytes) flush();
+    }
+
+    bool close() {
+        flush();
+        out.close();
+        return static_cast<bool>(out);
+    }
+
+private:
+    std::ofstream out;
+    std::string buffer;
+
+    void flush() {
+        out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        buffer.clear();
+    }
+};
+
+// Rejected rows shown on stderr when there is no quarantine file
+const size_t kRejectsShown = 5;
+
+// Quarantines and reports the rejected rows of a load, fills in summary,
+// and says whether the load may go ahead under the policy
+bool settleRejects(size_t accepted, const DynamicArray<RejectedRow>& rejects,
+                   const ParsePolicy& policy, ParseSummary* summary) {
+    ParseSummary counts;
+    counts.accepted = accepted;
+    counts.rejected = rejects.size();
+    for (const auto& row : rejects) ++counts.byError[static_cast<size_t>(row.status.error)];
+    if (summary) *summary = counts;
+    EXO_STATS_COUNT("parse.rows_accepted", accepted);
+    EXO_STATS_COUNT("parse.rows_rejected", rejects.size());
+
+    bool quarantined = false;
+    if (!policy.quarantineFile.empty()) {
+        QuarantineWriter writer;
+        quarantined = writer.open(policy.quarantineFile);
+        if (quarantined) {
+            for (const auto& row : rejects) writer.add(row);
+            quarantined = writer.close();
+        }
+        if (!quarantined) std::cerr << "Could not write " << policy.quarantineFile << std::endl;
+    }
+    if (rejects.empty()) return true;
+
+    std::cerr << "Rejected " << counts.rejected << " of " << counts.accepted + counts.rejected
+              << " rows:";
+    const char* separator = " ";
+    for (size_t e = 1; e < static_cast<size_t>(FieldError::Count); ++e) {
+        if (!counts.byError[e]) continue;
+        std::cerr << separator << counts.byError[e] << " " << fieldErrorName(static_cast<FieldError>(e));
+        separator = ", ";
+    }
+    std::cerr << "\n";
+    if (quarantined) {
+        std::cerr << "Quarantined them in " << policy.quarantineFile << "\n";
+    } else {
+        for (size_t i = 0; i < rejects.size() && i < kRejectsShown; ++i) {
+            const RejectedRow& row = rejects[i];
+            std::cerr << "  line " << row.line << ", " << columnInfo(row.status.column).name << ": "
+                      << fieldErrorName(row.status.error) << "\n";
+        }
+    }
+
+    if (!counts.withinLimits(policy)) {
+        std::cerr << "Too many rejected rows (limit ";
+        if (policy.maxRejectedRows != SIZE_MAX) std::cerr << policy.maxRejectedRows << " rows";
+        if (policy.maxRejectedRows != SIZE_MAX && policy.maxRejectedFraction < 1.0) std::cerr << ", ";
+        if (policy.maxRejectedFraction < 1.0) std::cerr << policy.maxRejectedFraction * 100 << "%";
+        std::cerr << "); nothing loaded" << std::endl;
         return false;
     }
+    return true;
+}
 
-    std::string line;
-    // Skip header lines
-    if (!std::getline(file, line)) return false; // Skip header
-    if (!std::getline(file, line)) return false; // Skip titles
+const char* lineEndOf(const char* p, const char* end) {
+    const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    return nl ? nl : end;
+}
 
-    while (std::getline(file, line)) {
-        std::stringstream ss(line);
-        std::string token;
-        Exoplanet planet = {};
+// One block of the input and the rows parsed from it
+struct ParsedChunk {
+    DynamicArray<Exoplanet> planets;
+    DynamicArray<RejectedRow> rejects; // line numbers within the chunk
+    size_t lines = 0;
+    std::string text; // the block, when it is not in the mapped file
+};
 
-        try {
-            // Read and assign fields with proper error checking
-            if (!std::getline(ss, token, ',')) continue;
-            planet.rowid = std::stoi(token);
+void parseChunk(ParsedChunk& chunk, const char* p, const char* cut) {
+    EXO_PHASE("load.parse_chunk");
+    size_t stringBytes = 0;
+    for (const char* q = p; q < cut; ++chunk.lines) {
+        const char* lineEnd = lineEndOf(q, cut);
+        if (lineEnd > q && !(lineEnd == q + 1 && *q == '\r')) {
+            Exoplanet planet = blankPlanet();
+            LineStatus status = decodeLine(q, lineEnd, kAllColumns, planet);
+            if (status.error == FieldError::None) {
+                stringBytes += planet.kepoi_name.size() + planet.kepler_name.size()
+                             + planet.koi_disposition.size() + planet.koi_pdisposition.size();
+                chunk.planets.push_back(std::move(planet));
+            } else {
+                chunk.rejects.push_back(RejectedRow{chunk.lines, status, q, lineEnd});
+            }
+        }
+        q = lineEnd + 1;
+    }
+    EXO_STATS_COUNT("parse.string_bytes", stringBytes);
+}
+
+// Settles the rejects of all chunks and, if they are within the policy,
+// appends the rows in order
+bool appendChunks(std::deque<ParsedChunk>& chunks, ExoplanetCatalog& catalog,
+                  const ParsePolicy& policy, ParseSummary* summary) {
+    // Number the rejects from the top of the file, past the two header lines
+    DynamicArray<RejectedRow> rejects;
+    size_t accepted = 0, firstLine = 3;
+    for (auto& chunk : chunks) {
+        for (auto row : chunk.rejects) {
+            row.line += firstLine;
+            rejects.push_back(row);
+        }
+        firstLine += chunk.lines;
+        accepted += chunk.planets.size();
+    }
+    if (!settleRejects(accepted, rejects, policy, summary)) return false;
+
+    EXO_PHASE("load.append_rows");
+    for (auto& chunk : chunks) {
+        for (auto& planet : chunk.planets) catalog.addPlanet(std::move(planet));
+    }
+    return true;
+}
+
+// A helper thread feeding one load stage. It is stopped and joined when
+// the stage ends, on an early return or an exception as well, so an
+// unwinding parse never destroys a joinable std::thread. stop tells the
+// body to wind down, and must wake it wherever it may be waiting.
+class StageThread {
+public:
+    template <typename Body, typename Stop>
+    StageThread(Body body, Stop stop) : stop(stop), thread(body) {}
+    ~StageThread() { finish(); }
 
-            if (!std::getline(ss, token, ',')) continue;
-            planet.kepid = std::stoi(token);
+    StageThread(const StageThread&) = delete;
+    StageThread& operator=(const StageThread&) = delete;
 
-            if (!std::getline(ss, token, ',')) continue;
-            planet.kepoi_name = token;
+    // Waits for the body to run out; call once the stage has taken all it needs
+    void join() {
+        if (thread.joinable()) thread.join();
+    }
+
+private:
+    std::function<void()> stop;
+    std::thread thread;
 
-            if (!std::getline(ss, token, ',')) continue;
-            planet.kepler_name = token;
+    void finish() {
+        if (!thread.joinable()) return;
+        stop();
+        thread.join();
+    }
+};
 
-            if (!std::getline(ss, token, ',')) continue;
-            planet.koi_disposition = token;
+// Decompressed blocks waiting for the parse, at most this many per worker
+const size_t kQueuedBlocksPerWorker = 2;
 
-            if (!std::getline(ss, token, ',')) continue;
-            planet.koi_pdisposition = token;
+// Parses a gzip or zstd file into chunks. A decompression thread turns
+// the mapped file into blocks cut at line ends, this thread takes them in
+// order, and the pool parses them, as with plain input; the queue between
+// the first two is bounded, so decompressed text is held only until it is
+// parsed. Progress counts compressed bytes.
+bool parseCompressed(const MappedFile& file, Compression compression,
+                     std::deque<ParsedChunk>& chunks, LoadProgress* progress) {
+    struct Block {
+        std::string text;
+        size_t consumed; // compressed bytes read once it was out
+    };
+    std::mutex queueLock;
+    std::condition_variable queueChanged;
+    std::deque<Block> queue;
+    bool finished = false;
+    bool stopping = false; // the parse gave up; drop what is left
+    std::string error;
+    size_t queueLimit = algo::worker_count() * kQueuedBlocksPerWorker;
 
-            if (!std::getline(ss, token, ',')) continue;
-            planet.koi_score = token.empty() ? std::nan("") : std::stod(token);
+    StageThread decompressor([&] {
+        EXO_TRACE_SCOPE("load.decompress");
+        std::string failure;
+        try {
+            CompressedReader reader(file.data(), file.size(), compression);
+            // False once the parse has stopped taking blocks
+            auto hand = [&](std::string text) {
+                std::unique_lock<std::mutex> guard(queueLock);
+                queueChanged.wait(guard, [&] { return queue.size() < queueLimit || stopping; });
+                if (stopping) return false;
+                queue.push_back(Block{std::move(text), reader.consumed()});
+                queueChanged.notify_all();
+                return true;
+            };
 
-            // Read flags
-            for (int i = 0; i < 4; i++) {
-                if (!std::getline(ss, token, ',')) break;
-                int val = token.empty() ? 0 : std::stoi(token);
-                switch (i) {
-                    case 0: planet.koi_fpflag_nt = val; break;
-                    case 1: planet.koi_fpflag_ss = val; break;
-                    case 2: planet.koi_fpflag_co = val; break;
-                    case 3: planet.koi_fpflag_ec = val; break;
+            // A block ends at its last line end; the rest starts the next one
+            std::string carry;
+            DynamicArray<std::string> blocks;
+            bool taking = true;
+            while (taking && reader.read(blocks)) {
+                for (auto& text : blocks) {
+                    text.insert(0, carry);
+                    size_t last = text.rfind('\n');
+                    if (last == std::string::npos) {
+                        carry = std::move(text);
+                        continue;
+                    }
+                    carry.assign(text, last + 1, std::string::npos);
+                    text.resize(last + 1);
+                    if (!(taking = hand(std::move(text)))) break;
                 }
+                blocks = DynamicArray<std::string>();
+                if (progress) progress->readBytes = reader.consumed();
             }
-
-            // Read remaining fields with proper error handling
-            #define READ_DOUBLE_FIELD(field) \
-                if (!std::getline(ss, token, ',')) continue; \
-                field = token.empty() ? std::nan("") : std::stod(token);
-
-            READ_DOUBLE_FIELD(planet.koi_period);
-            
-            // Skip unused columns
-            for (int i = 0; i < 5; i++) std::getline(ss, token, ',');
-            
-            READ_DOUBLE_FIELD(planet.koi_impact);
-            for (int i = 0; i < 2; i++) std::getline(ss, token, ',');
-            READ_DOUBLE_FIELD(planet.koi_duration);
-            for (int i = 0; i < 2; i++) std::getline(ss, token, ',');
-            READ_DOUBLE_FIELD(planet.koi_depth);
-            for (int i = 0; i < 2; i++) std::getline(ss, token, ',');
-            READ_DOUBLE_FIELD(planet.koi_prad);
-            for (int i = 0; i < 2; i++) std::getline(ss, token, ',');
-            READ_DOUBLE_FIELD(planet.koi_teq);
-            READ_DOUBLE_FIELD(planet.koi_insol);
-
-            // Skip remaining columns
-            for (int i = 0; i < 17; i++) std::getline(ss, token, ',');
-
-            catalog.addPlanet(planet);
+            if (taking && !carry.empty()) hand(std::move(carry));
+            failure = reader.error();
         } catch (const std::exception& e) {
-            std::cerr << "Error parsing line: " << line << "\nError: " << e.what() << std::endl;
-            continue;
+            failure = e.what();
+        }
+
+        std::lock_guard<std::mutex> guard(queueLock);
+        finished = true;
+        error = failure;
+        queueChanged.notify_all();
+    }, [&] {
+        std::lock_guard<std::mutex> guard(queueLock);
+        stopping = true;
+        queueChanged.notify_all();
+    });
+
+    size_t headerLines = 2, parsedUpTo = 0;
+    {
+        TaskGroup group;
+        for (;;) {
+            Block block;
+            {
+                std::unique_lock<std::mutex> guard(queueLock);
+                queueChanged.wait(guard, [&] { return !queue.empty() || finished; });
+                if (queue.empty()) break;
+                block = std::move(queue.front());
+                queue.pop_front();
+                queueChanged.notify_all();
+            }
+            size_t compressed = block.consumed - parsedUpTo;
+            parsedUpTo = block.consumed;
+
+            // Skip header and titles, in whichever blocks they fall
+            size_t skip = 0;
+            for (; headerLines > 0 && skip < block.text.size(); --headerLines) {
+                size_t nl = block.text.find('\n', skip);
+                skip = nl == std::string::npos ? block.text.size() : nl + 1;
+            }
+            if (skip == block.text.size()) {
+                if (progress) progress->parsedBytes += compressed;
+                continue;
+            }
+
+            chunks.emplace_back();
+            ParsedChunk& chunk = chunks.back();
+            chunk.text = std::move(block.text);
+            const char* begin = chunk.text.data() + skip;
+            const char* end = chunk.text.data() + chunk.text.size();
+            group.run([&chunk, begin, end, compressed, progress] {
+                parseChunk(chunk, begin, end);
+                if (progress) progress->parsedBytes += compressed;
+            });
         }
+        group.wait();
+    }
+    decompressor.join();
+    if (!error.empty()) {
+        std::cerr << "Cannot decompress " << compressionName(compression) << " input: " << error << std::endl;
+        return false;
     }
+    if (progress) progress->parsedBytes = file.size();
+    return headerLines == 0;
+}
 
-    file.close();
-    return true;
+} // namespace
+
+const char* fieldErrorName(FieldError error) {
+    switch (error) {
+        case FieldError::None: return "ok";
+        case FieldError::Missing: return "missing field";
+        case FieldError::NotInteger: return "not an integer";
+        case FieldError::NotNumber: return "not a number";
+        case FieldError::OutOfRange: return "out of range";
+        default: return "unknown";
+    }
+}
+
+bool ParseSummary::withinLimits(const ParsePolicy& policy) const {
+    if (rejected > policy.maxRejectedRows) return false;
+    size_t total = accepted + rejected;
+    return total == 0 || static_cast<double>(rejected) <= policy.maxRejectedFraction * static_cast<double>(total);
+}
+
+bool FileIO::parseCSV(const std::string& filename, ExoplanetCatalog& catalog, LoadProgress* progress,
+                      const ParsePolicy& policy, ParseSummary* summary) {
+    EXO_PHASE("load.parse_csv");
+    MappedFile file;
+    if (!file.open(filename, false)) return false; // the read stage pages it in
+    EXO_STATS_COUNT("io.bytes_read", file.size());
+    size_t size = file.size();
+    if (progress) progress->totalBytes = size;
+
+    std::deque<ParsedChunk> chunks; // grows at the back; references stay valid
+    Compression compression = detectCompression(file.data(), size);
+    if (compression != Compression::None) {
+        if (!parseCompressed(file, compression, chunks, progress)) {
+            std::cerr << "Error reading " << filename << std::endl;
+            return false;
+        }
+        return appendChunks(chunks, catalog, policy, summary);
+    }
+
+    // Three stages run at once: a reader thread pages the file in ahead of
+    // the parse, this thread cuts what has been read into blocks at line
+    // boundaries, and the pool parses the blocks
+    std::mutex readLock;
+    std::condition_variable readMore;
+    size_t readBytes = 0;
+    std::atomic<bool> stopReading{false}; // the parse ended early; stop paging in
+    StageThread reader([&] {
+        EXO_TRACE_SCOPE("load.read");
+        for (size_t offset = 0; offset < size && !stopReading.load(std::memory_order_relaxed);
+             offset += kReadBlock) {
+            file.prefetch(offset, kReadBlock);
+            size_t done = offset + kReadBlock < size ? offset + kReadBlock : size;
+            {
+                std::lock_guard<std::mutex> guard(readLock);
+                readBytes = done;
+            }
+            readMore.notify_all();
+            if (progress) progress->readBytes = done;
+        }
+    }, [&] { stopReading.store(true, std::memory_order_relaxed); });
+    auto waitForRead = [&](const char* upTo) {
+        size_t needed = static_cast<size_t>(upTo - file.data());
+        std::unique_lock<std::mutex> guard(readLock);
+        readMore.wait(guard, [&] { return readBytes >= needed || readBytes == size; });
+    };
+
+    const char* p = file.data();
+    const char* end = p + size;
+    waitForRead(end - p < static_cast<std::ptrdiff_t>(kReadBlock) ? end : p + kReadBlock);
+    // Skip header and titles
+    bool valid = true;
+    for (int i = 0; i < 2 && valid; ++i) {
+        const char* nl = lineEndOf(p, end);
+        valid = nl != end;
+        p = nl + 1;
+    }
+
+    {
+        TaskGroup group;
+        while (valid && p < end) {
+            const char* cut = end - p > static_cast<std::ptrdiff_t>(kMinParseChunk) ? p + kMinParseChunk : end;
+            waitForRead(cut);
+            if (cut < end) {
+                const char* next = lineEndOf(cut, end);
+                cut = next < end ? next + 1 : end;
+            }
+            chunks.emplace_back();
+            ParsedChunk& chunk = chunks.back();
+            group.run([&chunk, p, cut, progress] {
+                parseChunk(chunk, p, cut);
+                if (progress) progress->parsedBytes += static_cast<size_t>(cut - p);
+            });
+            p = cut;
+        }
+        group.wait();
+    }
+    if (!valid) return false; // stops the reader rather than paging in the rest
+    reader.join();
+    if (progress) progress->parsedBytes = size;
+    return appendChunks(chunks, catalog, policy, summary);
+}
+
+Compression FileIO::compressionOf(const std::string& filename) {
+    char magic[4] = {};
+    std::ifstream file(filename, std::ios::binary);
+    file.read(magic, sizeof(magic));
+    return detectCompression(magic, static_cast<size_t>(file.gcount()));
 }
 
 bool FileIO::writeCSV(const std::string& filename, const DynamicArray<Exoplanet>& planets) {
+    DynamicArray<size_t> rows(planets.size());
+    for (size_t i = 0; i < planets.size(); ++i) rows[i] = i;
+    return writeCSV(filename, planets, rows);
+}
+
+bool FileIO::writeCSV(const std::string& filename, const DynamicArray<Exoplanet>& planets,
+                      const DynamicArray<size_t>& rows) {
+    EXO_PHASE("export.write_csv");
     std::ofstream file(filename);
     if (!file.is_open()) {
         std::cerr << "Error creating file: " << filename << std::endl;
@@ -107,28 +741,168 @@ bool FileIO::writeCSV(const std::string& filename, const DynamicArray<Exoplanet>
          << "koi_score,koi_fpflag_nt,koi_fpflag_ss,koi_fpflag_co,koi_fpflag_ec,"
          << "koi_period,koi_impact,koi_duration,koi_depth,koi_prad,koi_teq,koi_insol\n";
 
-    // Write data
-    for (const auto& planet : planets) {
-        file << planet.rowid << ","
-             << planet.kepid << ","
-             << planet.kepoi_name << ","
-             << planet.kepler_name << ","
-             << planet.koi_disposition << ","
-             << planet.koi_pdisposition << ","
-             << planet.koi_score << ","
-             << planet.koi_fpflag_nt << ","
-             << planet.koi_fpflag_ss << ","
-             << planet.koi_fpflag_co << ","
-             << planet.koi_fpflag_ec << ","
-             << planet.koi_period << ","
-             << planet.koi_impact << ","
-             << planet.koi_duration << ","
-             << planet.koi_depth << ","
-             << planet.koi_prad << ","
-             << planet.koi_teq << ","
-             << planet.koi_insol << "\n";
+    // Format chunks of rows in parallel, a window at a time, and write
+    // them in order
+    size_t chunkCount = (rows.size() + kWriteChunkRows - 1) / kWriteChunkRows;
+    size_t window = algo::worker_count() * 4;
+    std::vector<std::string> text(window);
+    for (size_t first = 0; first < chunkCount; first += window) {
+        size_t last = first + window < chunkCount ? first + window : chunkCount;
+        algo::parallel_for(last - first, 1, [&](size_t begin, size_t end) {
+            for (size_t c = begin; c < end; ++c) {
+                std::string& out = text[c];
+                out.clear();
+                size_t rowEnd = (first + c + 1) * kWriteChunkRows;
+                if (rowEnd > rows.size()) rowEnd = rows.size();
+                for (size_t i = (first + c) * kWriteChunkRows; i < rowEnd; ++i) {
+                    appendCsvRow(out, planets[rows[i]]);
+                }
+            }
+        });
+        for (size_t c = 0; c < last - first; ++c) {
+            file.write(text[c].data(), static_cast<std::streamsize>(text[c].size()));
+        }
     }
 
+    EXO_STATS_COUNT("io.bytes_written", static_cast<uint64_t>(file.tellp()));
     file.close();
     return true;
+}
+
+bool FileIO::parseStellarCSV(const std::string& filename,
+                             const DynamicArray<std::string>& wanted, StellarTable& table) {
+    EXO_PHASE("load.parse_stellar_csv");
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        std::cerr << "Error opening file: " << filename << std::endl;
+        return false;
+    }
+
+    // Header: skip '#' comment lines, as in NASA archive exports
+    std::string line, token;
+    do {
+        if (!std::getline(file, line)) return false;
+    } while (!line.empty() && line[0] == '#');
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+
+    // Field number -> slot in table.columns, -1 for unused fields
+    DynamicArray<int> slotOf;
+    int kepidField = -1;
+    std::stringstream header(line);
+    while (std::getline(header, token, ',')) {
+        int slot = -1;
+        if (token == "kepid") {
+            kepidField = static_cast<int>(slotOf.size());
+        } else {
+            for (const auto& name : wanted) {
+                if (token == name) {
+                    slot = static_cast<int>(table.columns.size());
+                    table.columns.push_back(token);
+                    break;
+                }
+            }
+        }
+        slotOf.push_back(slot);
+    }
+    if (kepidField < 0) {
+        std::cerr << "No kepid column in " << filename << std::endl;
+        return false;
+    }
+
+    size_t width = table.columns.size();
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') continue;
+
+        const char* p = line.data();
+        const char* end = p + line.size();
+        if (end > p && end[-1] == '\r') --end;
+
+        int kepid = 0;
+        bool hasKepid = false;
+        size_t rowStart = table.values.size();
+        for (size_t i = 0; i < width; ++i) table.values.push_back(std::nan(""));
+
+        for (size_t field = 0; field < slotOf.size(); ++field) {
+            const char* comma = static_cast<const char*>(std::memchr(p, ',', end - p));
+            const char* fieldEnd = comma ? comma : end;
+            if (static_cast<int>(field) == kepidField) {
+                hasKepid = parseInt(p, fieldEnd, kepid);
+            } else if (slotOf[field] >= 0) {
+                table.values[rowStart + slotOf[field]] = parseDoubleOrNaN(p, fieldEnd);
+            }
+            if (!comma) break;
+            p = comma + 1;
+        }
+
+        if (hasKepid) {
+            table.kepids.push_back(kepid);
+        } else {
+            for (size_t i = 0; i < width; ++i) table.values.pop_back();
+        }
+    }
+    return true;
+}
+
+bool FileIO::indexCSV(const MappedFile& file, ColumnMask columns,
+                      ExoplanetCatalog& catalog, DynamicArray<size_t>& rowOffsets,
+                      const ParsePolicy& policy, ParseSummary* summary) {
+    EXO_PHASE("load.index_csv");
+    EXO_STATS_COUNT("io.bytes_read", file.size());
+    const char* begin = file.data();
+    const char* end = begin + file.size();
+    const char* p = begin;
+
+    // Skip header and titles, like parseCSV
+    for (int i = 0; i < 2; ++i) {
+        const char* nl = lineEndOf(p, end);
+        if (nl == end) return false;
+        p = nl + 1;
+    }
+
+    // Rows are held back until the rejects are known to be within limits,
+    // in arrays sized by a line count so that rows are moved once
+    size_t lines = 0;
+    for (const char* q = p; q < end; q = lineEndOf(q, end) + 1) ++lines;
+    DynamicArray<Exoplanet> planets;
+    DynamicArray<size_t> offsets;
+    planets.reserve(lines);
+    offsets.reserve(lines);
+    DynamicArray<RejectedRow> rejects;
+    for (size_t line = 3; p < end; ++line) {
+        const char* lineEnd = lineEndOf(p, end);
+        if (lineEnd > p && !(lineEnd == p + 1 && *p == '\r')) {
+            // Columns not decoded yet read as missing until materialized.
+            // Every field is checked, as parseCSV decodes them all, so both
+            // loads turn away the same rows for the same reasons.
+            Exoplanet planet = blankPlanet();
+            LineStatus status = decodeLine(p, lineEnd, columns, planet, kAllColumns);
+            if (status.error == FieldError::None) {
+                planets.push_back(std::move(planet));
+                offsets.push_back(static_cast<size_t>(p - begin));
+            } else {
+                rejects.push_back(RejectedRow{line, status, p, lineEnd});
+            }
+        }
+        p = lineEnd + 1;
+    }
+    if (!settleRejects(planets.size(), rejects, policy, summary)) return false;
+
+    for (size_t i = 0; i < planets.size(); ++i) {
+        catalog.addPlanet(std::move(planets.data[i]));
+        rowOffsets.push_back(offsets.data[i]);
+    }
+    return true;
+}
+
+void FileIO::decodeColumns(const MappedFile& file, const DynamicArray<size_t>& rowOffsets,
+                           ColumnMask columns, DynamicArray<Exoplanet>& planets,
+                           size_t firstRow) {
+    EXO_PHASE("load.decode_columns");
+    const char* begin = file.data();
+    const char* end = begin + file.size();
+
+    for (size_t i = 0; i < rowOffsets.size(); ++i) {
+        const char* line = begin + rowOffsets[i];
+        decodeLine(line, lineEndOf(line, end), columns, planets[firstRow + i]);
+    }
 }
\ No newline at end of file
@@ -1,8 +1,134 @@
 // src/main.cpp
 #include "MainMenu.hpp"
+#include "../include/QueryServer.hpp"
+#include "../include/ThreadPool.hpp"
+#include "../include/Stats.hpp"
+#include "../include/Trace.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
 
-int main() {
-    MainMenu menu;
-    menu.run();
-    return 0;
-}
\ No newline at end of file
+static void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [--lazy] [--stellar=FILE] [--merge=FILE]... [--prefer=MODE]\n"
+              << "       [--drop-missing] [--result-cache=MB] [--compact] [--quarantine=FILE]\n"
+              << "       [--max-rejects=N|P%] [--threads=N] [--stats[=FILE]] [--trace=FILE]\n"
+              << "       [--serve[=SOCKET] | --batch=MANIFEST]\n"
+              << "  --lazy          decode rarely used columns on first use\n"
+              << "  --stellar=FILE  join a host-star CSV on kepid after loading\n"
+              << "  --merge=FILE    merge a release into the catalog by kepoi_name after loading\n"
+              << "  --prefer=MODE   for planets that differ: incoming (default), existing, or fill\n"
+              << "                  (keep existing values, filling missing ones from the release)\n"
+              << "  --drop-missing  remove planets a merged release does not have\n"
+              << "  --result-cache=MB memory for repeated query results (default "
+              << (ExoplanetCatalog::kDefaultResultCacheBytes >> 20) << "; 0 disables)\n"
+              << "  --compact       scan float32 / 16-bit copies of radius, temperature, period and\n"
+              << "                  insolation (see ExoplanetCatalog::setCompactMode for the error)\n"
+              << "  --quarantine=FILE write rows that do not parse to FILE, with line, column and reason\n"
+              << "  --max-rejects=N|P% fail the load, adding nothing, if more than N rows or P percent\n"
+              << "                  of the rows do not parse (default: load whatever parses)\n"
+              << "  --threads=N     worker threads (default: CPUs allowed by affinity and cgroup)\n"
+              << "  --stats[=FILE]  on exit, print timers and counters, or write them to FILE as JSON\n"
+              << "                  (needs a build with make STATS=1)\n"
+              << "  --trace=FILE    record a Chrome/Perfetto trace-event timeline to FILE\n"
+              << "  --serve[=SOCKET] answer queries on a Unix socket instead of showing the menu\n"
+              << "                  (default " << QueryServer::kDefaultSocket << "; see bin/exoplanet_query)\n"
+              << "  --batch=MANIFEST write the outputs a manifest lists (see include/QueryBatch.hpp)\n"
+              << "                  and exit\n";
+}
+
+int main(int argc, char* argv[]) {
+    MenuOptions options;
+    bool printStats = false;
+    std::string statsFile;
+    std::string serveSocket;
+    std::string batchFile;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--lazy") == 0) {
+            options.lazyLoad = true;
+        } else if (std::strncmp(argv[i], "--stellar=", 10) == 0) {
+            options.stellarFile = argv[i] + 10;
+        } else if (std::strncmp(argv[i], "--merge=", 8) == 0) {
+            options.mergeFiles.push_back(argv[i] + 8);
+        } else if (std::strncmp(argv[i], "--prefer=", 9) == 0) {
+            std::string mode = argv[i] + 9;
+            if (mode == "incoming") options.mergePrecedence = ExoplanetCatalog::MergePrecedence::Incoming;
+            else if (mode == "existing") options.mergePrecedence = ExoplanetCatalog::MergePrecedence::Existing;
+            else if (mode == "fill") options.mergePrecedence = ExoplanetCatalog::MergePrecedence::FillMissing;
+            else {
+                std::cerr << "Unknown merge preference: " << mode << "\n";
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (std::strcmp(argv[i], "--drop-missing") == 0) {
+            options.dropMissing = true;
+        } else if (std::strncmp(argv[i], "--result-cache=", 15) == 0) {
+            options.resultCacheBytes = static_cast<size_t>(std::strtoul(argv[i] + 15, nullptr, 10)) << 20;
+        } else if (std::strcmp(argv[i], "--compact") == 0) {
+            options.compactMode = true;
+        } else if (std::strncmp(argv[i], "--quarantine=", 13) == 0) {
+            options.parsePolicy.quarantineFile = argv[i] + 13;
+        } else if (std::strncmp(argv[i], "--max-rejects=", 14) == 0) {
+            char* end = nullptr;
+            double limit = std::strtod(argv[i] + 14, &end);
+            if (end == argv[i] + 14 || !(limit >= 0) || (*end && std::strcmp(end, "%") != 0)) {
+                std::cerr << "Bad reject limit: " << argv[i] + 14 << "\n";
+                printUsage(argv[0]);
+                return 1;
+            }
+            if (*end) options.parsePolicy.maxRejectedFraction = limit / 100;
+            else options.parsePolicy.maxRejectedRows = static_cast<size_t>(limit);
+        } else if (std::strncmp(argv[i], "--threads=", 10) == 0) {
+            ThreadPool::configure(std::strtoul(argv[i] + 10, nullptr, 10));
+        } else if (std::strncmp(argv[i], "--trace=", 8) == 0) {
+            trace::start(argv[i] + 8);
+        } else if (std::strcmp(argv[i], "--stats") == 0) {
+            printStats = true;
+        } else if (std::strncmp(argv[i], "--stats=", 8) == 0) {
+            statsFile = argv[i] + 8;
+        } else if (std::strcmp(argv[i], "--serve") == 0) {
+            serveSocket = QueryServer::kDefaultSocket;
+        } else if (std::strncmp(argv[i], "--serve=", 8) == 0) {
+            serveSocket = argv[i] + 8;
+        } else if (std::strncmp(argv[i], "--batch=", 8) == 0) {
+            batchFile = argv[i] + 8;
+        } else {
+            std::cerr << "Unknown option: " << argv[i] << "\n";
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (!serveSocket.empty() && !batchFile.empty()) {
+        std::cerr << "--serve and --batch cannot be combined\n";
+        return 1;
+    }
+    QueryBatch batch;
+    if (!batchFile.empty()) {
+        if (!batch.load(batchFile)) return 1;
+        if (!batch.inputFile().empty()) options.dataFile = batch.inputFile();
+    }
+
+    bool succeeded = true;
+    {
+        MainMenu menu(options);
+        if (!serveSocket.empty()) succeeded = menu.serve(serveSocket);
+        else if (!batchFile.empty()) succeeded = menu.runBatch(batch);
+        else succeeded = menu.run();
+    }
+
+    // A failed run still writes its trace and stats; they show where it went wrong
+    if (trace::enabled() && !trace::stop()) succeeded = false;
+    if (printStats) stats::report(std::cout);
+    if (!statsFile.empty()) {
+        std::ofstream out(statsFile);
+        if (out) {
+            stats::writeJson(out);
+        } else {
+            std::cerr << "Error creating file: " << statsFile << std::endl;
+            succeeded = false;
+        }
+    }
+    return succeeded ? 0 : 1;
+}
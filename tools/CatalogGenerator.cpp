@@ -0,0 +1,366 @@
+#include "CatalogGenerator.hpp"
+#include "../include/algorithms/parallel.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+namespace {
+    // Rows per independently seeded block, and the most blocks formatted
+    // ahead of the writer
+    const size_t kBlockRows = 1 << 13;
+    const size_t kMaxBlocksInFlight = 32;
+
+    // Longest possible row: 48 fields of at most a few dozen characters
+    const size_t kMaxRowBytes = 1024;
+
+    const char kHeader[] =
+        "# Kepler cumulative (cleaned), synthetic\n"
+        "rowid,kepid,kepoi_name,kepler_name,koi_disposition,koi_pdisposition,koi_score,"
+        "koi_fpflag_nt,koi_fpflag_ss,koi_fpflag_co,koi_fpflag_ec,koi_period,koi_period_err1,"
+        "koi_period_err2,koi_time0bk,koi_time0bk_err1,koi_time0bk_err2,koi_impact,"
+        "koi_impact_err1,koi_impact_err2,koi_duration,koi_duration_err1,koi_duration_err2,"
+        "koi_depth,koi_depth_err1,koi_depth_err2,koi_prad,koi_prad_err1,koi_prad_err2,"
+        "koi_teq,koi_insol,koi_insol_err1,koi_insol_err2,koi_model_snr,koi_tce_plnt_num,"
+        "koi_tce_delivname,koi_steff,koi_steff_err1,koi_steff_err2,koi_slogg,"
+        "koi_slogg_err1,koi_slogg_err2,koi_srad,koi_srad_err1,koi_srad_err2,ra,dec,"
+        "koi_kepmag\n";
+
+    // Distribution parameters, matched to the DR25 cumulative KOI table
+    // (9,564 KOIs around 8,214 stars). Refit here.
+    const double kMultiplicityCdf[] = {0.78, 0.91, 0.96, 0.985, 0.995, 0.999, 1.0}; // planets per star
+    const int kMaxPlanetsPerStar = 7;
+    const double kSingleFalsePositiveRate = 0.75; // multis are far more often real
+    const double kMultiFalsePositiveRate = 0.20;
+    const double kConfirmedShare = 0.5;           // of the non-false-positives
+    const double kFpFlagRates[] = {0.45, 0.37, 0.32, 0.12}; // nt, ss, co, ec
+    const double kMissingFitRate = 0.038;         // no transit fit: impact..model_snr blank
+    const double kMissingStellarRate = 0.038;     // no steff/slogg/srad for the star
+    const double kMissingScoreRate = 0.158;
+    const double kOldDeliveryRate = 0.08;         // TCEs from an earlier pipeline run
+    const int kFirstKepid = 757450;
+    const int kMaxKepidGap = 20;
+    const double kFieldRa[] = {280.2, 301.7};     // the Kepler field
+    const double kFieldDec[] = {36.6, 52.4};
+
+    const double kSunTeff = 5772.0;
+    const double kSunRadiusAu = 0.00465047;
+    const double kEarthRadiiPerSun = 109.1;
+    const double kBondAlbedoFactor = 0.9147;      // (1 - 0.3)^(1/4)
+
+    enum Disposition : uint8_t { Confirmed, Candidate, FalsePositive };
+
+    // xorshift64*, seeded through splitmix64 so nearby seeds diverge
+    class Random {
+    private:
+        uint64_t state;
+        double spare = 0;     // Box-Muller yields normals in pairs
+        bool hasSpare = false;
+
+    public:
+        Random(uint64_t seed, uint64_t block, uint64_t stream) {
+            uint64_t z = seed + 0x9E3779B97F4A7C15ULL * (block * 2 + stream + 1);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            state = (z ^ (z >> 31)) | 1;
+        }
+
+        uint64_t next() {
+            state ^= state >> 12;
+            state ^= state << 25;
+            state ^= state >> 27;
+            return state * 0x2545F4914F6CDD1DULL;
+        }
+        double uniform() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+        double uniform(double lo, double hi) { return lo + (hi - lo) * uniform(); }
+        bool chance(double p) { return uniform() < p; }
+        double normal(double mean, double sigma) {
+            if (hasSpare) {
+                hasSpare = false;
+                return mean + sigma * spare;
+            }
+            double r = std::sqrt(-2.0 * std::log(1.0 - uniform())); // u in (0, 1]
+            double theta = 2.0 * M_PI * uniform();
+            spare = r * std::sin(theta);
+            hasSpare = true;
+            return mean + sigma * r * std::cos(theta);
+        }
+        double lognormal(double median, double sigma) { return median * std::exp(normal(0, sigma)); }
+    };
+
+    double clamp(double x, double lo, double hi) { return std::min(std::max(x, lo), hi); }
+
+    // Which planets a star has. Drawn from the block's structure stream,
+    // which is replayed when the block is written.
+    struct System {
+        int planets;
+        int kepidGap;
+        Disposition dispositions[kMaxPlanetsPerStar];
+        bool hasConfirmed;
+    };
+
+    void drawSystem(Random& random, size_t rowsLeft, System& system) {
+        double u = random.uniform();
+        int planets = 1;
+        while (planets < kMaxPlanetsPerStar && u > kMultiplicityCdf[planets - 1]) ++planets;
+        system.planets = static_cast<int>(std::min<size_t>(planets, rowsLeft));
+        system.kepidGap = 1 + static_cast<int>(random.next() % kMaxKepidGap);
+        system.hasConfirmed = false;
+        double fpRate = planets > 1 ? kMultiFalsePositiveRate : kSingleFalsePositiveRate;
+        for (int i = 0; i < system.planets; ++i) {
+            Disposition d = random.chance(fpRate) ? FalsePositive
+                          : random.chance(kConfirmedShare) ? Confirmed : Candidate;
+            system.dispositions[i] = d;
+            system.hasConfirmed |= d == Confirmed;
+        }
+    }
+
+    // Counters a block needs from the blocks before it
+    struct BlockStart {
+        uint64_t star = 0;          // stars before this block
+        uint64_t confirmedStar = 0; // of which have a Kepler name
+        int64_t kepid = kFirstKepid;
+    };
+
+    BlockStart blockExtent(uint64_t seed, size_t block, size_t rows) {
+        Random structure(seed, block, 0);
+        BlockStart extent;
+        extent.kepid = 0;
+        System system;
+        for (size_t row = 0; row < rows; row += system.planets) {
+            drawSystem(structure, rows - row, system);
+            ++extent.star;
+            extent.confirmedStar += system.hasConfirmed;
+            extent.kepid += system.kepidGap;
+        }
+        return extent;
+    }
+
+    // Field writers; a NaN value leaves the field empty
+    class LineWriter {
+    private:
+        char* p;
+
+    public:
+        explicit LineWriter(char* out) : p(out) {}
+        char* end() const { return p; }
+
+        void text(const char* s) { while (*s) *p++ = *s++; }
+        void comma() { *p++ = ','; }
+
+        void unsignedInt(uint64_t v, int width = 0) {
+            char digits[24];
+            int n = 0;
+            do { digits[n++] = static_cast<char>('0' + v % 10); v /= 10; } while (v);
+            while (n < width) digits[n++] = '0';
+            while (n) *p++ = digits[--n];
+        }
+
+        void fixed(double v, int decimals) {
+            static const double kScale[] = {1, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9};
+            if (std::isnan(v)) return;
+            if (v < 0) { *p++ = '-'; v = -v; }
+            uint64_t scaled = static_cast<uint64_t>(v * kScale[decimals] + 0.5);
+            uint64_t unit = static_cast<uint64_t>(kScale[decimals]);
+            unsignedInt(scaled / unit);
+            if (decimals) {
+                *p++ = '.';
+                unsignedInt(scaled % unit, decimals);
+            }
+        }
+
+        // value, +error, -error
+        void measured(double v, double err1, double err2, int decimals) {
+            fixed(v, decimals); comma();
+            fixed(std::isnan(v) ? v : err1, decimals); comma();
+            fixed(std::isnan(v) ? v : -err2, decimals);
+        }
+    };
+
+    struct Star {
+        double steff, slogg, srad, mass, ra, dec, kepmag;
+        bool missing;
+    };
+
+    void drawStar(Random& random, Star& star) {
+        bool giant = random.chance(0.05);
+        star.steff = clamp(random.normal(giant ? 4800 : 5650, giant ? 400 : 800), 2600, 12000);
+        star.srad = giant ? clamp(random.lognormal(4.0, 0.6), 1.5, 150)
+                          : clamp(random.lognormal(0.95, 0.35), 0.1, 4);
+        star.mass = giant ? clamp(random.lognormal(1.2, 0.3), 0.5, 5)
+                          : clamp(std::pow(star.srad, 1.25), 0.1, 4);
+        star.slogg = clamp(4.438 + std::log10(star.mass / (star.srad * star.srad)) + random.normal(0, 0.05), 0.5, 5.4);
+        star.ra = random.uniform(kFieldRa[0], kFieldRa[1]);
+        star.dec = random.uniform(kFieldDec[0], kFieldDec[1]);
+        star.kepmag = clamp(random.normal(14.3, 1.3), 7, 20);
+        star.missing = random.chance(kMissingStellarRate);
+    }
+
+    // Formats one block into `out`, returning the end of the written text
+    char* writeBlock(uint64_t seed, size_t block, size_t rows, const BlockStart& start, char* out) {
+        Random structure(seed, block, 0);
+        Random random(seed, block, 1);
+        uint64_t rowid = static_cast<uint64_t>(block) * kBlockRows + 1;
+        uint64_t star = start.star, confirmedStar = start.confirmedStar;
+        int64_t kepid = start.kepid;
+        LineWriter line(out);
+        System system;
+        Star host;
+
+        for (size_t row = 0; row < rows; row += system.planets) {
+            drawSystem(structure, rows - row, system);
+            kepid += system.kepidGap;
+            ++star;
+            if (system.hasConfirmed) ++confirmedStar;
+            drawStar(random, host);
+
+            // Periods ascend through the system; KOI suffixes and Kepler
+            // letters follow that order
+            double period = system.planets == 1 ? random.lognormal(9.0, 1.4)
+                                                : random.lognormal(4.5, 1.0);
+            int letter = 0;
+            for (int i = 0; i < system.planets; ++i, ++rowid) {
+                if (i) period *= std::max(1.15, random.lognormal(1.9, 0.45));
+                period = clamp(period, 0.25, 1100);
+                Disposition disposition = system.dispositions[i];
+                bool falsePositive = disposition == FalsePositive;
+
+                line.unsignedInt(rowid); line.comma();
+                line.unsignedInt(static_cast<uint64_t>(kepid)); line.comma();
+                line.text("K"); line.unsignedInt(star, 5); line.text(".");
+                line.unsignedInt(i + 1, 2); line.comma();
+                if (disposition == Confirmed) {
+                    line.text("Kepler-"); line.unsignedInt(confirmedStar);
+                    char suffix[3] = {' ', static_cast<char>('b' + letter++), '\0'};
+                    line.text(suffix);
+                }
+                line.comma();
+                line.text(disposition == Confirmed ? "CONFIRMED"
+                        : disposition == Candidate ? "CANDIDATE" : "FALSE POSITIVE");
+                line.comma();
+                line.text(falsePositive ? "FALSE POSITIVE" : "CANDIDATE"); line.comma();
+
+                double u = random.uniform();
+                double score = disposition == Confirmed ? 1 - 0.15 * u * u * u * u
+                             : disposition == Candidate ? std::pow(u, 0.6) : 0.1 * u * u * u;
+                line.fixed(random.chance(kMissingScoreRate) ? NAN : score, 3); line.comma();
+
+                bool flags[4] = {false, false, false, false};
+                if (falsePositive) {
+                    bool any = false;
+                    for (int f = 0; f < 4; ++f) any |= flags[f] = random.chance(kFpFlagRates[f]);
+                    if (!any) flags[0] = true;
+                }
+                for (int f = 0; f < 4; ++f) { line.text(flags[f] ? "1" : "0"); line.comma(); }
+
+                double periodErr = period * 2e-5 * random.lognormal(1, 1);
+                line.measured(period, periodErr, periodErr, 9); line.comma();
+                double time0Err = random.lognormal(0.004, 0.8);
+                line.measured(131.5 + random.uniform() * std::min(period, 1400.0), time0Err, time0Err, 6);
+                line.comma();
+
+                // Orbit and transit geometry from Kepler's third law
+                double years = period / 365.25;
+                double a = std::cbrt(years * years * host.mass);
+                double t2 = (host.steff / kSunTeff) * (host.steff / kSunTeff);
+                double insol = host.srad * host.srad * t2 * t2 / (a * a);
+                double teq = host.steff * std::sqrt(host.srad * kSunRadiusAu / (2 * a)) * kBondAlbedoFactor;
+                double prad = falsePositive ? clamp(random.lognormal(8, 1.7), 0.1, 200000)
+                                            : clamp(random.lognormal(2.0, 0.7), 0.25, 30);
+                double impact = !falsePositive || random.chance(0.8) ? random.uniform(0, 1.05)
+                                                                     : random.lognormal(2, 1.5);
+                double duration = std::max(0.1, 16.0 * std::cbrt(years / host.mass) * host.srad
+                    * std::sqrt(std::max(1 - impact * impact, 0.05)) * random.lognormal(1, 0.1));
+                double ratio = prad / (kEarthRadiiPerSun * host.srad);
+                double depth = falsePositive ? random.lognormal(1500, 2.2)
+                                             : 1e6 * ratio * ratio * random.lognormal(1, 0.15);
+                depth = clamp(depth, 0.5, 1e6);
+                double snr = 12 * std::sqrt(depth / 100 * duration / 3)
+                           * std::exp(-0.2 * M_LN10 * (host.kepmag - 14)) * random.lognormal(1, 0.4);
+
+                bool missingFit = random.chance(kMissingFitRate);
+                if (missingFit) impact = duration = depth = prad = teq = insol = snr = NAN;
+                line.measured(impact, random.uniform(0.01, 0.4), random.uniform(0.01, 0.4), 3); line.comma();
+                line.measured(duration, 0.05 * duration, 0.05 * duration, 4); line.comma();
+                line.measured(depth, 0.05 * depth + 10, 0.05 * depth + 10, 1); line.comma();
+                line.measured(prad, 0.3 * prad, 0.1 * prad, 2); line.comma();
+                line.fixed(teq, 0); line.comma();
+                line.measured(insol, 0.3 * insol, 0.3 * insol, 2); line.comma();
+                line.fixed(snr, 1); line.comma();
+                if (!missingFit) {
+                    line.unsignedInt(i + 1); line.comma();
+                    line.text(random.chance(kOldDeliveryRate) ? "q1_q17_dr24_tce" : "q1_q17_dr25_tce");
+                } else {
+                    line.comma();
+                }
+                line.comma();
+
+                double steff = host.missing ? NAN : host.steff;
+                double slogg = host.missing ? NAN : host.slogg;
+                double srad = host.missing ? NAN : host.srad;
+                line.measured(steff, random.uniform(70, 200), random.uniform(70, 250), 0); line.comma();
+                line.measured(slogg, random.uniform(0.03, 0.2), random.uniform(0.03, 0.3), 3); line.comma();
+                line.measured(srad, 0.2 * srad, 0.1 * srad, 3); line.comma();
+                line.fixed(host.ra, 6); line.comma();
+                line.fixed(host.dec, 6); line.comma();
+                line.fixed(host.kepmag, 3);
+                line.text("\n");
+            }
+        }
+        return line.end();
+    }
+}
+
+uint64_t CatalogGenerator::write(std::FILE* out, size_t rows) const {
+    size_t blocks = (rows + kBlockRows - 1) / kBlockRows;
+    auto rowsIn = [rows](size_t block) { return std::min(kBlockRows, rows - block * kBlockRows); };
+
+    // Pass 1: replay each block's structure stream to learn where its
+    // star, Kepler-name and kepid counters start
+    std::vector<BlockStart> starts(blocks + 1);
+    algo::parallel_for(blocks, 1, [&](size_t begin, size_t end) {
+        for (size_t b = begin; b < end; ++b) starts[b + 1] = blockExtent(seed, b, rowsIn(b));
+    });
+    starts[0] = BlockStart();
+    for (size_t b = 1; b <= blocks; ++b) {
+        starts[b].star += starts[b - 1].star;
+        starts[b].confirmedStar += starts[b - 1].confirmedStar;
+        starts[b].kepid += starts[b - 1].kepid;
+    }
+
+    // Pass 2: format blocks in parallel, write them in order
+    uint64_t written = std::fwrite(kHeader, 1, sizeof kHeader - 1, out);
+    size_t inFlight = std::min(kMaxBlocksInFlight, std::max<size_t>(algo::worker_count() * 2, 1));
+    std::vector<std::vector<char>> buffers(std::min(inFlight, blocks));
+    std::vector<char*> ends(buffers.size());
+    for (auto& buffer : buffers) buffer.resize(kBlockRows * kMaxRowBytes);
+
+    for (size_t first = 0; first < blocks; first += buffers.size()) {
+        size_t count = std::min(buffers.size(), blocks - first);
+        algo::parallel_for(count, 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                size_t b = first + i;
+                ends[i] = writeBlock(seed, b, rowsIn(b), starts[b], buffers[i].data());
+            }
+        });
+        for (size_t i = 0; i < count; ++i) {
+            size_t bytes = ends[i] - buffers[i].data();
+            if (std::fwrite(buffers[i].data(), 1, bytes, out) != bytes) return 0;
+            written += bytes;
+        }
+    }
+    return std::fflush(out) == 0 ? written : 0;
+}
+
+uint64_t CatalogGenerator::writeFile(const std::string& filename, size_t rows) const {
+    if (filename == "-") return write(stdout, rows);
+
+    std::FILE* out = std::fopen(filename.c_str(), "wb");
+    if (!out) {
+        std::cerr << "Error creating file: " << filename << std::endl;
+        return 0;
+    }
+    uint64_t written = write(out, rows);
+    if (std::fclose(out) != 0) written = 0;
+    return written;
+}
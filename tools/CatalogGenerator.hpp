@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+// Synthetic Kepler cumulative tables in the cleaned 48-column schema that
+// FileIO::parseCSV reads. Columns are sampled from distributions matched to
+// the real table: disposition mix and false-positive flags, missing-fit rows,
+// host stars shared by multi-planet systems (consecutive rows, one kepid),
+// and KOI / Kepler names in the archive's formats. Temperatures, insolation,
+// depths and durations follow from the star and the orbit, so derived
+// quantities and the habitable filter behave as they do on real data.
+//
+// Rows are generated in fixed-size blocks, each with its own random streams
+// keyed on (seed, block), so the output depends only on the seed and the
+// row count, never on the thread count. Blocks are formatted in parallel
+// and written in order, keeping memory bounded for any row count.
+class CatalogGenerator {
+private:
+    uint64_t seed;
+
+public:
+    explicit CatalogGenerator(uint64_t seed) : seed(seed) {}
+
+    // Writes the two header lines and `rows` planets. Returns the number of
+    // bytes written, or 0 on a write error.
+    uint64_t write(std::FILE* out, size_t rows) const;
+
+    // As write(); "-" means stdout
+    uint64_t writeFile(const std::string& filename, size_t rows) const;
+};
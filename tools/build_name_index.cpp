@@ -0,0 +1,58 @@
+// tools/build_name_index.cpp
+// Builds the persisted name index for a catalog, e.g.
+//   bin/exoplanet_index cumulative_cleaned1.csv
+// writes cumulative_cleaned1.csv.names, which the analyzer maps at startup
+// instead of building its name hash table.
+#include "../include/ExoplanetCatalog.hpp"
+#include "../include/ThreadPool.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+static void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " CATALOG [--output=FILE] [--threads=N]\n"
+              << "  --output=FILE  destination (default CATALOG.names, where the analyzer looks)\n"
+              << "  --threads=N    worker threads (default: CPUs available)\n";
+}
+
+int main(int argc, char* argv[]) {
+    std::string input, output;
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (std::strncmp(arg, "--output=", 9) == 0) {
+            output = arg + 9;
+        } else if (std::strncmp(arg, "--threads=", 10) == 0) {
+            ThreadPool::configure(std::strtoul(arg + 10, nullptr, 10));
+        } else if (arg[0] != '-' && input.empty()) {
+            input = arg;
+        } else {
+            std::cerr << "Unknown option: " << arg << "\n";
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (input.empty()) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (output.empty()) output = ExoplanetCatalog::nameIndexPath(input);
+
+    auto start = std::chrono::steady_clock::now();
+    ExoplanetCatalog catalog;
+    try {
+        catalog.loadData(input, ExoplanetCatalog::LoadMode::Lazy); // names are key columns
+    } catch (const std::exception& e) {
+        std::cerr << "Fatal Error: " << e.what() << "\n";
+        return 1;
+    }
+    if (!catalog.saveNameIndex(output)) {
+        std::cerr << "Error writing " << output << std::endl;
+        return 1;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << "Indexed " << catalog.getPlanets().size() << " rows into " << output
+              << " in " << seconds << " s\n";
+    return 0;
+}
@@ -0,0 +1,103 @@
+// tools/diff_catalogs.cpp
+// Compares two releases of the cumulative table by kepoi_name, e.g.
+//   bin/exoplanet_diff cumulative_2023.csv cumulative_2024.csv --delta=delta.csv
+// prints how many planets were added, removed and changed, and how often
+// each column changed. The delta file has one line per differing planet:
+// change (added, removed or changed), kepoi_name, and the changed columns
+// separated by ';'.
+#include "../include/ExoplanetCatalog.hpp"
+#include "../include/ThreadPool.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+static void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " OLD NEW [--delta=FILE] [--threads=N]\n"
+              << "  --delta=FILE  write the added, removed and changed planets to FILE\n"
+              << "  --threads=N   worker threads (default: CPUs available)\n";
+}
+
+namespace {
+    bool writeDelta(const std::string& filename, const ExoplanetCatalog& older,
+                    const ExoplanetCatalog& newer, const ExoplanetCatalog::CatalogDiff& delta) {
+        std::ofstream out(filename);
+        if (!out) return false;
+        out << "change,kepoi_name,columns\n";
+        for (size_t r : delta.added) out << "added," << newer.getPlanets()[r].kepoi_name << ",\n";
+        for (size_t r : delta.removed) out << "removed," << older.getPlanets()[r].kepoi_name << ",\n";
+        for (const auto& change : delta.changed) {
+            out << "changed," << newer.getPlanets()[change.newRow].kepoi_name << ",";
+            const char* separator = "";
+            for (size_t c = 0; c < static_cast<size_t>(Column::Count); ++c) {
+                if (change.changed & columnBit(static_cast<Column>(c))) {
+                    out << separator << columnInfo(static_cast<Column>(c)).name;
+                    separator = ";";
+                }
+            }
+            out << "\n";
+        }
+        return static_cast<bool>(out);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::string files[2], deltaFile;
+    size_t inputs = 0;
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (std::strncmp(arg, "--delta=", 8) == 0) {
+            deltaFile = arg + 8;
+        } else if (std::strncmp(arg, "--threads=", 10) == 0) {
+            ThreadPool::configure(std::strtoul(arg + 10, nullptr, 10));
+        } else if (arg[0] != '-' && inputs < 2) {
+            files[inputs++] = arg;
+        } else {
+            std::cerr << "Unknown option: " << arg << "\n";
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (inputs != 2) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    ExoplanetCatalog older, newer;
+    try {
+        older.loadData(files[0]);
+        newer.loadData(files[1]);
+    } catch (const std::exception& e) {
+        std::cerr << "Fatal Error: " << e.what() << "\n";
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    ExoplanetCatalog::CatalogDiff delta = older.diff(newer);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "Added:     " << delta.added.size() << "\n"
+              << "Removed:   " << delta.removed.size() << "\n"
+              << "Changed:   " << delta.changed.size() << "\n"
+              << "Unchanged: " << delta.unchanged << "\n";
+    if (!delta.changed.empty()) {
+        std::cout << "\nChanged planets per column:\n";
+        for (size_t c = 0; c < static_cast<size_t>(Column::Count); ++c) {
+            size_t count = 0;
+            for (const auto& change : delta.changed) {
+                if (change.changed & columnBit(static_cast<Column>(c))) ++count;
+            }
+            if (count) std::cout << "  " << columnInfo(static_cast<Column>(c)).name << ": " << count << "\n";
+        }
+    }
+    std::cerr << "Compared " << older.getPlanets().size() << " and " << newer.getPlanets().size()
+              << " rows in " << seconds << " s\n";
+
+    if (!deltaFile.empty() && !writeDelta(deltaFile, older, newer, delta)) {
+        std::cerr << "Error writing " << deltaFile << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,83 @@
+// tools/generate_catalog.cpp
+// Writes a synthetic catalog for scale testing, e.g.
+//   bin/exoplanet_gen --rows=100m --seed=7 --output=big.csv
+#include "CatalogGenerator.hpp"
+#include "../include/ThreadPool.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+static void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " --rows=N [--seed=N] [--output=FILE] [--threads=N]\n"
+              << "  --rows=N       planets to write, k/m suffixes allowed; 0 writes only the header\n"
+              << "  --seed=N       output is identical for identical seed and rows (default 1)\n"
+              << "  --output=FILE  destination, - for stdout (default)\n"
+              << "  --threads=N    worker threads (default: CPUs available)\n";
+}
+
+static bool parseCount(const char* text, size_t& value) {
+    char* end = nullptr;
+    double number = std::strtod(text, &end);
+    if (end == text || !(number >= 0)) return false; // NaN fails too
+    if (*end == 'k' || *end == 'K') { number *= 1e3; ++end; }
+    else if (*end == 'm' || *end == 'M') { number *= 1e6; ++end; }
+    if (*end != '\0' || !(number < 1e18)) return false;
+    value = static_cast<size_t>(number);
+    return true;
+}
+
+static bool parseSeed(const char* text, uint64_t& value) {
+    char* end = nullptr;
+    value = std::strtoull(text, &end, 10);
+    return end != text && *end == '\0' && *text != '-';
+}
+
+// Reports an option value that did not parse
+static int invalidValue(const char* program, const char* option, const char* value) {
+    std::cerr << "Invalid value for " << option << ": " << value << "\n";
+    printUsage(program);
+    return 1;
+}
+
+int main(int argc, char* argv[]) {
+    size_t rows = 0, threads = 0;
+    bool haveRows = false;
+    uint64_t seed = 1;
+    std::string output = "-";
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (std::strncmp(arg, "--rows=", 7) == 0) {
+            if (!parseCount(arg + 7, rows)) return invalidValue(argv[0], "--rows", arg + 7);
+            haveRows = true;
+        } else if (std::strncmp(arg, "--seed=", 7) == 0) {
+            if (!parseSeed(arg + 7, seed)) return invalidValue(argv[0], "--seed", arg + 7);
+        } else if (std::strncmp(arg, "--output=", 9) == 0) {
+            output = arg + 9;
+        } else if (std::strncmp(arg, "--threads=", 10) == 0) {
+            if (!parseCount(arg + 10, threads)) return invalidValue(argv[0], "--threads", arg + 10);
+            ThreadPool::configure(threads);
+        } else {
+            std::cerr << "Unknown option: " << arg << "\n";
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (!haveRows) {
+        std::cerr << "--rows is required\n";
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t bytes = CatalogGenerator(seed).writeFile(output, rows);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (!bytes) {
+        std::cerr << "Error writing " << output << std::endl;
+        return 1;
+    }
+    std::cerr << "Wrote " << rows << " rows (" << bytes / 1e6 << " MB) in " << seconds << " s, "
+              << bytes / 1e6 / seconds << " MB/s\n";
+    return 0;
+}
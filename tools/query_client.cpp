@@ -0,0 +1,134 @@
+// tools/query_client.cpp
+// Command-line client for the analyzer's query server
+// (bin/exoplanet_analyzer --serve), e.g.
+//   bin/exoplanet_query NAME Kepler-22 b
+//   printf 'TOP radius 5\nSTATS period\n' | bin/exoplanet_query
+// Prints the lines of each reply; an ERR reply goes to stderr and makes
+// the exit status 1.
+#include "../include/QueryServer.hpp"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [--socket=PATH] [REQUEST...]\n"
+              << "  --socket=PATH  server socket (default " << QueryServer::kDefaultSocket << ")\n"
+              << "  REQUEST        words of one request; without them, one request per stdin line\n";
+}
+
+namespace {
+    // Buffered line reader over a socket
+    class LineReader {
+    public:
+        explicit LineReader(int fd) : fd(fd), pos(0) {}
+
+        bool next(std::string& line) {
+            while (true) {
+                size_t end = buffer.find('\n', pos);
+                if (end != std::string::npos) {
+                    line.assign(buffer, pos, end - pos);
+                    pos = end + 1;
+                    return true;
+                }
+                buffer.erase(0, pos);
+                pos = 0;
+                char chunk[16 * 1024];
+                ssize_t got = recv(fd, chunk, sizeof(chunk), 0);
+                if (got < 0 && errno == EINTR) continue;
+                if (got <= 0) return false;
+                buffer.append(chunk, static_cast<size_t>(got));
+            }
+        }
+
+    private:
+        int fd;
+        std::string buffer;
+        size_t pos;
+    };
+
+    bool sendAll(int fd, const std::string& text) {
+        size_t sent = 0;
+        while (sent < text.size()) {
+            ssize_t n = send(fd, text.data() + sent, text.size() - sent, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            sent += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    // Sends one request and prints its reply; false on ERR or a lost connection
+    bool query(int fd, LineReader& reader, const std::string& request, bool& connected) {
+        std::string header, line;
+        if (!sendAll(fd, request + "\n") || !reader.next(header)) {
+            std::cerr << "Connection to server lost" << std::endl;
+            connected = false;
+            return false;
+        }
+        if (header.compare(0, 3, "OK ") != 0) {
+            std::cerr << (header.compare(0, 4, "ERR ") == 0 ? header.substr(4) : header) << std::endl;
+            return false;
+        }
+        unsigned long lines = std::strtoul(header.c_str() + 3, nullptr, 10);
+        for (unsigned long i = 0; i < lines; ++i) {
+            if (!reader.next(line)) {
+                std::cerr << "Connection to server lost" << std::endl;
+                connected = false;
+                return false;
+            }
+            std::cout << line << '\n';
+        }
+        return true;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::string socketPath = QueryServer::kDefaultSocket;
+    std::string request;
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (request.empty() && std::strncmp(arg, "--socket=", 9) == 0) {
+            socketPath = arg + 9;
+        } else if (request.empty() && arg[0] == '-') {
+            std::cerr << "Unknown option: " << arg << "\n";
+            printUsage(argv[0]);
+            return 1;
+        } else {
+            if (!request.empty()) request += ' ';
+            request += arg;
+        }
+    }
+
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Invalid socket path: " << socketPath << std::endl;
+        return 1;
+    }
+    std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        std::cerr << "Cannot connect to " << socketPath << ": " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+
+    LineReader reader(fd);
+    bool connected = true;
+    bool ok = true;
+    if (!request.empty()) {
+        ok = query(fd, reader, request, connected);
+    } else {
+        std::string line;
+        while (connected && std::getline(std::cin, line)) {
+            if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+            if (!query(fd, reader, line, connected)) ok = false;
+        }
+    }
+    close(fd);
+    return ok ? 0 : 1;
+}